@@ -351,6 +351,7 @@ void demo_rename_player(const char *name, const char *player)
 /*---------------------------------------------------------------------------*/
 
 static struct lockstep update_step;
+static int             update_ticks;
 
 static void demo_update_read(float dt)
 {
@@ -358,6 +359,8 @@ static void demo_update_read(float dt)
     {
         union cmd cmd;
 
+        update_ticks++;
+
         while (cmd_get(demo_fp, &cmd))
         {
             game_proxy_enq(&cmd);
@@ -382,6 +385,14 @@ float demo_replay_blend(void)
     return lockstep_blend(&update_step);
 }
 
+/*
+ * Return the number of updates replayed since the replay was opened.
+ */
+int demo_replay_ticks(void)
+{
+    return update_ticks;
+}
+
 /*---------------------------------------------------------------------------*/
 
 static struct demo demo_replay;
@@ -394,6 +405,7 @@ const char *curr_demo(void)
 int demo_replay_init(const char *path, int *g, int *m, int *b, int *s, int *tt)
 {
     lockstep_clr(&update_step);
+    update_ticks = 0;
 
     if ((demo_fp = fs_open(path, "r")))
     {
@@ -62,6 +62,7 @@ int  demo_replay_init(const char *, int *, int *, int *, int *, int *);
 int  demo_replay_step(float);
 void demo_replay_stop(int);
 float demo_replay_blend(void);
+int  demo_replay_ticks(void);
 
 const char *curr_demo(void);
 
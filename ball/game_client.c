@@ -25,6 +25,7 @@
 #include "audio.h"
 #include "config.h"
 #include "video.h"
+#include "profile.h"
 
 #include "solid_draw.h"
 
@@ -329,6 +330,8 @@ void game_client_sync(fs_file demo_fp)
 {
     union cmd *cmdp;
 
+    profile_phase_begin(PHASE_SYNC);
+
     while ((cmdp = game_proxy_deq()))
     {
         if (demo_fp)
@@ -338,6 +341,8 @@ void game_client_sync(fs_file demo_fp)
 
         cmd_free(cmdp);
     }
+
+    profile_phase_end();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -345,31 +350,36 @@ void game_client_sync(fs_file demo_fp)
 int  game_client_init(const char *file_name)
 {
     char *back_name = "", *grad_name = "";
+    struct s_base *base;
     int i;
 
     coins  = 0;
     status = GAME_NONE;
 
-    game_client_free(file_name);
+    game_client_free();
 
     /* Load SOL data. */
 
-    if (!game_base_load(file_name))
+    if (!(base = game_base_load(file_name)))
         return (gd.state = 0);
 
-    if (!sol_load_vary(&gd.vary, &game_base))
+    if (!sol_load_vary(&gd.vary, base))
     {
-        game_base_free(NULL);
+        game_base_free(base);
         return (gd.state = 0);
     }
 
     if (!sol_load_draw(&gd.draw, &gd.vary, config_get_d(CONFIG_SHADOW)))
     {
         sol_free_vary(&gd.vary);
-        game_base_free(NULL);
+        game_base_free(base);
         return (gd.state = 0);
     }
 
+    /* Materials have claimed their prefetched textures by now. */
+
+    image_prefetch_drop();
+
     gd.state = 1;
 
     /* Initialize game state. */
@@ -430,7 +440,18 @@ int  game_client_init(const char *file_name)
     /* Initialize background. */
 
     back_init(grad_name);
-    sol_load_full(&gd.back, back_name, 0);
+
+    memset(&gd.back, 0, sizeof (gd.back));
+
+    profile_begin("back", back_name);
+
+    if ((base = game_base_load(back_name)))
+    {
+        sol_load_vary(&gd.back.vary, base);
+        sol_load_draw(&gd.back.draw, &gd.back.vary, 0);
+    }
+
+    profile_end();
 
     /* Initialize lighting. */
 
@@ -439,10 +460,13 @@ int  game_client_init(const char *file_name)
     return gd.state;
 }
 
-void game_client_free(const char *next)
+void game_client_free(void)
 {
     if (gd.state)
     {
+        struct s_base *base = gd.vary.base;
+        struct s_base *back = gd.back.vary.base;
+
         game_proxy_clr();
 
         game_lerp_free(&gl);
@@ -450,9 +474,13 @@ void game_client_free(const char *next)
         sol_free_draw(&gd.draw);
         sol_free_vary(&gd.vary);
 
-        game_base_free(next);
+        game_base_free(base);
+
+        sol_free_draw(&gd.back.draw);
+        sol_free_vary(&gd.back.vary);
+
+        game_base_free(back);
 
-        sol_free_full(&gd.back);
         back_free();
     }
     gd.state = 0;
@@ -13,7 +13,7 @@ enum
 };
 
 int   game_client_init(const char *);
-void  game_client_free(const char *);
+void  game_client_free(void);
 void  game_client_sync(fs_file);
 void  game_client_draw(int, float);
 void  game_client_blend(float);
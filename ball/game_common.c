@@ -12,12 +12,16 @@
  * General Public License for more details.
  */
 
+#include <SDL.h>
+
 #include "game_common.h"
 #include "vec3.h"
 #include "config.h"
 #include "solid_vary.h"
 #include "hmd.h"
 #include "common.h"
+#include "mtrl.h"
+#include "profile.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -231,46 +235,304 @@ void lockstep_scl(struct lockstep *ls, float ts)
 
 /*---------------------------------------------------------------------------*/
 
-/* Poor man's cache. */
+/* Base cache. */
+
+/*
+ * Parsed SOL bases are kept in a small LRU cache keyed by path, so that
+ * going back and forth between a level, its replays and the next level
+ * does not re-read the file every time.  Bases in use are reference
+ * counted and never evicted.  Unused bases are dropped, least recently
+ * used first, once the total size exceeds "base_cache" megabytes.
+ */
 
-struct s_base  game_base;
-static char   *base_path;
+#define BASE_CACHE_MAX 16
 
-int game_base_load(const char *path)
+struct base_entry
 {
-    if (base_path)
-    {
-        if (strcmp(base_path, path) == 0)
-            return 1;
+    char          *path;                /* File name (NULL if unused)        */
+    struct s_base  base;
+    long           size;                /* Approximate memory usage          */
+    int            refs;                /* Reference count                   */
+    unsigned int   tick;                /* Time of last use                  */
+};
+
+static struct base_entry base_cache[BASE_CACHE_MAX];
+static unsigned int      base_tick;
+static int               base_hits;
+static int               base_misses;
+
+static long base_size(const struct s_base *fp)
+{
+    return (long) (fp->ac * sizeof (*fp->av) +
+                   fp->mc * sizeof (*fp->mv) +
+                   fp->vc * sizeof (*fp->vv) +
+                   fp->ec * sizeof (*fp->ev) +
+                   fp->sc * sizeof (*fp->sv) +
+                   fp->tc * sizeof (*fp->tv) +
+                   fp->oc * sizeof (*fp->ov) +
+                   fp->gc * sizeof (*fp->gv) +
+                   fp->lc * sizeof (*fp->lv) +
+                   fp->nc * sizeof (*fp->nv) +
+                   fp->pc * sizeof (*fp->pv) +
+                   fp->bc * sizeof (*fp->bv) +
+                   fp->hc * sizeof (*fp->hv) +
+                   fp->zc * sizeof (*fp->zv) +
+                   fp->jc * sizeof (*fp->jv) +
+                   fp->xc * sizeof (*fp->xv) +
+                   fp->rc * sizeof (*fp->rv) +
+                   fp->uc * sizeof (*fp->uv) +
+                   fp->wc * sizeof (*fp->wv) +
+                   fp->dc * sizeof (*fp->dv) +
+                   fp->ic * sizeof (*fp->iv));
+}
+
+static struct base_entry *base_find(const char *path)
+{
+    int i;
+
+    for (i = 0; i < BASE_CACHE_MAX; i++)
+        if (base_cache[i].path && strcmp(base_cache[i].path, path) == 0)
+            return &base_cache[i];
+
+    return NULL;
+}
+
+static void base_drop(struct base_entry *ep)
+{
+    sol_free_base(&ep->base);
+    free(ep->path);
+
+    memset(ep, 0, sizeof (*ep));
+}
+
+/*
+ * Find the least recently used base that nobody holds.
+ */
+static struct base_entry *base_oldest(void)
+{
+    struct base_entry *oldest = NULL;
+    int i;
 
-        sol_free_base(&game_base);
+    for (i = 0; i < BASE_CACHE_MAX; i++)
+    {
+        struct base_entry *ep = &base_cache[i];
 
-        free(base_path);
-        base_path = NULL;
+        if (ep->path && ep->refs == 0 && (!oldest || ep->tick < oldest->tick))
+            oldest = ep;
     }
+    return oldest;
+}
+
+static void base_trim(void)
+{
+    long limit = (long) config_get_d(CONFIG_BASE_CACHE) * 1024 * 1024;
+    long total = 0;
+
+    struct base_entry *ep;
+    int i;
+
+    for (i = 0; i < BASE_CACHE_MAX; i++)
+        total += base_cache[i].size;
 
-    if (sol_load_base(&game_base, path))
+    while (total > limit && (ep = base_oldest()))
     {
-        base_path = strdup(path);
-        return 1;
+        total -= ep->size;
+        base_drop(ep);
     }
+}
+
+static struct base_entry *base_slot(void)
+{
+    struct base_entry *ep;
+    int i;
+
+    for (i = 0; i < BASE_CACHE_MAX; i++)
+        if (!base_cache[i].path)
+            return &base_cache[i];
+
+    if ((ep = base_oldest()))
+        base_drop(ep);
+
+    return ep;
+}
+
+/*
+ * Level prefetch.
+ *
+ * While the player sits in a menu, the level likely to be played next is
+ * loaded on a thread of its own, and its textures are queued for decoding.
+ * game_base_load then takes the prefetched base, waiting for the thread
+ * if need be, and only GL work is left for the transition.
+ */
+
+static struct s_base  prefetch_base;
+static char          *prefetch_path;
+static SDL_Thread    *prefetch_thread;
+static SDL_atomic_t   prefetch_done;
+
+static int prefetch_work(void *data)
+{
+    int ok;
+
+    if ((ok = sol_load_base(&prefetch_base, prefetch_path)))
+        mtrl_prefetch_sol(&prefetch_base);
+
+    SDL_AtomicSet(&prefetch_done, 1);
+
+    return ok;
+}
+
+/*
+ * Wait for the prefetch thread, and return whether it succeeded.
+ */
+static int prefetch_wait(void)
+{
+    int ok = 0;
 
-    return 0;
+    if (prefetch_thread)
+    {
+        SDL_WaitThread(prefetch_thread, &ok);
+        prefetch_thread = NULL;
+    }
+    return ok;
 }
 
+static void prefetch_free(void)
+{
+    if (prefetch_wait())
+        sol_free_base(&prefetch_base);
+
+    free(prefetch_path);
+    prefetch_path = NULL;
+}
 
-void game_base_free(const char *next)
+void game_base_prefetch(const char *path)
 {
-    if (base_path)
+    if (!path || base_find(path))
+        return;
+
+    if (prefetch_path)
     {
-        if (next && strcmp(base_path, next) == 0)
+        if (strcmp(prefetch_path, path) == 0)
             return;
 
-        sol_free_base(&game_base);
+        /* Don't stall the menu on a load in progress. */
+
+        if (!SDL_AtomicGet(&prefetch_done))
+            return;
+
+        prefetch_free();
+    }
+
+    prefetch_path = strdup(path);
+
+    SDL_AtomicSet(&prefetch_done, 0);
+
+    if (!(prefetch_thread = SDL_CreateThread(prefetch_work, "prefetch", NULL)))
+    {
+        free(prefetch_path);
+        prefetch_path = NULL;
+    }
+}
+
+/*
+ * Acquire the base loaded from PATH. Release it with game_base_free.
+ */
+struct s_base *game_base_load(const char *path)
+{
+    struct base_entry *ep;
+
+    if ((ep = base_find(path)))
+        base_hits++;
+    else
+    {
+        if (!(ep = base_slot()))
+            return NULL;
+
+        profile_begin("parse", path);
+
+        if (prefetch_path && strcmp(prefetch_path, path) == 0)
+        {
+            if (!prefetch_wait())
+            {
+                prefetch_free();
+                profile_end();
+                return NULL;
+            }
+
+            ep->base      = prefetch_base;
+            ep->path      = prefetch_path;
+            prefetch_path = NULL;
+        }
+        else if (sol_load_base(&ep->base, path))
+            ep->path = strdup(path);
+        else
+        {
+            profile_end();
+            return NULL;
+        }
+
+        profile_end();
+
+        ep->size = base_size(&ep->base);
+        base_misses++;
+    }
+
+    ep->refs++;
+    ep->tick = ++base_tick;
+
+    base_trim();
+
+    return &ep->base;
+}
+
+void game_base_free(struct s_base *base)
+{
+    int i;
 
-        free(base_path);
-        base_path = NULL;
+    for (i = 0; i < BASE_CACHE_MAX; i++)
+    {
+        struct base_entry *ep = &base_cache[i];
+
+        if (ep->path && &ep->base == base && ep->refs > 0)
+        {
+            ep->refs--;
+            ep->tick = ++base_tick;
+            break;
+        }
     }
+    base_trim();
+}
+
+/*
+ * Join any prefetch in progress and release every cached base.
+ */
+void game_base_quit(void)
+{
+    int i;
+
+    prefetch_free();
+
+    for (i = 0; i < BASE_CACHE_MAX; i++)
+        if (base_cache[i].path)
+            base_drop(&base_cache[i]);
+}
+
+void game_base_stat(struct base_stat *st)
+{
+    int i;
+
+    st->hits   = base_hits;
+    st->misses = base_misses;
+    st->count  = 0;
+    st->bytes  = 0;
+
+    for (i = 0; i < BASE_CACHE_MAX; i++)
+        if (base_cache[i].path)
+        {
+            st->count++;
+            st->bytes += base_cache[i].size;
+        }
 }
 
 /*---------------------------------------------------------------------------*/
@@ -119,10 +119,19 @@ void lockstep_scl(struct lockstep *, float);
 
 /*---------------------------------------------------------------------------*/
 
-extern struct s_base game_base;
+struct base_stat
+{
+    int  hits;                          /* Loads served from the cache       */
+    int  misses;                        /* Loads read from disk              */
+    int  count;                         /* Bases in the cache                */
+    long bytes;                         /* Approximate memory held           */
+};
 
-int  game_base_load(const char *);
-void game_base_free(const char *);
+struct s_base *game_base_load(const char *);
+void           game_base_free(struct s_base *);
+void           game_base_prefetch(const char *);
+void           game_base_quit(void);
+void           game_base_stat(struct base_stat *);
 
 /*---------------------------------------------------------------------------*/
 
@@ -19,6 +19,7 @@
 #include "geom.h"
 #include "config.h"
 #include "video.h"
+#include "profile.h"
 
 #include "solid_draw.h"
 
@@ -57,28 +58,9 @@ static void game_draw_items(struct s_rend *rend,
                             const struct s_vary *vary,
                             const float *bill_M, float t)
 {
-    int hi;
+    /* Draw all items not yet picked up, batched by model. */
 
-    for (hi = 0; hi < vary->hc; hi++)
-    {
-        struct v_item *hp = &vary->hv[hi];
-
-        /* Skip picked up items. */
-
-        if (hp->t == ITEM_NONE)
-            continue;
-
-        /* Draw model. */
-
-        glPushMatrix();
-        {
-            glTranslatef(hp->p[0],
-                         hp->p[1],
-                         hp->p[2]);
-            item_draw(rend, hp, bill_M, t);
-        }
-        glPopMatrix();
-    }
+    item_draw_all(rend, vary->hv, vary->hc, bill_M, t);
 }
 
 static void game_draw_beams(struct s_rend *rend, const struct game_draw *gd)
@@ -332,6 +314,8 @@ static void game_draw_fore(struct s_rend *rend,
         }
 
 
+        profile_phase_begin(PHASE_PARTS);
+
         glDepthMask(GL_FALSE);
         {
             /* Draw the billboards, entity beams, and coin particles. */
@@ -360,6 +344,8 @@ static void game_draw_fore(struct s_rend *rend,
         }
         glDepthMask(GL_TRUE);
 
+        profile_phase_end();
+
         if (d < 0)
             glDisable(GL_CLIP_PLANE0);
     }
@@ -443,12 +429,16 @@ void game_draw(struct game_draw *gd, int pose, float t)
 
             /* Draw the background. */
 
+            profile_phase_begin(PHASE_BACK);
             game_draw_back(&rend, gd, pose, +1, t);
+            profile_phase_end();
 
             /* Draw the reflection. */
 
             if (gd->draw.reflective && config_get_d(CONFIG_REFLECTION))
             {
+                profile_phase_begin(PHASE_REFL);
+
                 glEnable(GL_STENCIL_TEST);
                 {
                     /* Draw the mirrors only into the stencil buffer. */
@@ -483,6 +473,8 @@ void game_draw(struct game_draw *gd, int pose, float t)
                     glStencilFunc(GL_ALWAYS, 0, 0xFFFFFFFF);
                 }
                 glDisable(GL_STENCIL_TEST);
+
+                profile_phase_end();
             }
 
             /* Ready the lights for foreground rendering. */
@@ -505,8 +497,10 @@ void game_draw(struct game_draw *gd, int pose, float t)
 
             /* Draw the mirrors and the rest of the foreground. */
 
+            profile_phase_begin(PHASE_FORE);
             game_refl_all (&rend, gd);
             game_draw_fore(&rend, gd, pose, T, +1, t);
+            profile_phase_end();
         }
         glPopMatrix();
         video_pop_matrix();
@@ -21,6 +21,7 @@
 #include "config.h"
 #include "binary.h"
 #include "common.h"
+#include "profile.h"
 
 #include "solid_sim.h"
 #include "solid_all.h"
@@ -436,6 +437,7 @@ static struct lockstep server_step;
 int game_server_init(const char *file_name, int t, int e)
 {
     struct { int x, y; } version;
+    struct s_base *base;
     int i;
 
     timer      = (float) t / 100.f;
@@ -443,16 +445,16 @@ int game_server_init(const char *file_name, int t, int e)
     coins      = 0;
     status     = GAME_NONE;
 
-    game_server_free(file_name);
+    game_server_free();
 
     /* Load SOL data. */
 
-    if (!game_base_load(file_name))
+    if (!(base = game_base_load(file_name)))
         return (server_state = 0);
 
-    if (!sol_load_vary(&vary, &game_base))
+    if (!sol_load_vary(&vary, base))
     {
-        game_base_free(NULL);
+        game_base_free(base);
         return (server_state = 0);
     }
 
@@ -523,14 +525,16 @@ int game_server_init(const char *file_name, int t, int e)
     return server_state;
 }
 
-void game_server_free(const char *next)
+void game_server_free(void)
 {
     if (server_state)
     {
+        struct s_base *base = vary.base;
+
         sol_quit_sim();
         sol_free_vary(&vary);
 
-        game_base_free(next);
+        game_base_free(base);
 
         server_state = 0;
     }
@@ -857,7 +861,9 @@ static struct lockstep server_step = { game_server_iter, DT };
 
 void game_server_step(float dt)
 {
+    profile_phase_begin(PHASE_PHYSICS);
     lockstep_run(&server_step, dt);
+    profile_phase_end();
 }
 
 float game_server_blend(void)
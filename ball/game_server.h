@@ -10,7 +10,7 @@
 /*---------------------------------------------------------------------------*/
 
 int   game_server_init(const char *, int, int);
-void  game_server_free(const char *);
+void  game_server_free(void);
 void  game_server_step(float);
 float game_server_blend(void);
 
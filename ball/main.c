@@ -31,10 +31,15 @@
 #include "tilt.h"
 #include "hmd.h"
 #include "fs.h"
+#include "fs_rwops.h"
 #include "common.h"
 #include "text.h"
 #include "mtrl.h"
 #include "geom.h"
+#include "fbo.h"
+#include "state.h"
+#include "profile.h"
+#include "game_common.h"
 
 #include "st_conf.h"
 #include "st_title.h"
@@ -99,6 +104,9 @@ static int handle_key_dn(SDL_Event *e)
     case KEY_FPS:
         config_tgl_d(CONFIG_FPS);
         break;
+    case KEY_GRAPH:
+        config_tgl_d(CONFIG_GRAPH);
+        break;
     case KEY_WIREFRAME:
         if (config_cheat())
             toggle_wire();
@@ -171,6 +179,8 @@ static int loop(void)
 
     int ax, ay, dx, dy;
 
+    profile_phase_begin(PHASE_INPUT);
+
     /* Process SDL events. */
 
     while (d && SDL_PollEvent(&e))
@@ -311,14 +321,22 @@ static int loop(void)
         }
     }
 
+    profile_phase_end();
+
     return d;
 }
 
 /*---------------------------------------------------------------------------*/
 
+#define PROFILE_FILE "profile.json"
+#define FRAMES_FILE  "frames.json"
+
 static char *opt_data;
 static char *opt_replay;
 static char *opt_level;
+static char *opt_capture;
+static char *opt_bench;
+static int   opt_profile;
 
 #define opt_usage                                                     \
     "Usage: %s [options ...]\n"                                       \
@@ -327,7 +345,10 @@ static char *opt_level;
     "  -v, --version             show version.\n"                     \
     "  -d, --data <dir>          use 'dir' as game data directory.\n" \
     "  -r, --replay <file>       play the replay 'file'.\n"           \
-    "  -l, --level <file>        load the level 'file'\n"
+    "  -l, --level <file>        load the level 'file'\n"             \
+    "  -c, --capture <dir>       save replay frames to 'dir'.\n"      \
+    "      --bench <file>        add replay timings to 'file'.\n"     \
+    "      --profile-startup     save a startup profile.\n"
 
 #define opt_error(option) \
     fprintf(stderr, "Option '%s' requires an argument.\n", option)
@@ -385,6 +406,34 @@ static void opt_parse(int argc, char **argv)
             continue;
         }
 
+        if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--capture") == 0)
+        {
+            if (i + 1 == argc)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            opt_capture = argv[++i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--bench") == 0)
+        {
+            if (i + 1 == argc)
+            {
+                opt_error(argv[i]);
+                exit(EXIT_FAILURE);
+            }
+            opt_bench = argv[++i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "--profile-startup") == 0)
+        {
+            opt_profile = 1;
+            continue;
+        }
+
         /* Perform magic on a single unrecognized argument. */
 
         if (argc == 2)
@@ -418,6 +467,167 @@ static void opt_parse(int argc, char **argv)
 
 /*---------------------------------------------------------------------------*/
 
+#define CAPTURE_FPS 60
+
+/*
+ * Play the replay at a fixed time step, writing each frame to the named
+ * directory. Frames are rendered to an offscreen framebuffer where
+ * possible, so the result does not depend on the window or on how fast
+ * the machine renders.
+ */
+static void capture(const char *dir)
+{
+    const float dt = 1.0f / CAPTURE_FPS;
+
+    char filename[MAXSTR];
+    int  frame = 0;
+    int  offscreen;
+    fbo  F;
+
+    memset(&F, 0, sizeof (F));
+
+    if (curr_state() != &st_demo_play)
+    {
+        log_printf("Failure to capture %s: not a playable replay\n",
+                   opt_replay);
+        return;
+    }
+
+    fs_mkdir(dir);
+
+    /* Render off-screen if possible, falling back to the window. */
+
+    if ((offscreen = fbo_create(&F, video.device_w, video.device_h)))
+        glBindFramebuffer_(GL_FRAMEBUFFER, F.framebuffer);
+
+    while (curr_state() == &st_demo_play && loop())
+    {
+        st_timer(dt);
+
+        /* Make sure every texture is in place before rendering. */
+
+        image_wait();
+
+        st_paint(dt * frame);
+
+        sprintf(filename, "%s/frame%05d.png", dir, frame++);
+        image_snap(filename);
+
+        if (!offscreen)
+            video_swap();
+    }
+
+    if (offscreen)
+    {
+        glBindFramebuffer_(GL_FRAMEBUFFER, 0);
+        fbo_delete(&F);
+    }
+
+    log_printf("Captured %d frames to %s\n", frame, dir);
+}
+
+/*---------------------------------------------------------------------------*/
+
+#define BENCH_FPS 60
+
+/*
+ * Play the replay at a fixed time step as fast as possible and append
+ * its timings to the named file as one line of JSON.  Frames are never
+ * swapped, so the frame rate is not tied to the display.  Instead, each
+ * frame waits for the GPU to finish, as a swap would.
+ */
+static int bench(const char *path, double load)
+{
+    const float dt = 1.0f / BENCH_FPS;
+
+    Uint64 t, update = 0;
+    long   heap0, heap1, peak;
+    double tick = 0.0;
+    float  draw_cpu = 0.0f;
+    float  draw_gpu = 0.0f;
+    int    frame = 0, ticks, n, i;
+    FILE  *fp;
+
+    if (curr_state() != &st_demo_play)
+    {
+        log_printf("Failure to bench %s: not a playable replay\n",
+                   opt_replay);
+        return 0;
+    }
+
+    profile_frame_record(1);
+    profile_frame();
+
+    profile_memory(&heap0, &peak);
+
+    while (curr_state() == &st_demo_play && loop())
+    {
+        t = SDL_GetPerformanceCounter();
+        st_timer(dt);
+        update += SDL_GetPerformanceCounter() - t;
+
+        /* Make sure every texture is in place before rendering. */
+
+        image_wait();
+
+        st_paint(dt * frame++);
+
+        profile_phase_begin(PHASE_SWAP);
+        glFinish();
+        profile_phase_end();
+
+        profile_frame();
+    }
+
+    profile_memory(&heap1, &peak);
+
+    /* Sum up the drawing phases.  GPU time is unknown if any is. */
+
+    n     = MIN(frame, profile_frame_count());
+    ticks = demo_replay_ticks();
+
+    if (ticks > 0)
+        tick = 1000.0 * update / SDL_GetPerformanceFrequency() / ticks;
+
+    for (i = PHASE_BACK; i <= PHASE_GUI; i++)
+    {
+        float g = profile_frame_phase(n, i, 1);
+
+        draw_cpu += profile_frame_phase(n, i, 0);
+        draw_gpu  = (g < 0.0f || draw_gpu < 0.0f) ? -1.0f : draw_gpu + g;
+    }
+
+    if (!(fp = fopen(path, "a")))
+    {
+        log_printf("Failure to open %s\n", path);
+        return 0;
+    }
+
+    fprintf(fp,
+            "{\"version\":\"%s\",\"replay\":\"%s\","
+            "\"frames\":%d,\"ticks\":%d,\"load_ms\":%.3f,"
+            "\"tick_ms\":%.4f,\"frame_p50_ms\":%.3f,"
+            "\"frame_p99_ms\":%.3f,\"frame_max_ms\":%.3f,"
+            "\"draw_cpu_ms\":%.3f,\"draw_gpu_ms\":%.3f,"
+            "\"heap_kb\":%ld,\"heap_growth_kb\":%ld,"
+            "\"peak_rss_kb\":%ld}\n",
+            VERSION, base_name(opt_replay),
+            frame, ticks, load, tick,
+            (double) profile_frame_time(n,  50.0f),
+            (double) profile_frame_time(n,  99.0f),
+            (double) profile_frame_time(n, 100.0f),
+            (double) draw_cpu, (double) draw_gpu,
+            heap0, (heap0 < 0) ? -1 : heap1 - heap0, peak);
+    fclose(fp);
+
+    log_printf("Benchmarked %s: %d frames, %d ticks\n",
+               opt_replay, frame, ticks);
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
 static int is_replay(struct dir_item *item)
 {
     return str_ends_with(item->path, ".nbr");
@@ -479,7 +689,8 @@ static void make_dirs_and_migrate(void)
 int main(int argc, char *argv[])
 {
     SDL_Joystick *joy = NULL;
-    int t1, t0;
+    Uint64 tl;
+    int t1, t0, status = 0;
 
     if (!fs_init(argv[0]))
     {
@@ -488,28 +699,47 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    /* Worker threads open files too. */
+
+    fs_rwops_lock();
+
     opt_parse(argc, argv);
 
+    if (opt_profile)
+        profile_init();
+
+    profile_begin("startup", NULL);
+
+    profile_begin("paths", NULL);
     config_paths(opt_data);
     log_init("Neverball", "neverball.log");
     make_dirs_and_migrate();
+    profile_end();
 
     /* Initialize SDL. */
 
+    profile_begin("SDL", NULL);
+
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK) == -1)
     {
         log_printf("Failure to initialize SDL (%s)\n", SDL_GetError());
         return 1;
     }
 
+    profile_end();
+
     /* Intitialize configuration. */
 
+    profile_begin("config", NULL);
     config_init();
     config_load();
+    profile_end();
 
     /* Initialize localization. */
 
+    profile_begin("lang", NULL);
     lang_init();
+    profile_end();
 
     /* Initialize joystick. */
 
@@ -522,17 +752,26 @@ int main(int argc, char *argv[])
 
     /* Initialize audio. */
 
+    profile_begin("audio", NULL);
     audio_init();
     tilt_init();
+    profile_end();
 
     /* Initialize video. */
 
+    profile_begin("video", NULL);
+
     if (!video_init())
         return 1;
 
-    /* Material system. */
+    profile_end();
 
+    /* Image decoding and material system. */
+
+    profile_begin("image", NULL);
+    image_init();
     mtrl_init();
+    profile_end();
 
     /* Screen states. */
 
@@ -540,6 +779,8 @@ int main(int argc, char *argv[])
 
     /* Initialize demo playback or load the level. */
 
+    tl = SDL_GetPerformanceCounter();
+
     if (opt_replay &&
         fs_add_path(dir_name(opt_replay)) &&
         progress_replay(base_name(opt_replay)))
@@ -576,34 +817,74 @@ int main(int argc, char *argv[])
     else
         goto_state(&st_title);
 
-    /* Run the main game loop. */
+    tl = SDL_GetPerformanceCounter() - tl;
+
+    profile_end();
+
+    /* Write the start-up profile now, in case we don't exit cleanly. */
+
+    if (opt_profile)
+    {
+        log_printf("Started up in %.1f ms\n", profile_time());
+        profile_dump(PROFILE_FILE);
+    }
 
-    t0 = SDL_GetTicks();
+    /* Render the replay offline, or run the main game loop. */
 
-    while (loop())
+    if (opt_capture)
+        capture(opt_capture);
+    else if (opt_bench)
     {
-        if ((t1 = SDL_GetTicks()) > t0)
+        if (!bench(opt_bench, 1000.0 * tl / SDL_GetPerformanceFrequency()))
+            status = 1;
+    }
+    else
+    {
+        t0 = SDL_GetTicks();
+
+        while (loop())
         {
-            /* Step the game state. */
+            if ((t1 = SDL_GetTicks()) > t0)
+            {
+                /* Step the game state. */
 
-            st_timer(0.001f * (t1 - t0));
+                st_timer(0.001f * (t1 - t0));
 
-            t0 = t1;
+                t0 = t1;
 
-            /* Render. */
+                /* Render. */
 
-            hmd_step();
-            st_paint(0.001f * t0);
-            video_swap();
+                hmd_step();
+                st_paint(0.001f * t0);
+                video_swap();
 
-            if (config_get_d(CONFIG_NICE))
-                SDL_Delay(1);
+                if (config_get_d(CONFIG_NICE))
+                    SDL_Delay(1);
+            }
         }
     }
 
     config_save();
 
+    /* Rewrite the profile with any level loads since. */
+
+    if (opt_profile)
+    {
+        profile_dump(PROFILE_FILE);
+        profile_quit();
+    }
+
+    /* Export frame timings recorded for the graph or stats. */
+
+    profile_frame_dump(FRAMES_FILE);
+
+    /* Stop level prefetch before the texture and material threads go. */
+
+    game_base_quit();
+
     mtrl_quit();
+    image_quit();
+    audio_free();
 
     if (joy)
         SDL_JoystickClose(joy);
@@ -612,7 +893,7 @@ int main(int argc, char *argv[])
     hmd_free();
     SDL_Quit();
 
-    return 0;
+    return status;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -20,11 +20,14 @@
 #include "lang.h"
 #include "score.h"
 #include "audio.h"
+#include "profile.h"
 
 #include "game_common.h"
 #include "game_client.h"
 #include "game_server.h"
 
+#include <SDL.h>
+#include <stdio.h>
 #include <assert.h>
 
 /*---------------------------------------------------------------------------*/
@@ -92,6 +95,10 @@ void progress_init(int m)
 
 static int init_level(void)
 {
+    Uint64 t = SDL_GetPerformanceCounter();
+
+    profile_begin("level", level_file(level));
+
     demo_play_init(USER_REPLAY_FILE, level, mode,
                    curr.score, curr.balls, curr.times);
 
@@ -106,10 +113,30 @@ static int init_level(void)
     {
         game_client_sync(demo_fp);
         audio_music_fade_to(2.0f, level_song(level));
+
+        /* Report the time taken to load the level if configured. */
+
+        if (config_get_d(CONFIG_STATS))
+        {
+            struct base_stat bs;
+
+            t = SDL_GetPerformanceCounter() - t;
+
+            game_base_stat(&bs);
+
+            fprintf(stdout, "level %8.4f %s (cache %d hit %d miss %d KB)\n",
+                    1000.0 * t / SDL_GetPerformanceFrequency(),
+                    level_file(level), bs.hits, bs.misses,
+                    (int) (bs.bytes / 1024));
+        }
+
+        profile_end();
         return 1;
     }
 
     demo_play_stop(1);
+
+    profile_end();
     return 0;
 }
 
@@ -294,6 +321,17 @@ int  progress_next_avail(void)
     return 0;
 }
 
+/*
+ * Start loading the level most likely to be played next.
+ */
+void progress_prefetch(void)
+{
+    if (progress_next_avail())
+        game_base_prefetch(level_file(next));
+    else if (level)
+        game_base_prefetch(level_file(level));
+}
+
 int  progress_same_avail(void)
 {
     switch (status)
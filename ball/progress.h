@@ -18,6 +18,8 @@ int  progress_next(void);
 int  progress_same_avail(void);
 int  progress_same(void);
 
+void progress_prefetch(void);
+
 void progress_rename(int);
 
 int  progress_replay(const char *);
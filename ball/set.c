@@ -23,6 +23,7 @@
 #include "set.h"
 #include "common.h"
 #include "fs.h"
+#include "binary.h"
 
 #include "game_server.h"
 #include "game_client.h"
@@ -72,20 +73,18 @@ static void put_score(fs_file fp, const struct score *s)
         fs_printf(fp, "%d %d %s\n", s->timer[i], s->coins[i], s->player[i]);
 }
 
-static int get_score(fs_file fp, struct score *s)
+static int get_score(fs_lines lr, struct score *s)
 {
-    char line[MAXSTR];
+    char *line;
     int i;
 
     for (i = RANK_HARD; i <= RANK_EASY; i++)
     {
         int n = -1;
 
-        if (!fs_gets(line, sizeof (line), fp))
+        if (!(line = fs_lines_get(lr)))
             return 0;
 
-        strip_newline(line);
-
         if (sscanf(line, "%d %d %n", &s->timer[i], &s->coins[i], &n) < 2)
             return 0;
 
@@ -132,7 +131,7 @@ void set_store_hs(void)
     }
 }
 
-static void set_load_hs_v1(fs_file fp, struct set *s, char *buf, int size)
+static void set_load_hs_v1(fs_lines lr, struct set *s, const char *buf)
 {
     struct level *l;
     int i, n;
@@ -149,16 +148,16 @@ static void set_load_hs_v1(fs_file fp, struct set *s, char *buf, int size)
         l->is_completed = (buf[i] == 'C');
     }
 
-    get_score(fp, &s->time_score);
-    get_score(fp, &s->coin_score);
+    get_score(lr, &s->time_score);
+    get_score(lr, &s->coin_score);
 
     for (i = 0; i < n; i++)
     {
         l = &level_v[i];
 
-        get_score(fp, &l->scores[SCORE_TIME]);
-        get_score(fp, &l->scores[SCORE_GOAL]);
-        get_score(fp, &l->scores[SCORE_COIN]);
+        get_score(lr, &l->scores[SCORE_TIME]);
+        get_score(lr, &l->scores[SCORE_GOAL]);
+        get_score(lr, &l->scores[SCORE_COIN]);
     }
 }
 
@@ -173,7 +172,7 @@ static struct level *find_level(const struct set *s, const char *file)
     return NULL;
 }
 
-static void set_load_hs_v2(fs_file fp, struct set *s, char *buf, int size)
+static void set_load_hs_v2(fs_lines lr, struct set *s)
 {
     struct score time_score;
     struct score coin_score;
@@ -181,18 +180,18 @@ static void set_load_hs_v2(fs_file fp, struct set *s, char *buf, int size)
     int set_score = 0;
     int set_match = 1;
 
-    while (fs_gets(buf, size, fp))
+    char *buf;
+
+    while ((buf = fs_lines_get(lr)))
     {
         int version = 0;
         int flags = 0;
         int n = 0;
 
-        strip_newline(buf);
-
         if (strncmp(buf, "set ", 4) == 0)
         {
-            get_score(fp, &time_score);
-            get_score(fp, &coin_score);
+            get_score(lr, &time_score);
+            get_score(lr, &coin_score);
 
             set_score = 1;
         }
@@ -212,9 +211,9 @@ static void set_load_hs_v2(fs_file fp, struct set *s, char *buf, int size)
                 {
                     l->is_completed = !!(flags & LEVEL_COMPLETED);
 
-                    get_score(fp, &l->scores[SCORE_TIME]);
-                    get_score(fp, &l->scores[SCORE_GOAL]);
-                    get_score(fp, &l->scores[SCORE_COIN]);
+                    get_score(lr, &l->scores[SCORE_TIME]);
+                    get_score(lr, &l->scores[SCORE_GOAL]);
+                    get_score(lr, &l->scores[SCORE_COIN]);
                 }
                 else set_match = 0;
             }
@@ -232,46 +231,476 @@ static void set_load_hs_v2(fs_file fp, struct set *s, char *buf, int size)
 static void set_load_hs(void)
 {
     struct set *s = SET_GET(sets, curr);
-    fs_file fp;
+    fs_lines lr;
 
-    if ((fp = fs_open(config_cheat() ? s->cheat_scores : s->user_scores, "r")))
+    if ((lr = fs_lines_open(config_cheat() ? s->cheat_scores : s->user_scores)))
     {
-        char buf[MAXSTR];
+        char *buf;
 
-        if (fs_gets(buf, sizeof (buf), fp))
+        if ((buf = fs_lines_get(lr)))
         {
-            strip_newline(buf);
-
             if (sscanf(buf, "version %d", &score_version) == 1)
             {
                 switch (score_version)
                 {
-                case 2: set_load_hs_v2(fp, s, buf, sizeof (buf)); break;
+                case 2: set_load_hs_v2(lr, s); break;
                 }
             }
             else
-                set_load_hs_v1(fp, s, buf, sizeof (buf));
+                set_load_hs_v1(lr, s, buf);
+        }
+
+        fs_lines_close(lr);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void set_free(struct set *s)
+{
+    int i;
+
+    free(s->name);
+    free(s->desc);
+    free(s->id);
+    free(s->shot);
+
+    free(s->user_scores);
+    free(s->cheat_scores);
+
+    for (i = 0; i < s->count; i++)
+        free(s->level_name_v[i]);
+}
+
+static void set_copy(struct set *dst, const struct set *src)
+{
+    int i;
+
+    *dst = *src;
+
+    dst->name = strdup(src->name);
+    dst->desc = strdup(src->desc);
+    dst->id   = strdup(src->id);
+    dst->shot = strdup(src->shot);
+
+    dst->user_scores  = strdup(src->user_scores);
+    dst->cheat_scores = strdup(src->cheat_scores);
+
+    for (i = 0; i < src->count; i++)
+        dst->level_name_v[i] = strdup(src->level_name_v[i]);
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Metadata index.
+ *
+ * Set descriptions and level headers are recorded in a single file in
+ * the user directory, so that the set and level menus open neither set
+ * files nor SOL files. Each entry is keyed by path and stamped with the
+ * modification time of its source; a changed file is simply read afresh
+ * and its entry replaced.
+ */
+
+#define INDEX_FILE  "levels.idx"
+#define INDEX_MAGIC 0x58444E4C          /* "LNDX" */
+#define INDEX_VER   1
+
+struct index_set
+{
+    int        mtime;                   /* Source modification time          */
+    struct set set;                     /* Keyed by file                     */
+};
+
+struct index_level
+{
+    int          mtime;                 /* Source modification time          */
+    struct level level;                 /* Keyed by file                     */
+};
+
+static Array index_sets;
+static Array index_levels;
+static int   index_dirty;
+
+/* Positions of the entries, by file name. */
+
+static struct str_map index_set_map;
+static struct str_map index_level_map;
+
+static struct index_set *index_find_set(const char *path)
+{
+    int i = str_map_get(&index_set_map, path, -1);
+    return i < 0 ? NULL : array_get(index_sets, i);
+}
+
+static struct index_level *index_find_level(const char *path)
+{
+    int i = str_map_get(&index_level_map, path, -1);
+    return i < 0 ? NULL : array_get(index_levels, i);
+}
+
+static struct index_set *index_add_set(const char *path)
+{
+    str_map_put(&index_set_map, path, array_len(index_sets));
+    return array_add(index_sets);
+}
+
+static struct index_level *index_add_level(const char *path)
+{
+    str_map_put(&index_level_map, path, array_len(index_levels));
+    return array_add(index_levels);
+}
+
+static void put_index_set(fs_file fp, const struct index_set *e)
+{
+    const struct set *s = &e->set;
+    int i;
+
+    put_string(fp, s->file);
+    put_index (fp, e->mtime);
+    put_string(fp, s->name);
+    put_string(fp, s->desc);
+    put_string(fp, s->id);
+    put_string(fp, s->shot);
+
+    for (i = RANK_HARD; i <= RANK_EASY; i++)
+    {
+        put_index(fp, s->time_score.timer[i]);
+        put_index(fp, s->coin_score.coins[i]);
+    }
+
+    put_index(fp, s->count);
+
+    for (i = 0; i < s->count; i++)
+        put_string(fp, s->level_name_v[i]);
+}
+
+static int get_index_set(fs_file fp, struct index_set *e)
+{
+    struct set *s = &e->set;
+    char buf[4][MAXSTR];
+    int i;
+
+    memset(e, 0, sizeof (*e));
+
+    score_init_hs(&s->time_score, 359999, 0);
+    score_init_hs(&s->coin_score, 359999, 0);
+
+    get_string(fp, s->file, sizeof (s->file));
+    e->mtime = get_index(fp);
+
+    for (i = 0; i < 4; i++)
+        get_string(fp, buf[i], sizeof (buf[i]));
+
+    for (i = RANK_HARD; i <= RANK_EASY; i++)
+    {
+        s->time_score.timer[i] = get_index(fp);
+        s->coin_score.coins[i] = get_index(fp);
+    }
+
+    if ((s->count = get_index(fp)) < 0 || s->count > MAXLVL)
+        return 0;
+
+    s->name = strdup(buf[0]);
+    s->desc = strdup(buf[1]);
+    s->id   = strdup(buf[2]);
+    s->shot = strdup(buf[3]);
+
+    s->user_scores  = concat_string("Scores/", s->id, ".txt",       NULL);
+    s->cheat_scores = concat_string("Scores/", s->id, "-cheat.txt", NULL);
+
+    for (i = 0; i < s->count; i++)
+    {
+        get_string(fp, buf[0], sizeof (buf[0]));
+        s->level_name_v[i] = strdup(buf[0]);
+    }
+    return 1;
+}
+
+static void put_index_level(fs_file fp, const struct index_level *e)
+{
+    const struct level *l = &e->level;
+    int i, j;
+
+    put_string(fp, l->file);
+    put_index (fp, e->mtime);
+    put_string(fp, l->shot);
+    put_string(fp, l->song);
+    put_string(fp, l->message);
+    put_string(fp, l->version_str);
+    put_index (fp, l->version_num);
+    put_string(fp, l->author);
+    put_index (fp, l->time);
+    put_index (fp, l->goal);
+    put_index (fp, l->is_bonus);
+
+    for (i = SCORE_TIME; i <= SCORE_COIN; i++)
+        for (j = RANK_HARD; j <= RANK_EASY; j++)
+        {
+            put_index(fp, l->scores[i].timer[j]);
+            put_index(fp, l->scores[i].coins[j]);
+        }
+}
+
+static int get_index_level(fs_file fp, struct index_level *e)
+{
+    struct level *l = &e->level;
+    int i, j;
+
+    memset(e, 0, sizeof (*e));
+
+    /* Mirror the defaults of level_load. */
+
+    SAFECPY(l->name, "00");
+
+    score_init_hs(&l->scores[SCORE_TIME], 59999, 0);
+    score_init_hs(&l->scores[SCORE_GOAL], 59999, 0);
+    score_init_hs(&l->scores[SCORE_COIN], 59999, 0);
+
+    get_string(fp, l->file, sizeof (l->file));
+    e->mtime = get_index(fp);
+    get_string(fp, l->shot,        sizeof (l->shot));
+    get_string(fp, l->song,        sizeof (l->song));
+    get_string(fp, l->message,     sizeof (l->message));
+    get_string(fp, l->version_str, sizeof (l->version_str));
+    l->version_num = get_index(fp);
+    get_string(fp, l->author,      sizeof (l->author));
+    l->time        = get_index(fp);
+    l->goal        = get_index(fp);
+    l->is_bonus    = get_index(fp);
+
+    for (i = SCORE_TIME; i <= SCORE_COIN; i++)
+        for (j = RANK_HARD; j <= RANK_EASY; j++)
+        {
+            l->scores[i].timer[j] = get_index(fp);
+            l->scores[i].coins[j] = get_index(fp);
+        }
+
+    return 1;
+}
+
+static void index_free(void)
+{
+    int i;
+
+    if (index_sets)
+    {
+        for (i = 0; i < array_len(index_sets); i++)
+            set_free(&((struct index_set *) array_get(index_sets, i))->set);
+
+        array_free(index_sets);
+        index_sets = NULL;
+    }
+
+    if (index_levels)
+    {
+        array_free(index_levels);
+        index_levels = NULL;
+    }
+
+    str_map_free(&index_set_map);
+    str_map_free(&index_level_map);
+
+    index_dirty = 0;
+}
+
+static void index_load(void)
+{
+    fs_file fp;
+    int ok = 0;
+
+    index_sets   = array_new(sizeof (struct index_set));
+    index_levels = array_new(sizeof (struct index_level));
+
+    if ((fp = fs_open(INDEX_FILE, "r")))
+    {
+        if (get_index(fp) == INDEX_MAGIC &&
+            get_index(fp) == INDEX_VER)
+        {
+            int i, n;
+
+            ok = 1;
+
+            for (n = get_index(fp), i = 0; ok && i < n; i++)
+            {
+                struct index_set *e = array_add(index_sets);
+
+                if ((ok = get_index_set(fp, e)))
+                    str_map_put(&index_set_map, e->set.file, i);
+                else
+                    array_del(index_sets);
+            }
+
+            for (n = get_index(fp), i = 0; ok && i < n; i++)
+            {
+                struct index_level *e = array_add(index_levels);
+
+                if ((ok = get_index_level(fp, e)))
+                    str_map_put(&index_level_map, e->level.file, i);
+                else
+                    array_del(index_levels);
+            }
+
+            /* A trailing magic guards against a truncated file. */
+
+            ok = ok && (get_index(fp) == INDEX_MAGIC);
         }
+        fs_close(fp);
+    }
+
+    if (!ok)
+    {
+        index_free();
+
+        index_sets   = array_new(sizeof (struct index_set));
+        index_levels = array_new(sizeof (struct index_level));
+    }
+}
+
+static void index_save(void)
+{
+    fs_file fp;
+    int i;
+
+    if (!index_dirty)
+        return;
+
+    /* Write to a temporary, so that readers never see a partial file. */
+
+    if ((fp = fs_open(INDEX_FILE ".tmp", "w")))
+    {
+        put_index(fp, INDEX_MAGIC);
+        put_index(fp, INDEX_VER);
+
+        put_index(fp, array_len(index_sets));
+
+        for (i = 0; i < array_len(index_sets); i++)
+            put_index_set(fp, array_get(index_sets, i));
+
+        put_index(fp, array_len(index_levels));
+
+        for (i = 0; i < array_len(index_levels); i++)
+            put_index_level(fp, array_get(index_levels, i));
+
+        put_index(fp, INDEX_MAGIC);
 
         fs_close(fp);
+        fs_rename(INDEX_FILE ".tmp", INDEX_FILE);
+    }
+
+    index_dirty = 0;
+}
+
+/*
+ * Strings longer than the index buffers are not indexed. Such a set is
+ * read from its file every time.
+ */
+static int index_fits(const struct set *s)
+{
+    int i;
+
+    if (strlen(s->name) >= MAXSTR ||
+        strlen(s->desc) >= MAXSTR ||
+        strlen(s->id)   >= MAXSTR ||
+        strlen(s->shot) >= MAXSTR)
+        return 0;
+
+    for (i = 0; i < s->count; i++)
+        if (strlen(s->level_name_v[i]) >= MAXSTR)
+            return 0;
+
+    return 1;
+}
+
+static void index_put_set(const struct set *s, int mtime)
+{
+    struct index_set *e;
+
+    if (!index_sets || mtime == -1 || !index_fits(s))
+        return;
+
+    if ((e = index_find_set(s->file)))
+        set_free(&e->set);
+    else
+        e = index_add_set(s->file);
+
+    e->mtime = mtime;
+    set_copy(&e->set, s);
+
+    index_dirty = 1;
+}
+
+static int index_get_set(struct set *s, const char *path, int mtime)
+{
+    struct index_set *e;
+
+    if (index_sets && mtime != -1 && (e = index_find_set(path)) &&
+        e->mtime == mtime)
+    {
+        set_copy(s, &e->set);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Load level metadata from the index, falling back to the SOL file.
+ */
+static int index_level_load(const char *path, struct level *l)
+{
+    struct index_level *e = NULL;
+    int mtime = (int) fs_mtime(path);
+
+    if (index_levels && mtime != -1 && (e = index_find_level(path)) &&
+        e->mtime == mtime)
+    {
+        *l = e->level;
+        return 1;
+    }
+
+    if (!level_load(path, l))
+        return 0;
+
+    if (index_levels && mtime != -1)
+    {
+        if (!e)
+            e = index_add_level(path);
+
+        e->mtime = mtime;
+        e->level = *l;
+
+        index_dirty = 1;
     }
+    return 1;
 }
 
 /*---------------------------------------------------------------------------*/
 
+static char *dupe_line(fs_lines lr)
+{
+    char *line = fs_lines_get(lr);
+    return line ? strdup(line) : NULL;
+}
+
 static int set_load(struct set *s, const char *filename)
 {
-    fs_file fin;
+    fs_lines lr;
     char *scores, *level_name;
+    int mtime;
 
     /* Skip "Misc" set when not in dev mode. */
 
     if (strcmp(filename, SET_MISC) == 0 && !config_cheat())
         return 0;
 
-    fin = fs_open(filename, "r");
+    mtime = (int) fs_mtime(filename);
+
+    if (index_get_set(s, filename, mtime))
+        return 1;
+
+    lr = fs_lines_open(filename);
 
-    if (!fin)
+    if (!lr)
     {
         log_printf("Failure to load set file %s\n", filename);
         return 0;
@@ -286,11 +715,11 @@ static int set_load(struct set *s, const char *filename)
 
     SAFECPY(s->file, filename);
 
-    if (read_line(&s->name, fin) &&
-        read_line(&s->desc, fin) &&
-        read_line(&s->id,   fin) &&
-        read_line(&s->shot, fin) &&
-        read_line(&scores,  fin))
+    if ((s->name = dupe_line(lr)) &&
+        (s->desc = dupe_line(lr)) &&
+        (s->id   = dupe_line(lr)) &&
+        (s->shot = dupe_line(lr)) &&
+        (scores  = fs_lines_get(lr)))
     {
         sscanf(scores, "%d %d %d %d %d %d",
                &s->time_score.timer[RANK_HARD],
@@ -300,20 +729,20 @@ static int set_load(struct set *s, const char *filename)
                &s->coin_score.coins[RANK_MEDM],
                &s->coin_score.coins[RANK_EASY]);
 
-        free(scores);
-
         s->user_scores  = concat_string("Scores/", s->id, ".txt",       NULL);
         s->cheat_scores = concat_string("Scores/", s->id, "-cheat.txt", NULL);
 
         s->count = 0;
 
-        while (s->count < MAXLVL && read_line(&level_name, fin))
+        while (s->count < MAXLVL && (level_name = dupe_line(lr)))
         {
             s->level_name_v[s->count] = level_name;
             s->count++;
         }
 
-        fs_close(fin);
+        fs_lines_close(lr);
+
+        index_put_set(s, mtime);
 
         return 1;
     }
@@ -323,27 +752,11 @@ static int set_load(struct set *s, const char *filename)
     free(s->id);
     free(s->shot);
 
-    fs_close(fin);
+    fs_lines_close(lr);
 
     return 0;
 }
 
-static void set_free(struct set *s)
-{
-    int i;
-
-    free(s->name);
-    free(s->desc);
-    free(s->id);
-    free(s->shot);
-
-    free(s->user_scores);
-    free(s->cheat_scores);
-
-    for (i = 0; i < s->count; i++)
-        free(s->level_name_v[i]);
-}
-
 /*---------------------------------------------------------------------------*/
 
 static int cmp_dir_items(const void *A, const void *B)
@@ -352,27 +765,20 @@ static int cmp_dir_items(const void *A, const void *B)
     return strcmp(a->path, b->path);
 }
 
-static int set_is_loaded(const char *path)
-{
-    int i;
-
-    for (i = 0; i < array_len(sets); i++)
-        if (strcmp(SET_GET(sets, i)->file, path) == 0)
-            return 1;
+/* Files of the sets loaded so far, during the directory scan. */
 
-    return 0;
-}
+static struct str_map loaded_sets;
 
 static int is_unseen_set(struct dir_item *item)
 {
     return (str_starts_with(base_name(item->path), "set-") &&
             str_ends_with(item->path, ".txt") &&
-            !set_is_loaded(item->path));
+            !str_map_get(&loaded_sets, item->path, 0));
 }
 
 int set_init()
 {
-    fs_file fin;
+    fs_lines lr;
     char *name;
 
     Array items;
@@ -384,22 +790,22 @@ int set_init()
     sets = array_new(sizeof (struct set));
     curr = 0;
 
+    index_load();
+
     /*
      * First, load the sets listed in the set file, preserving order.
      */
 
-    if ((fin = fs_open(SET_FILE, "r")))
+    if ((lr = fs_lines_open(SET_FILE)))
     {
-        while (read_line(&name, fin))
+        while ((name = fs_lines_get(lr)))
         {
             struct set *s = array_add(sets);
 
             if (!set_load(s, name))
                 array_del(sets);
-
-            free(name);
         }
-        fs_close(fin);
+        fs_lines_close(lr);
     }
 
     /*
@@ -407,7 +813,16 @@ int set_init()
      * them after the first group in alphabetic order.
      */
 
-    if ((items = fs_dir_scan("", is_unseen_set)))
+    str_map_init(&loaded_sets);
+
+    for (i = 0; i < array_len(sets); i++)
+        str_map_put(&loaded_sets, SET_GET(sets, i)->file, 1);
+
+    items = fs_dir_scan("", is_unseen_set);
+
+    str_map_free(&loaded_sets);
+
+    if (items)
     {
         array_sort(items, cmp_dir_items);
 
@@ -422,6 +837,8 @@ int set_init()
         fs_dir_free(items);
     }
 
+    index_save();
+
     return array_len(sets);
 }
 
@@ -434,6 +851,8 @@ void set_quit(void)
 
     array_free(sets);
     sets = NULL;
+
+    index_free();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -494,7 +913,7 @@ static void set_load_levels(void)
     {
         struct level *l = &level_v[i];
 
-        level_load(s->level_name_v[i], l);
+        index_level_load(s->level_name_v[i], l);
 
         l->number = i;
 
@@ -517,6 +936,8 @@ void set_goto(int i)
 
     set_load_levels();
     set_load_hs();
+
+    index_save();
 }
 
 int curr_set(void)
@@ -577,6 +998,10 @@ void level_snap(int i, const char *path)
         game_proxy_enq(&cmd);
         game_client_sync(NULL);
 
+        /* Make sure every texture is in place before rendering. */
+
+        image_wait();
+
         /* Render the level and grab the screen. */
 
         video_clear();
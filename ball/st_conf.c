@@ -21,6 +21,7 @@
 #include "config.h"
 #include "video.h"
 #include "common.h"
+#include "profile.h"
 
 #include "game_common.h"
 #include "game_client.h"
@@ -195,7 +196,7 @@ static int conf_gui(void)
 
 static int conf_enter(struct state *st, struct state *prev)
 {
-    game_client_free(NULL);
+    game_client_free();
     conf_common_init(conf_action);
     return conf_gui();
 }
@@ -221,13 +222,27 @@ static int null_enter(struct state *st, struct state *prev)
 
 static void null_leave(struct state *st, struct state *next, int id)
 {
+    profile_begin("textures", NULL);
     mtrl_load_objects();
+    profile_end();
+
+    profile_begin("particles", NULL);
     part_init();
     shad_init();
+    profile_end();
+
+    profile_begin("ball", NULL);
     ball_init();
+    profile_end();
+
+    profile_begin("geom", NULL);
     geom_init();
+    profile_end();
+
+    profile_begin("gui", NULL);
     gui_init();
     hud_init();
+    profile_end();
 }
 
 /*---------------------------------------------------------------------------*/
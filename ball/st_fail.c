@@ -130,6 +130,8 @@ static int fail_enter(struct state *st, struct state *prev)
     if (!resume)
         status = curr_status();
 
+    progress_prefetch();
+
     return fail_gui();
 }
 
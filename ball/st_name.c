@@ -136,7 +136,7 @@ static int name_enter(struct state *st, struct state *prev)
 {
     if (draw_back)
     {
-        game_client_free(NULL);
+        game_client_free();
         back_init("back/gui.png");
     }
 
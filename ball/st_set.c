@@ -19,6 +19,7 @@
 #include "config.h"
 #include "util.h"
 #include "common.h"
+#include "profile.h"
 
 #include "game_common.h"
 
@@ -136,7 +137,10 @@ static int set_enter(struct state *st, struct state *prev)
 {
     if (do_init)
     {
+        profile_begin("sets", NULL);
         total = set_init();
+        profile_end();
+
         first = MIN(first, (total - 1) - ((total - 1) % SET_STEP));
 
         audio_music_fade_to(0.5f, "bgm/inter.ogg");
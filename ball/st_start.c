@@ -249,10 +249,22 @@ static int start_gui(void)
 
 static int start_enter(struct state *st, struct state *prev)
 {
+    struct level *l;
+    int i;
+
     progress_init(MODE_NORMAL);
 
     audio_music_fade_to(0.5f, "bgm/inter.ogg");
 
+    /* Prefetch the first level yet to be completed. */
+
+    for (i = 0; (l = get_level(i)); i++)
+        if (level_opened(l) && !level_completed(l))
+        {
+            game_base_prefetch(level_file(l));
+            break;
+        }
+
     return start_gui();
 }
 
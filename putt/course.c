@@ -43,25 +43,26 @@ static struct course course_v[MAXCRS];
 
 static int course_load(struct course *crs, const char *filename)
 {
-    fs_file fin;
+    fs_lines lr;
+    char *shot, *desc;
     int rc = 0;
 
     memset(crs, 0, sizeof (*crs));
 
     strncpy(crs->holes, filename, MAXSTR - 1);
 
-    if ((fin = fs_open(filename, "r")))
+    if ((lr = fs_lines_open(filename)))
     {
-        if (fs_gets(crs->shot, sizeof (crs->shot), fin) &&
-            fs_gets(crs->desc, sizeof (crs->desc), fin))
-        {
-            strip_newline(crs->shot);
-            strip_newline(crs->desc);
+        if ((shot = fs_lines_get(lr)))
+            SAFECPY(crs->shot, shot);
 
+        if (shot && (desc = fs_lines_get(lr)))
+        {
+            SAFECPY(crs->desc, desc);
             rc = 1;
         }
 
-        fs_close(fin);
+        fs_lines_close(lr);
     }
 
     return rc;
@@ -73,27 +74,20 @@ static int cmp_dir_items(const void *A, const void *B)
     return strcmp(a->path, b->path);
 }
 
-static int course_is_loaded(const char *path)
-{
-    int i;
+/* Hole files of the courses loaded so far, during the directory scan. */
 
-    for (i = 0; i < count; i++)
-        if (strcmp(course_v[i].holes, path) == 0)
-            return 1;
-
-    return 0;
-}
+static struct str_map loaded_courses;
 
 static int is_unseen_course(struct dir_item *item)
 {
     return (str_starts_with(base_name(item->path), "holes-") &&
             str_ends_with(item->path, ".txt") &&
-            !course_is_loaded(item->path));
+            !str_map_get(&loaded_courses, item->path, 0));
 }
 
 void course_init()
 {
-    fs_file fin;
+    fs_lines lr;
     char *line;
 
     Array items;
@@ -104,22 +98,29 @@ void course_init()
 
     count = 0;
 
-    if ((fin = fs_open(COURSE_FILE, "r")))
+    if ((lr = fs_lines_open(COURSE_FILE)))
     {
-        while (count < MAXCRS && read_line(&line, fin))
+        while (count < MAXCRS && (line = fs_lines_get(lr)))
         {
             if (course_load(&course_v[count], line))
                 count++;
-
-            free(line);
         }
 
-        fs_close(fin);
+        fs_lines_close(lr);
 
         course_state = 1;
     }
 
-    if ((items = fs_dir_scan("", is_unseen_course)))
+    str_map_init(&loaded_courses);
+
+    for (i = 0; i < count; i++)
+        str_map_put(&loaded_courses, course_v[i].holes, 1);
+
+    items = fs_dir_scan("", is_unseen_course);
+
+    str_map_free(&loaded_courses);
+
+    if (items)
     {
         array_sort(items, cmp_dir_items);
 
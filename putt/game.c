@@ -57,6 +57,9 @@ static float jump_p[3];                 /* Jump destination                  */
 
 static float idle_t;                    /* Idling timeout                    */
 
+static int step_rest;                   /* Ball-at-rest flag                 */
+static int step_n;                      /* Physics updates in last frame     */
+
 /*---------------------------------------------------------------------------*/
 
 static void view_init(void)
@@ -95,6 +98,9 @@ int game_init(const char *s)
 
     idle_t = 1.0f;
 
+    step_rest = 0;
+    step_n    = 0;
+
     view_init();
 
     if (!(state = sol_load_full(&file, s, config_get_d(CONFIG_SHADOW))))
@@ -496,8 +502,66 @@ static int game_update_state(float dt)
  * four updates.  And  so on.  In this way, the physics  system is allowed to
  * seek an optimal update rate independent of, yet in integral sync with, the
  * graphics frame rate.
+ *
+ * The baseline is  adjusted to the state of the  ball.  A ball in flight
+ * that  will not  touch anything  this frame  follows a  simple ballistic
+ * path, so it is allowed twice  the usual time step.  A ball in contact
+ * with the world is further subdivided  so that it never travels farther
+ * than MAX_DR of its  radius in one update.  A ball that  has come to rest
+ * in a world where nothing moves is not simulated at all.
  */
 
+static int game_step_idle(const struct s_vary *fp)
+{
+    int i;
+
+    /* Any enabled path or running switch timer may disturb the ball. */
+
+    for (i = 0; i < fp->mc; i++)
+        if (fp->pv[fp->mv[i].pi].f)
+            return 0;
+
+    for (i = 0; i < fp->xc; i++)
+        if (fp->xv[i].tm < fp->xv[i].base->tm)
+            return 0;
+
+    return 1;
+}
+
+static int game_step_count(const struct s_vary *fp, float *t)
+{
+    const struct v_ball *up = fp->uv + ball;
+
+    float dt = MAX_DT;
+    float v;
+    int   n = 1;
+
+    if (ball >= fp->uc)
+        return 0;
+
+    v = v_len(up->v);
+
+    if (step_rest && v == 0.f && game_step_idle(fp))
+        return 0;
+
+    if (sol_test_time(fp, *t, ball) < *t)
+    {
+        while (v * *t > MAX_DR * up->r && n < MAX_DN)
+        {
+            *t /= 2;
+            n  *= 2;
+        }
+    }
+    else dt *= 2;
+
+    while (*t > dt && n < MAX_DN)
+    {
+        *t /= 2;
+        n  *= 2;
+    }
+    return n;
+}
+
 int game_step(const float g[3], float dt)
 {
     struct s_vary *fp = &file.vary;
@@ -508,7 +572,7 @@ int game_step(const float g[3], float dt)
     float d = 0.f;
     float b = 0.f;
     float st = 0.f;
-    int i, n = 1, m = 0;
+    int i, n, m = 0;
 
     if (!state)
         return GAME_NONE;
@@ -516,6 +580,8 @@ int game_step(const float g[3], float dt)
     s = (7.f * s + dt) / 8.f;
     t = s;
 
+    step_n = 0;
+
     if (jump_b)
     {
         jump_dt += dt;
@@ -535,11 +601,8 @@ int game_step(const float g[3], float dt)
     {
         /* Run the sim. */
 
-        while (t > MAX_DT && n < MAX_DN)
-        {
-            t /= 2;
-            n *= 2;
-        }
+        if ((n = game_step_count(fp, &t)) == 0)
+            st = dt;
 
         for (i = 0; i < n; i++)
         {
@@ -551,6 +614,11 @@ int game_step(const float g[3], float dt)
                 st += t;
         }
 
+        if (n > 0)
+            step_rest = (m && v_len(fp->uv[ball].v) == 0.f);
+
+        step_n = n;
+
         /* Mix the sound of a ball bounce. */
 
         if (b > 0.5f)
@@ -561,6 +629,14 @@ int game_step(const float g[3], float dt)
     return game_update_state(st);
 }
 
+/*
+ * Return the number of physics updates performed by the last game_step.
+ */
+int game_steps(void)
+{
+    return step_n;
+}
+
 void game_putt(void)
 {
     /*
@@ -574,6 +650,8 @@ void game_putt(void)
     file.vary.uv[ball].v[2] = -4.f * view_e[2][2] * view_m;
 
     view_m = 0.f;
+
+    step_rest = 0;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -684,6 +762,8 @@ void game_ball(int i)
     jump_e = 1;
     jump_b = 0;
 
+    step_rest = 0;
+
     for (ui = 0; ui < file.vary.uc; ui++)
     {
         file.vary.uv[ui].v[0] = 0.f;
@@ -706,6 +786,8 @@ void game_get_pos(float p[3], float e[3][3])
 
 void game_set_pos(float p[3], float e[3][3])
 {
+    step_rest = 0;
+
     v_cpy(file.vary.uv[ball].p,    p);
     v_cpy(file.vary.uv[ball].e[0], e[0]);
     v_cpy(file.vary.uv[ball].e[1], e[1]);
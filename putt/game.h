@@ -24,6 +24,7 @@
 
 #define MAX_DT  (1.0f / 60.0f)         /* Maximum physics update cycle       */
 #define MAX_DN  16                     /* Maximum subdivisions of dt         */
+#define MAX_DR  0.5f                   /* Maximum ball travel per update     */
 #define FOV     50.00f                 /* Field of view                      */
 #define RESPONSE 0.05f                 /* Input smoothing time               */
 
@@ -40,6 +41,7 @@ void  game_free(void);
 void  game_draw(int, float);
 void  game_putt(void);
 int   game_step(const float[3], float);
+int   game_steps(void);
 
 void  game_update_view(float);
 
@@ -52,8 +52,8 @@ static int        score_v[MAXHOL][MAXPLY];
 
 static void hole_init_rc(const char *filename)
 {
-    fs_file fin;
-    char buff[MAXSTR];
+    fs_lines lr;
+    char *line;
 
     hole   = 0;
     player = 0;
@@ -62,17 +62,16 @@ static void hole_init_rc(const char *filename)
 
     /* Load the holes list. */
 
-    if ((fin = fs_open(filename, "r")))
+    if ((lr = fs_lines_open(filename)))
     {
         /* Skip shot and description. */
 
-        if (fs_gets(buff, sizeof (buff), fin) &&
-            fs_gets(buff, sizeof (buff), fin))
+        if (fs_lines_get(lr) && fs_lines_get(lr))
         {
             /* Read the list. */
 
-            while (fs_gets(buff, sizeof (buff), fin) &&
-                   sscanf(buff, "%s %s %d %s",
+            while ((line = fs_lines_get(lr)) &&
+                   sscanf(line, "%s %s %d %s",
                           hole_v[count].file,
                           hole_v[count].back,
                           &hole_v[count].par,
@@ -80,7 +79,7 @@ static void hole_init_rc(const char *filename)
                 count++;
         }
 
-        fs_close(fin);
+        fs_lines_close(lr);
     }
 }
 
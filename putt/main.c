@@ -35,6 +35,8 @@
 #include "gui.h"
 #include "hmd.h"
 #include "fs.h"
+#include "fs_rwops.h"
+#include "profile.h"
 
 #include "st_conf.h"
 #include "st_all.h"
@@ -146,6 +148,9 @@ static int loop(void)
             case KEY_FPS:
                 config_tgl_d(CONFIG_FPS);
                 break;
+            case KEY_GRAPH:
+                config_tgl_d(CONFIG_GRAPH);
+                break;
             case KEY_WIREFRAME:
                 toggle_wire();
                 break;
@@ -290,6 +295,10 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    /* Worker threads open files too. */
+
+    fs_rwops_lock();
+
     srand((int) time(NULL));
 
     opt_parse(argc, argv);
@@ -333,8 +342,9 @@ int main(int argc, char *argv[])
         {
             int t1, t0 = SDL_GetTicks();
 
-            /* Material system. */
+            /* Image decoding and material system. */
 
+            image_init();
             mtrl_init();
 
             /* Run the main game loop. */
@@ -380,13 +390,20 @@ int main(int argc, char *argv[])
                 }
 
             mtrl_quit();
+            image_quit();
         }
 
+        audio_free();
+
         /* Restore Neverball's camera setting. */
 
         config_set_d(CONFIG_CAMERA, camera);
         config_save();
 
+        /* Export frame timings recorded for the graph or stats. */
+
+        profile_frame_dump("frames.json");
+
         SDL_Quit();
     }
     else log_printf("Failure to initialize SDL (%s)\n", SDL_GetError());
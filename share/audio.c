@@ -26,15 +26,69 @@
 #include "common.h"
 #include "fs.h"
 #include "fs_ov.h"
+#include "log.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define AUDIO_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AUDIO_NEON 1
+#include <arm_neon.h>
+#endif
 
 /*---------------------------------------------------------------------------*/
 
 #define AUDIO_RATE 44100
 #define AUDIO_CHAN 2
 
+#define GAIN_ONE   32767                /* Unity gain in Q15              */
+#define STAT_MAX   32                   /* Voice counts tracked in stats  */
+
+/*
+ * Short sound effects are decoded once and kept in memory, so that
+ * playing one doesn't open and decode an Ogg stream in the audio
+ * callback.  Longer files (and music) are streamed as before.
+ */
+
+#define SOUND_MAX (AUDIO_RATE * 10)     /* Longest cached sound in frames */
+
+struct sound
+{
+    char         *name;
+    short        *pcm;                  /* Samples, NULL if streamed      */
+    int           len;                  /* Length in frames               */
+    int           chan;
+    struct sound *next;
+};
+
+/*
+ * Everything else, music in particular, is decoded ahead of time by a
+ * separate thread into a ring buffer per stream.  The decoder is the
+ * only writer of a ring and the audio callback the only reader, so the
+ * two share nothing but the head and tail counters.
+ */
+
+#define RING_LEN  32768                 /* Ring length in frames (2^n)    */
+#define RING_MIN  1024                  /* Smallest read worth doing      */
+#define RING_WAIT 10                    /* Decoder poll interval (ms)     */
+
+struct stream
+{
+    OggVorbis_File vf;
+    short         *pcm;                 /* Ring of decoded frames         */
+    int            chan;
+    int            loop;
+
+    SDL_atomic_t   head;                /* Frames written by the decoder  */
+    SDL_atomic_t   tail;                /* Frames read by the callback    */
+    SDL_atomic_t   done;                /* Decoder reached the end        */
+    SDL_atomic_t   dead;                /* Released by its voice          */
+
+    struct stream *next;
+};
+
 struct voice
 {
-    OggVorbis_File  vf;
     float          amp;
     float         damp;
     int           chan;
@@ -42,6 +96,11 @@ struct voice
     int           loop;
     char         *name;
     struct voice *next;
+
+    const struct sound *snd;            /* Cached sound, if any           */
+    int                 pos;            /* Position in the sound (frames) */
+
+    struct stream      *stream;         /* Decoded stream, if any         */
 };
 
 static int   audio_state = 0;
@@ -53,22 +112,254 @@ static SDL_AudioSpec spec;
 static struct voice *music  = NULL;
 static struct voice *queue  = NULL;
 static struct voice *voices = NULL;
-static short        *buffer = NULL;
+static struct sound *sounds = NULL;
+static int          *accum  = NULL;
+
+static struct stream *streams;
+static SDL_mutex     *stream_mutex;
+static SDL_cond      *stream_cond;
+static SDL_Thread    *stream_thread;
+static int            stream_running;
+
+/* Callback time by number of voices, if stats are enabled. */
+
+static int    audio_stats;
+static Uint64 stat_time[STAT_MAX + 1];
+static int    stat_count[STAT_MAX + 1];
+static SDL_atomic_t underruns;
 
 static ov_callbacks callbacks = {
     fs_ov_read, fs_ov_seek, fs_ov_close, fs_ov_tell
 };
 
+static ov_callbacks map_callbacks = {
+    fs_ov_map_read, fs_ov_map_seek, fs_ov_map_close, fs_ov_map_tell
+};
+
+/*
+ * Open the named Ogg file for decoding, from a memory map if possible.
+ */
+static int ogg_open(OggVorbis_File *vf, const char *filename)
+{
+    void   *src;
+    fs_file fp;
+
+    if ((src = fs_ov_map_open(filename)))
+    {
+        if (ov_open_callbacks(src, vf, NULL, 0, map_callbacks) == 0)
+            return 1;
+
+        fs_ov_map_close(src);
+    }
+    else if ((fp = fs_open(filename, "r")))
+    {
+        if (ov_open_callbacks(fp, vf, NULL, 0, callbacks) == 0)
+            return 1;
+
+        fs_close(fp);
+    }
+    return 0;
+}
+
 /*---------------------------------------------------------------------------*/
 
-#define MIX(d, s) {                           \
-        int T = (int) (d) + (int) (s);        \
-        if      (T >  32767) (d) =  32767;    \
-        else if (T < -32768) (d) = -32768;    \
-        else                 (d) = (short) T; \
+/*
+ * Voices are mixed into a 32-bit accumulator in Q15 fixed point, and
+ * the sum is saturated to 16 bits once at the end.  A voice's gain is
+ * ramped linearly across each block rather than stepped per sample.
+ */
+
+/*
+ * Add m samples times a constant gain to the accumulator.  With dup set,
+ * each sample is added to two adjacent slots (mono into stereo).
+ */
+static void mix_const(int *acc, const short *src, int m, int g, int dup)
+{
+    int i = 0;
+
+#if AUDIO_SSE2
+    const __m128i G = _mm_set1_epi16((short) g);
+
+    for (; i + 8 <= m; i += 8)
+    {
+        __m128i x  = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i lo = _mm_mullo_epi16(x, G);
+        __m128i hi = _mm_mulhi_epi16(x, G);
+        __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+        __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+
+        __m128i *a = (__m128i *) (acc + (dup ? i * 2 : i));
+
+        if (dup)
+        {
+            _mm_storeu_si128(a + 0, _mm_add_epi32(_mm_loadu_si128(a + 0),
+                                                  _mm_unpacklo_epi32(p0, p0)));
+            _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1),
+                                                  _mm_unpackhi_epi32(p0, p0)));
+            _mm_storeu_si128(a + 2, _mm_add_epi32(_mm_loadu_si128(a + 2),
+                                                  _mm_unpacklo_epi32(p1, p1)));
+            _mm_storeu_si128(a + 3, _mm_add_epi32(_mm_loadu_si128(a + 3),
+                                                  _mm_unpackhi_epi32(p1, p1)));
+        }
+        else
+        {
+            _mm_storeu_si128(a + 0, _mm_add_epi32(_mm_loadu_si128(a + 0), p0));
+            _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), p1));
+        }
+    }
+#elif AUDIO_NEON
+    for (; i + 8 <= m; i += 8)
+    {
+        int16x8_t x  = vld1q_s16(src + i);
+        int32x4_t p0 = vshrq_n_s32(vmull_n_s16(vget_low_s16 (x), g), 15);
+        int32x4_t p1 = vshrq_n_s32(vmull_n_s16(vget_high_s16(x), g), 15);
+
+        int32_t *a = acc + (dup ? i * 2 : i);
+
+        if (dup)
+        {
+            int32x4x2_t q0 = vzipq_s32(p0, p0);
+            int32x4x2_t q1 = vzipq_s32(p1, p1);
+
+            vst1q_s32(a +  0, vaddq_s32(vld1q_s32(a +  0), q0.val[0]));
+            vst1q_s32(a +  4, vaddq_s32(vld1q_s32(a +  4), q0.val[1]));
+            vst1q_s32(a +  8, vaddq_s32(vld1q_s32(a +  8), q1.val[0]));
+            vst1q_s32(a + 12, vaddq_s32(vld1q_s32(a + 12), q1.val[1]));
+        }
+        else
+        {
+            vst1q_s32(a + 0, vaddq_s32(vld1q_s32(a + 0), p0));
+            vst1q_s32(a + 4, vaddq_s32(vld1q_s32(a + 4), p1));
+        }
+    }
+#endif
+
+    if (dup)
+        for (; i < m; i++)
+        {
+            int M = (src[i] * g) >> 15;
+
+            acc[i * 2 + 0] += M;
+            acc[i * 2 + 1] += M;
+        }
+    else
+        for (; i < m; i++)
+            acc[i] += (src[i] * g) >> 15;
+}
+
+/*
+ * Add n frames times a gain ramping from g0 to g1.  Fades are rare, so
+ * this one is left to the compiler.
+ */
+static void mix_ramp(int *acc, const short *src, int n, int chan,
+                     int g0, int g1)
+{
+    int g  = g0 * 32768;
+    int dg = (g1 - g0) * 32768 / n;
+    int i;
+
+    if (chan == 1)
+        for (i = 0; i < n; i++, g += dg)
+        {
+            int M = (src[i] * (g >> 15)) >> 15;
+
+            acc[i * 2 + 0] += M;
+            acc[i * 2 + 1] += M;
+        }
+
+    if (chan == 2)
+        for (i = 0; i < n; i++, g += dg)
+        {
+            acc[i * 2 + 0] += (src[i * 2 + 0] * (g >> 15)) >> 15;
+            acc[i * 2 + 1] += (src[i * 2 + 1] * (g >> 15)) >> 15;
+        }
+}
+
+/*
+ * Mix n frames of the voice's audio into the accumulator, applying its
+ * fade.
+ */
+static void voice_mix(struct voice *V, float volume,
+                      int *acc, const short *ibuf, int n)
+{
+    float a = CLAMP(0.0f, V->amp + V->damp * n, 1.0f);
+
+    int g0 = (int) (V->amp * volume * GAIN_ONE);
+    int g1 = (int) (a      * volume * GAIN_ONE);
+
+    V->amp = a;
+
+    if (V->chan != 1 && V->chan != 2)
+        return;
+
+    if (g0 != g1)
+        mix_ramp(acc, ibuf, n, V->chan, g0, g1);
+    else if (g0)
+        mix_const(acc, ibuf, n * V->chan, g0, V->chan == 1);
+}
+
+/*
+ * Saturate the accumulator to 16-bit output.
+ */
+static void mix_store(short *out, const int *acc, int m)
+{
+    int i = 0;
+
+#if AUDIO_SSE2
+    for (; i + 8 <= m; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) (acc + i + 0));
+        __m128i b = _mm_loadu_si128((const __m128i *) (acc + i + 4));
+
+        _mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(a, b));
     }
+#elif AUDIO_NEON
+    for (; i + 8 <= m; i += 8)
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vld1q_s32(acc + i + 0)),
+                                        vqmovn_s32(vld1q_s32(acc + i + 4))));
+#endif
+
+    for (; i < m; i++)
+        out[i] = (short) CLAMP(-32768, acc[i], 32767);
+}
 
-static int voice_step(struct voice *V, float volume, Uint8 *stream, int length)
+/*
+ * Mix a voice playing a cached sound.
+ */
+static int voice_step_sound(struct voice *V, float volume, int *acc, int r)
+{
+    const struct sound *S = V->snd;
+
+    int n;
+
+    while (r > 0)
+    {
+        if ((n = MIN(r, S->len - V->pos)) > 0)
+        {
+            voice_mix(V, volume, acc, S->pcm + V->pos * S->chan, n);
+
+            acc    += n * AUDIO_CHAN;
+            V->pos += n;
+            r      -= n;
+        }
+        else
+        {
+            /* We're at the end.  Loop or end the voice. */
+
+            if (V->loop)
+                V->pos = 0;
+            else
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Decode as much of the stream as fits in one piece of its ring.
+ * Return the number of frames decoded.
+ */
+static int stream_fill(struct stream *S)
 {
 #if SDL_BYTEORDER == SDL_BIG_ENDIAN
     int order = 1;
@@ -76,78 +367,218 @@ static int voice_step(struct voice *V, float volume, Uint8 *stream, int length)
     int order = 0;
 #endif
 
-    short *obuf = (short *) stream;
-    char  *ibuf = (char  *) buffer;
+    unsigned int head = (unsigned int) SDL_AtomicGet(&S->head);
+    unsigned int tail = (unsigned int) SDL_AtomicGet(&S->tail);
 
-    int i, b = 0, n = 1, c = 0, r = 0;
+    int i = (int) (head & (RING_LEN - 1));
+    int n = MIN(RING_LEN - (int) (head - tail), RING_LEN - i);
+    int f = S->chan * 2;
+    int b = 0;
 
-    /* Compute the total request size for the current stream. */
+    long k;
 
-    if (V->chan == 1) r = length / 2;
-    if (V->chan == 2) r = length    ;
+    if (n < RING_MIN && n < RING_LEN - i)
+        return 0;
+    if (SDL_AtomicGet(&S->done))
+        return 0;
 
-    /* While data is coming in and data is still needed... */
+    if ((k = ov_read(&S->vf, (char *) (S->pcm + i * S->chan), n * f,
+                     order, 2, 1, &b)) > 0)
+    {
+        SDL_AtomicSet(&S->head, (int) (head + k / f));
+        return (int) (k / f);
+    }
 
-    while (n > 0 && r > 0)
+    /* We're at EOF.  Loop or end the stream. */
+
+    if (k == 0 && S->loop)
+        ov_raw_seek(&S->vf, 0);
+    else if (k != OV_HOLE)
+        SDL_AtomicSet(&S->done, 1);
+
+    return 0;
+}
+
+static void stream_free(struct stream *S)
+{
+    ov_clear(&S->vf);
+    free(S->pcm);
+    free(S);
+}
+
+/*
+ * Release streams given up by their voices. Call with the lock held,
+ * from the decoder thread if there is one.
+ */
+static void stream_reap(void)
+{
+    struct stream *S, *P = NULL, *N;
+
+    for (S = streams; S; S = N)
     {
-        /* Read audio from the stream. */
+        N = S->next;
 
-        if ((n = (int) ov_read(&V->vf, ibuf, r, order, 2, 1, &b)) > 0)
+        if (SDL_AtomicGet(&S->dead))
         {
-            /* Mix mono audio. */
+            if (P) P->next = N;
+            else   streams = N;
 
-            if (V->chan == 1)
-                for (i = 0; i < n / 2; i += 1)
-                {
-                    short M = (short) (V->amp * volume * buffer[i]);
+            stream_free(S);
+        }
+        else P = S;
+    }
+}
 
-                    MIX(obuf[c], M); c++;
-                    MIX(obuf[c], M); c++;
+/*
+ * Keep all rings topped up. New streams are only ever pushed onto the
+ * head of the list, and only this thread removes them, so the list can
+ * be walked without the lock while decoding.
+ */
+static int stream_work(void *data)
+{
+    struct stream *S, *L;
+    int n;
 
-                    V->amp += V->damp;
+    SDL_mutexP(stream_mutex);
 
-                    if (V->amp < 0.0f) V->amp = 0.0;
-                    if (V->amp > 1.0f) V->amp = 1.0;
-                }
+    while (stream_running)
+    {
+        stream_reap();
 
-            /* Mix stereo audio. */
+        L = streams;
 
-            if (V->chan == 2)
-                for (i = 0; i < n / 2; i += 2)
-                {
-                    short L = (short) (V->amp * volume * buffer[i + 0]);
-                    short R = (short) (V->amp * volume * buffer[i + 1]);
+        SDL_mutexV(stream_mutex);
+        {
+            for (n = 0, S = L; S; S = S->next)
+                n += stream_fill(S);
+        }
+        SDL_mutexP(stream_mutex);
 
-                    MIX(obuf[c], L); c++;
-                    MIX(obuf[c], R); c++;
+        if (n == 0 && stream_running)
+            SDL_CondWaitTimeout(stream_cond, stream_mutex, RING_WAIT);
+    }
 
-                    V->amp += V->damp;
+    SDL_mutexV(stream_mutex);
 
-                    if (V->amp < 0.0f) V->amp = 0.0;
-                    if (V->amp > 1.0f) V->amp = 1.0;
+    return 0;
+}
+
+/*
+ * Open the named Ogg file and hand it to the decoder.
+ */
+static struct stream *stream_open(const char *filename, int loop)
+{
+    struct stream *S;
+
+    if ((S = (struct stream *) calloc(1, sizeof (struct stream))))
+    {
+        if (ogg_open(&S->vf, filename))
+        {
+            vorbis_info *info = ov_info(&S->vf, -1);
+
+            S->chan = info->channels;
+            S->loop = loop;
+
+            if ((S->chan == 1 || S->chan == 2) &&
+                (S->pcm = (short *) malloc(RING_LEN * S->chan *
+                                           sizeof (short))))
+            {
+                /* Prime the ring so that playback starts at once. */
+
+                while (SDL_AtomicGet(&S->head) < RING_MIN * 4 &&
+                       stream_fill(S))
+                    ;
+
+                SDL_mutexP(stream_mutex);
+                {
+                    if (stream_thread == NULL)
+                        stream_reap();
+
+                    S->next = streams;
+                    streams = S;
+
+                    SDL_CondSignal(stream_cond);
                 }
+                SDL_mutexV(stream_mutex);
+
+                return S;
+            }
 
-            r -= n;
+            /* The file will be closed when the Ogg is cleared. */
+
+            ov_clear(&S->vf);
         }
+        free(S);
+    }
+    return NULL;
+}
+
+/*
+ * Mix r frames of a streamed voice from its ring. Return 1 when the
+ * stream has finished.
+ */
+static int voice_step_stream(struct voice *V, float volume, int *acc, int r)
+{
+    struct stream *S = V->stream;
+
+    unsigned int head;
+    unsigned int tail = (unsigned int) SDL_AtomicGet(&S->tail);
+
+    int n;
+
+    /* Without a decoder thread, decode right here. */
+
+    if (stream_thread == NULL)
+        while (stream_fill(S))
+            ;
+
+    while (r > 0)
+    {
+        head = (unsigned int) SDL_AtomicGet(&S->head);
+
+        n = MIN((int) (head - tail), RING_LEN - (int) (tail & (RING_LEN - 1)));
+
+        if ((n = MIN(r, n)) > 0)
+        {
+            voice_mix(V, volume, acc,
+                      S->pcm + (tail & (RING_LEN - 1)) * S->chan, n);
+
+            tail += n;
+            acc  += n * AUDIO_CHAN;
+            r    -= n;
+
+            SDL_AtomicSet(&S->tail, (int) tail);
+        }
+        else if (SDL_AtomicGet(&S->done))
+            return 1;
         else
         {
-            /* We're at EOF.  Loop or end the voice. */
+            /* The decoder fell behind.  Leave a gap. */
 
-            if (V->loop)
-            {
-                ov_raw_seek(&V->vf, 0);
-                n = 1;
-            }
-            else return 1;
+            SDL_AtomicAdd(&underruns, 1);
+            break;
         }
     }
     return 0;
 }
 
-static struct voice *voice_init(const char *filename, float a)
+/*
+ * Mix r frames of the voice into the accumulator.  Return 1 when the
+ * voice has finished.
+ */
+static int voice_step(struct voice *V, float volume, int *acc, int r)
+{
+    if (V->snd)
+        return voice_step_sound(V, volume, acc, r);
+    if (V->stream)
+        return voice_step_stream(V, volume, acc, r);
+
+    return 1;
+}
+
+static struct voice *voice_init(const char *filename, float a, int loop)
 {
     struct voice *V;
-    fs_file      fp;
 
     /* Allocate and initialize a new voice structure. */
 
@@ -159,26 +590,18 @@ static struct voice *voice_init(const char *filename, float a)
 
         /* Attempt to open the named Ogg stream. */
 
-        if ((fp = fs_open(filename, "r")))
+        if ((V->stream = stream_open(filename, loop)))
         {
-            if (ov_open_callbacks(fp, &V->vf, NULL, 0, callbacks) == 0)
-            {
-                vorbis_info *info = ov_info(&V->vf, -1);
-
-                /* On success, configure the voice. */
+            /* On success, configure the voice. */
 
-                V->amp  = a;
-                V->damp = 0;
-                V->chan = info->channels;
-                V->play = 1;
-                V->loop = 0;
+            V->amp  = a;
+            V->damp = 0;
+            V->chan = V->stream->chan;
+            V->play = 1;
+            V->loop = loop;
 
-                if (V->amp > 1.0f) V->amp = 1.0;
-                if (V->amp < 0.0f) V->amp = 0.0;
-
-                /* The file will be closed when the Ogg is cleared. */
-            }
-            else fs_close(fp);
+            if (V->amp > 1.0f) V->amp = 1.0;
+            if (V->amp < 0.0f) V->amp = 0.0;
         }
     }
     return V;
@@ -186,7 +609,10 @@ static struct voice *voice_init(const char *filename, float a)
 
 static void voice_free(struct voice *V)
 {
-    ov_clear(&V->vf);
+    /* The decoder releases the stream once it notices. */
+
+    if (V->stream)
+        SDL_AtomicSet(&V->stream->dead, 1);
 
     free(V->name);
     free(V);
@@ -194,20 +620,181 @@ static void voice_free(struct voice *V)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Decode the named Ogg file into the sound, if it is short enough.
+ */
+static void sound_load(struct sound *S, const char *filename)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    int order = 1;
+#else
+    int order = 0;
+#endif
+
+    OggVorbis_File vf;
+
+    if (ogg_open(&vf, filename))
+    {
+        vorbis_info *info = ov_info(&vf, -1);
+        ogg_int64_t  len  = ov_pcm_total(&vf, -1);
+
+        int chan = info->channels;
+
+        if ((chan == 1 || chan == 2) && 0 < len && len <= SOUND_MAX &&
+            (S->pcm = (short *) malloc(len * chan * sizeof (short))))
+        {
+            char *p = (char *) S->pcm;
+            int   m = (int) len * chan * sizeof (short);
+            int   n = 0;
+            int   b = 0;
+            long  k;
+
+            while (n < m && (k = ov_read(&vf, p + n, m - n,
+                                         order, 2, 1, &b)) > 0)
+                n += (int) k;
+
+            S->len  = n / chan / sizeof (short);
+            S->chan = chan;
+
+            if (S->len == 0)
+            {
+                free(S->pcm);
+                S->pcm = NULL;
+            }
+        }
+
+        /* This closes the file. */
+
+        ov_clear(&vf);
+    }
+}
+
+/*
+ * Find the named sound in the cache, loading it on first use.
+ */
+static struct sound *sound_get(const char *filename)
+{
+    struct sound *S;
+
+    for (S = sounds; S; S = S->next)
+        if (strcmp(S->name, filename) == 0)
+            return S;
+
+    if ((S = (struct sound *) calloc(1, sizeof (struct sound))))
+    {
+        if ((S->name = strdup(filename)))
+        {
+            sound_load(S, filename);
+
+            S->next = sounds;
+            sounds  = S;
+        }
+        else
+        {
+            free(S);
+            S = NULL;
+        }
+    }
+    return S;
+}
+
+/*
+ * Create a voice for a sound effect, playing from the cache if possible.
+ */
+static struct voice *voice_init_sound(const char *filename, float a)
+{
+    struct sound *S = sound_get(filename);
+    struct voice *V;
+
+    if (S == NULL || S->pcm == NULL)
+        return voice_init(filename, a, 0);
+
+    if ((V = (struct voice *) calloc(1, sizeof (struct voice))))
+    {
+        V->name = strdup(filename);
+        V->snd  = S;
+        V->amp  = a;
+        V->damp = 0;
+        V->chan = S->chan;
+        V->play = 1;
+        V->loop = 0;
+
+        if (V->amp > 1.0f) V->amp = 1.0;
+        if (V->amp < 0.0f) V->amp = 0.0;
+    }
+    return V;
+}
+
+/*
+ * Rank a voice for stealing. Quiet voices and cached sounds near their
+ * end go first.
+ */
+static float voice_rank(const struct voice *V)
+{
+    float r = V->play ? V->amp : 0.0f;
+
+    if (V->snd && V->snd->len)
+        r *= 1.0f - (float) V->pos / V->snd->len;
+
+    return r;
+}
+
+/*
+ * Stop the lowest ranked voices until no more than n remain. Call with
+ * the audio locked.
+ */
+static void voice_limit(int n)
+{
+    struct voice *V, *P, *T, *U;
+    int c;
+
+    for (c = 0, V = voices; V; V = V->next)
+        c++;
+
+    while (c > n && voices)
+    {
+        T = voices;
+        U = NULL;
+
+        for (P = voices, V = voices->next; V; P = V, V = V->next)
+            if (voice_rank(V) < voice_rank(T))
+            {
+                T = V;
+                U = P;
+            }
+
+        if (U)
+            U->next = T->next;
+        else
+            voices  = T->next;
+
+        voice_free(T);
+        c--;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void audio_step(void *data, Uint8 *stream, int length)
 {
     struct voice *V = voices;
     struct voice *P = NULL;
 
-    /* Zero the output buffer. */
+    const int r = MIN(length / (2 * AUDIO_CHAN), (int) spec.samples);
+
+    Uint64 t = audio_stats ? SDL_GetPerformanceCounter() : 0;
+    int    c = 0;
+
+    /* Zero the output and accumulation buffers. */
 
     memset(stream, 0, length);
+    memset(accum,  0, r * AUDIO_CHAN * sizeof (int));
 
     /* Mix the background music. */
 
     if (music)
     {
-        voice_step(music, music_vol, stream, length);
+        voice_step(music, music_vol, accum, r);
 
         /* If the track has faded out, move to a queued track. */
 
@@ -223,9 +810,11 @@ static void audio_step(void *data, Uint8 *stream, int length)
 
     while (V)
     {
+        c++;
+
         /* Mix this voice. */
 
-        if (V->play && voice_step(V, sound_vol, stream, length))
+        if (V->play && voice_step(V, sound_vol, accum, r))
         {
             /* Delete a finished voice... */
 
@@ -246,6 +835,16 @@ static void audio_step(void *data, Uint8 *stream, int length)
             V = V->next;
         }
     }
+
+    mix_store((short *) stream, accum, r * AUDIO_CHAN);
+
+    if (audio_stats)
+    {
+        c = MIN(c, STAT_MAX);
+
+        stat_time [c] += SDL_GetPerformanceCounter() - t;
+        stat_count[c] += 1;
+    }
 }
 
 /*---------------------------------------------------------------------------*/
@@ -262,9 +861,16 @@ void audio_init(void)
     spec.freq     = AUDIO_RATE;
     spec.callback = audio_step;
 
-    /* Allocate an input buffer. */
+    audio_stats = config_get_d(CONFIG_STATS);
+
+    memset(stat_time,  0, sizeof (stat_time));
+    memset(stat_count, 0, sizeof (stat_count));
+
+    SDL_AtomicSet(&underruns, 0);
+
+    /* Allocate the accumulation buffer. */
 
-    if ((buffer = (short *) malloc(spec.samples * 4)))
+    if ((accum = (int *) malloc(spec.samples * AUDIO_CHAN * sizeof (int))))
     {
         /* Start the audio thread. */
 
@@ -276,6 +882,20 @@ void audio_init(void)
         else log_printf("Failure to open audio device (%s)\n", SDL_GetError());
     }
 
+    /* Start the stream decoder. */
+
+    if (audio_state && !stream_mutex)
+    {
+        stream_mutex = SDL_CreateMutex();
+        stream_cond  = SDL_CreateCond();
+    }
+
+    if (audio_state && stream_mutex && stream_cond)
+    {
+        stream_running = 1;
+        stream_thread  = SDL_CreateThread(stream_work, "audio", NULL);
+    }
+
     /* Set the initial volumes. */
 
     audio_volume(config_get_d(CONFIG_SOUND_VOLUME),
@@ -284,13 +904,41 @@ void audio_init(void)
 
 void audio_free(void)
 {
+    int i;
+
     /* Halt the audio thread. */
 
     SDL_CloseAudio();
 
-    /* Release the input buffer. */
+    /* Halt the stream decoder. */
 
-    free(buffer);
+    if (stream_thread)
+    {
+        SDL_mutexP(stream_mutex);
+        stream_running = 0;
+        SDL_CondSignal(stream_cond);
+        SDL_mutexV(stream_mutex);
+
+        SDL_WaitThread(stream_thread, NULL);
+        stream_thread = NULL;
+    }
+
+    /* Release the accumulation buffer. */
+
+    free(accum);
+
+    accum = NULL;
+
+    /* Report mixing time by voice count. */
+
+    for (i = 0; i <= STAT_MAX; i++)
+        if (stat_count[i])
+            log_printf("Audio: %2d voices, %8.4f ms per callback (%d)\n", i,
+                       1000.0 * stat_time[i] / stat_count[i] /
+                       SDL_GetPerformanceFrequency(), stat_count[i]);
+
+    if (audio_stats)
+        log_printf("Audio: %d stream underruns\n", audio_underruns());
 
     /* Ogg streams and voice structure remain open to allow quality setting. */
 }
@@ -305,11 +953,25 @@ void audio_play(const char *filename, float a)
 
         SDL_LockAudio();
         {
-            for (V = voices; V; V = V->next)
+            struct voice *P = NULL;
+
+            for (V = voices; V; P = V, V = V->next)
                 if (strcmp(V->name, filename) == 0)
                 {
-                    ov_raw_seek(&V->vf, 0);
+                    /* A stream can't rewind in place.  Start it anew. */
+
+                    if (V->snd == NULL)
+                    {
+                        if (P)
+                            P->next = V->next;
+                        else
+                            voices  = V->next;
 
+                        voice_free(V);
+                        break;
+                    }
+
+                    V->pos = 0;
                     V->amp = a;
 
                     if (V->amp > 1.0f) V->amp = 1.0;
@@ -323,12 +985,17 @@ void audio_play(const char *filename, float a)
 
         /* Create a new voice structure. */
 
-        V = voice_init(filename, a);
+        V = voice_init_sound(filename, a);
 
-        /* Add it to the list of sounding voices. */
+        /* Add it to the list of sounding voices, making room if needed. */
 
         SDL_LockAudio();
         {
+            int n = config_get_d(CONFIG_AUDIO_VOICES);
+
+            if (n > 0)
+                voice_limit(n - 1);
+
             V->next = voices;
             voices  = V;
         }
@@ -342,14 +1009,17 @@ void audio_music_play(const char *filename)
 {
     if (audio_state)
     {
+        struct voice *V;
+
         audio_music_stop();
 
+        /* Open the track before taking the lock. */
+
+        V = voice_init(filename, 0.0f, 1);
+
         SDL_LockAudio();
         {
-            if ((music = voice_init(filename, 0.0f)))
-            {
-                music->loop = 1;
-            }
+            music = V;
         }
         SDL_UnlockAudio();
     }
@@ -359,17 +1029,23 @@ void audio_music_queue(const char *filename, float t)
 {
     if (audio_state)
     {
-        SDL_LockAudio();
+        struct voice *V, *Q;
+
+        if ((V = voice_init(filename, 0.0f, 1)))
         {
-            if ((queue = voice_init(filename, 0.0f)))
-            {
-                queue->loop = 1;
+            if (t > 0.0f)
+                V->damp = +1.0f / (AUDIO_RATE * t);
+        }
 
-                if (t > 0.0f)
-                    queue->damp = +1.0f / (AUDIO_RATE * t);
-            }
+        SDL_LockAudio();
+        {
+            Q     = queue;
+            queue = V;
         }
         SDL_UnlockAudio();
+
+        if (Q)
+            voice_free(Q);
     }
 }
 
@@ -442,6 +1118,15 @@ void audio_music_fade_to(float t, const char *filename)
     }
 }
 
+/*
+ * Return the number of music stream underruns since initialization.
+ */
+
+int audio_underruns(void)
+{
+    return SDL_AtomicGet(&underruns);
+}
+
 void audio_volume(int s, int m)
 {
     sound_vol = (float) s / 10.0f;
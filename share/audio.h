@@ -18,6 +18,8 @@ void audio_music_fade_out(float);
 void audio_timer(float);
 void audio_volume(int, int);
 
+int  audio_underruns(void);
+
 /*---------------------------------------------------------------------------*/
 
 #endif
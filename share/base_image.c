@@ -25,6 +25,18 @@
 #include "fs_png.h"
 #include "fs_jpg.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#define IMAGE_SSE2 1
+#define IMAGE_SIMD 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IMAGE_NEON 1
+#define IMAGE_SIMD 1
+#include <arm_neon.h>
+#else
+#define IMAGE_SIMD 0
+#endif
+
 /*---------------------------------------------------------------------------*/
 
 void image_size(int *W, int *H, int w, int h)
@@ -244,6 +256,161 @@ void *image_next2(const void *p, int w, int h, int b, int *w2, int *h2)
     return dst;
 }
 
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Pixel kernels.
+ *
+ * The inner loops below have SSE2 and NEON versions, picked at compile
+ * time, with a scalar fallback. All produce identical results.
+ */
+
+/*
+ * Sum n rows of len bytes, stride bytes apart, into 16-bit accumulators.
+ */
+static void sum_rows(unsigned short *acc, const unsigned char *src,
+                     int stride, int n, int len)
+{
+    int x = 0, r;
+
+#if defined(IMAGE_SSE2)
+    const __m128i z = _mm_setzero_si128();
+
+    for (; x + 16 <= len; x += 16)
+    {
+        __m128i lo = z;
+        __m128i hi = z;
+
+        for (r = 0; r < n; r++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) (src + r * stride + x));
+
+            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, z));
+            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, z));
+        }
+        _mm_storeu_si128((__m128i *) (acc + x),     lo);
+        _mm_storeu_si128((__m128i *) (acc + x + 8), hi);
+    }
+#elif defined(IMAGE_NEON)
+    for (; x + 16 <= len; x += 16)
+    {
+        uint16x8_t lo = vdupq_n_u16(0);
+        uint16x8_t hi = vdupq_n_u16(0);
+
+        for (r = 0; r < n; r++)
+        {
+            uint8x16_t v = vld1q_u8(src + r * stride + x);
+
+            lo = vaddw_u8(lo, vget_low_u8 (v));
+            hi = vaddw_u8(hi, vget_high_u8(v));
+        }
+        vst1q_u16(acc + x,     lo);
+        vst1q_u16(acc + x + 8, hi);
+    }
+#endif
+
+    for (r = 0; r < n; r++)
+    {
+        const unsigned char *s = src + r * stride;
+        int i;
+
+        if (r == 0)
+            for (i = x; i < len; i++)
+                acc[i]  = s[i];
+        else
+            for (i = x; i < len; i++)
+                acc[i] += s[i];
+    }
+}
+
+/*
+ * Sum n adjacent pixels of b bytes in a row of accumulators and divide
+ * by d, after adding a rounding bias.
+ */
+static void sum_cols(unsigned char *dst, const unsigned short *acc,
+                     int W, int b, int n, int d, int bias)
+{
+    int x = 0, i, j;
+
+#if defined(IMAGE_SSE2)
+    if (b == 4 && n == 2 && d == 4)
+    {
+        /* Four source pixels make two destination pixels. */
+
+        const __m128i k = _mm_set1_epi16((short) bias);
+
+        for (; x + 4 <= W; x += 4)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *) (acc + x * 8));
+            __m128i c = _mm_loadu_si128((const __m128i *) (acc + x * 8 + 8));
+            __m128i e = _mm_loadu_si128((const __m128i *) (acc + x * 8 + 16));
+            __m128i g = _mm_loadu_si128((const __m128i *) (acc + x * 8 + 24));
+
+            __m128i s = _mm_add_epi16(_mm_unpacklo_epi64(a, c),
+                                      _mm_unpackhi_epi64(a, c));
+            __m128i t = _mm_add_epi16(_mm_unpacklo_epi64(e, g),
+                                      _mm_unpackhi_epi64(e, g));
+
+            s = _mm_srli_epi16(_mm_add_epi16(s, k), 2);
+            t = _mm_srli_epi16(_mm_add_epi16(t, k), 2);
+
+            _mm_storeu_si128((__m128i *) (dst + x * 4), _mm_packus_epi16(s, t));
+        }
+    }
+#endif
+
+    if (n == 2 && d == 4)
+    {
+        /* Pairs of pixels are the common case, so unroll them. */
+
+        for (i = x * b; i < W * b; i += b)
+            for (j = 0; j < b; j++)
+                dst[i + j] = (unsigned char)
+                    ((acc[i * 2 + j] + acc[i * 2 + j + b] + bias) / 4);
+    }
+    else
+    {
+        for (; x < W; x++)
+            for (i = 0; i < b; i++)
+            {
+                int c = bias;
+
+                for (j = 0; j < n; j++)
+                    c += acc[(x * n + j) * b + i];
+
+                dst[x * b + i] = (unsigned char) (c / d);
+            }
+    }
+}
+
+/*
+ * Average each n-by-n block of a w-wide image into a W-by-H image.
+ */
+static int box_filter(unsigned char *dst, const unsigned char *src,
+                      int w, int b, int W, int H, int n, int bias)
+{
+    unsigned short *acc;
+
+    int r;
+
+    if (W == 0 || H == 0)
+        return 1;
+
+    if ((acc = (unsigned short *) malloc(W * n * b * sizeof (*acc))))
+    {
+        for (r = 0; r < H; r++)
+        {
+            sum_rows(acc, src + r * n * w * b, w * b, n, W * n * b);
+            sum_cols(dst + r * W * b, acc, W, b, n, n * n, bias);
+        }
+        free(acc);
+        return 1;
+    }
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * Allocate and return a new down-sampled image buffer.
  */
@@ -257,30 +424,105 @@ void *image_scale(const void *p, int w, int h, int b, int *wn, int *hn, int n)
 
     if ((dst = (unsigned char *) calloc(W * H * b, sizeof (unsigned char))))
     {
-        int si, di;
-        int sj, dj;
-        int i;
+        /* Average the NxN source pixel block for each component. */
 
-        /* Iterate each component of each destination pixel. */
+        if (!box_filter(dst, src, w, b, W, H, n, 0))
+        {
+            free(dst);
+            return NULL;
+        }
 
-        for (di = 0; di < H; di++)
-            for (dj = 0; dj < W; dj++)
-                for (i = 0; i < b; i++)
-                {
-                    int c = 0;
+        if (wn) *wn = W;
+        if (hn) *hn = H;
+    }
 
-                    /* Average the NxN source pixel block for each. */
+    return dst;
+}
 
-                    for (si = di * n; si < (di + 1) * n; si++)
-                        for (sj = dj * n; sj < (dj + 1) * n; sj++)
-                            c += src[(si * w + sj) * b + i];
+/*
+ * Filter a mipmap level with an odd dimension, clamping at its edges.
+ */
+static void mipmap_edge(unsigned char *dst, const unsigned char *src,
+                        int w, int h, int b, int W, int H)
+{
+    int di, dj, i;
 
-                    dst[(di * W + dj) * b + i] =
-                        (unsigned char) (c / (n * n));
-                }
+    for (di = 0; di < H; di++)
+        for (dj = 0; dj < W; dj++)
+        {
+            const int si0 =     di * 2;
+            const int sj0 =     dj * 2;
+            const int si1 = (si0 + 1 < h) ? si0 + 1 : si0;
+            const int sj1 = (sj0 + 1 < w) ? sj0 + 1 : sj0;
 
-        if (wn) *wn = W;
-        if (hn) *hn = H;
+            for (i = 0; i < b; i++)
+            {
+                int v = src[(si0 * w + sj0) * b + i] +
+                        src[(si0 * w + sj1) * b + i] +
+                        src[(si1 * w + sj0) * b + i] +
+                        src[(si1 * w + sj1) * b + i];
+
+                dst[(di * W + dj) * b + i] = (unsigned char) ((v + 2) / 4);
+            }
+        }
+}
+
+/*
+ * Allocate and return a buffer holding the given image followed by its
+ * complete mipmap chain, down to 1x1, each level a 2x2 box filter of the
+ * previous. Return the number of levels in n.
+ */
+void *image_mipmap(const void *p, int w, int h, int b, int *n)
+{
+    unsigned char *dst = NULL;
+
+    int W = w;
+    int H = h;
+    int s = 0;
+    int c = 0;
+
+    /* Count levels and total size. */
+
+    while (1)
+    {
+        s += W * H * b;
+        c += 1;
+
+        if (W == 1 && H == 1)
+            break;
+
+        W = (W > 1) ? W / 2 : 1;
+        H = (H > 1) ? H / 2 : 1;
+    }
+
+    if ((dst = (unsigned char *) malloc(s)))
+    {
+        const unsigned char *src = dst;
+        unsigned char       *out = dst + w * h * b;
+
+        int l;
+
+        memcpy(dst, p, w * h * b);
+
+        for (l = 1; l < c; l++)
+        {
+            W = (w > 1) ? w / 2 : 1;
+            H = (h > 1) ? h / 2 : 1;
+
+            /* Even sizes filter as 2x2 blocks, odd ones clamp at the edge. */
+
+            if (!IMAGE_SIMD || W * 2 != w || H * 2 != h ||
+                !box_filter(out, src, w, b, W, H, 2, 2))
+                mipmap_edge(out, src, w, h, b, W, H);
+
+            src  = out;
+            out += W * H * b;
+
+            w = W;
+            h = H;
+        }
+
+        if (n) *n = c;
     }
 
     return dst;
@@ -293,7 +535,7 @@ void image_white(void *p, int w, int h, int b)
 {
     unsigned char *s = (unsigned char *) p;
 
-    int i;
+    int i = 0;
 
     assert(b >= 1 && b <= 4);
 
@@ -301,19 +543,46 @@ void image_white(void *p, int w, int h, int b)
     {
         memset(s, 0xFF, w * h * b);
     }
-    else if (b == 2)
-    {
-        for (i = 0; i < w * h * b; i += 2)
-            s[i] = 0xFF;
-    }
     else
     {
-        for (i = 0; i < w * h * b; i += 4)
+        const int n = w * h * b;
+
+#if IMAGE_SIMD
+        /* OR each pixel with a mask of its color bytes. */
+
+        static const unsigned char m[2][16] = {
+            { 0xFF, 0, 0xFF, 0, 0xFF, 0, 0xFF, 0,
+              0xFF, 0, 0xFF, 0, 0xFF, 0, 0xFF, 0 },
+            { 0xFF, 0xFF, 0xFF, 0, 0xFF, 0xFF, 0xFF, 0,
+              0xFF, 0xFF, 0xFF, 0, 0xFF, 0xFF, 0xFF, 0 }
+        };
+
+        const unsigned char *k = m[b / 2 - 1];
+#endif
+#if defined(IMAGE_SSE2)
+        const __m128i v = _mm_loadu_si128((const __m128i *) k);
+
+        for (; i + 16 <= n; i += 16)
         {
-            s[i + 0] = 0xFF;
-            s[i + 1] = 0xFF;
-            s[i + 2] = 0xFF;
+            __m128i *q = (__m128i *) (s + i);
+            _mm_storeu_si128(q, _mm_or_si128(_mm_loadu_si128(q), v));
         }
+#elif defined(IMAGE_NEON)
+        const uint8x16_t v = vld1q_u8(k);
+
+        for (; i + 16 <= n; i += 16)
+            vst1q_u8(s + i, vorrq_u8(vld1q_u8(s + i), v));
+#endif
+        if (b == 2)
+            for (; i < n; i += 2)
+                s[i] = 0xFF;
+        else
+            for (; i < n; i += 4)
+            {
+                s[i + 0] = 0xFF;
+                s[i + 1] = 0xFF;
+                s[i + 2] = 0xFF;
+            }
     }
 }
 
@@ -323,7 +592,8 @@ void image_white(void *p, int w, int h, int b)
  */
 void *image_flip(const void *p, int w, int h, int b, int hflip, int vflip)
 {
-    unsigned char *q;
+    const unsigned char *s = (const unsigned char *) p;
+    unsigned char       *q;
 
     assert(hflip || vflip);
 
@@ -332,20 +602,54 @@ void *image_flip(const void *p, int w, int h, int b, int hflip, int vflip)
 
     if ((q = malloc(w * b * h)))
     {
-        int r, c, i;
+        int r, c;
 
         for (r = 0; r < h; r++)
-            for (c = 0; c < w; c++)
-                for (i = 0; i < b; i++)
+        {
+            const unsigned char *src = s + (vflip ? h - r - 1 : r) * w * b;
+            unsigned char       *dst = q + r * w * b;
+
+            if (!hflip)
+            {
+                memcpy(dst, src, w * b);
+                continue;
+            }
+
+            c = 0;
+
+#if defined(IMAGE_SSE2)
+            if (b == 4)
+                for (; c + 4 <= w; c += 4)
+                {
+                    __m128i v = _mm_loadu_si128((const __m128i *)
+                                                (src + (w - c - 4) * 4));
+
+                    _mm_storeu_si128((__m128i *) (dst + c * 4),
+                                     _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3)));
+                }
+#elif defined(IMAGE_NEON)
+            if (b == 4)
+                for (; c + 4 <= w; c += 4)
                 {
-                    int pr = vflip ? h - r - 1 : r;
-                    int pc = hflip ? w - c - 1 : c;
+                    uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(src + (w - c - 4) * 4));
 
-                    int qi = r  * w * b + c  * b + i;
-                    int pi = pr * w * b + pc * b + i;
+                    v = vrev64q_u32(v);
+                    v = vextq_u32(v, v, 2);
 
-                    q[qi] = ((const unsigned char *) p)[pi];
+                    vst1q_u8(dst + c * 4, vreinterpretq_u8_u32(v));
+                }
+#endif
+            if (b == 3)
+                for (; c < w; c++)
+                {
+                    dst[c * 3 + 0] = src[(w - c - 1) * 3 + 0];
+                    dst[c * 3 + 1] = src[(w - c - 1) * 3 + 1];
+                    dst[c * 3 + 2] = src[(w - c - 1) * 3 + 2];
                 }
+            else
+                for (; c < w; c++)
+                    memcpy(dst + c * b, src + (w - c - 1) * b, b);
+        }
         return q;
     }
     return NULL;
@@ -24,6 +24,14 @@
 #include <ctype.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "common.h"
 #include "fs.h"
@@ -32,65 +40,133 @@
 
 /*---------------------------------------------------------------------------*/
 
-int read_line(char **dst, fs_file fin)
+char *strip_newline(char *str)
 {
-    char buff[MAXSTR];
+    char *c = str + strlen(str) - 1;
 
-    char *line, *new;
-    size_t len0, len1;
+    while (c >= str && (*c == '\n' || *c =='\r'))
+        *c-- = '\0';
 
-    line = NULL;
+    return str;
+}
 
-    while (fs_gets(buff, sizeof (buff), fin))
-    {
-        /* Append to data read so far. */
+char *dupe_string(const char *src)
+{
+    char *dst = NULL;
 
-        if (line)
-        {
-            new  = concat_string(line, buff, NULL);
-            free(line);
-            line = new;
-        }
-        else
-        {
-            line = strdup(buff);
-        }
+    if (src && (dst = malloc(strlen(src) + 1)))
+        strcpy(dst, src);
+
+    return dst;
+}
 
-        /* Strip newline, if any. */
+/*
+ * FNV-1a hash of the first N bytes of the string.
+ */
+unsigned int str_hash(const char *str, size_t n)
+{
+    unsigned int h = 2166136261u;
+
+    while (n-- && *str)
+        h = (h ^ (unsigned char) *str++) * 16777619u;
+
+    return h;
+}
+
+void str_map_init(struct str_map *sm)
+{
+    memset(sm, 0, sizeof (*sm));
+}
+
+void str_map_free(struct str_map *sm)
+{
+    int i;
 
-        len0 = strlen(line);
-        strip_newline(line);
-        len1 = strlen(line);
+    for (i = 0; i < sm->m; i++)
+        free(sm->k[i]);
 
-        if (len1 != len0)
+    free(sm->k);
+    free(sm->v);
+
+    memset(sm, 0, sizeof (*sm));
+}
+
+/*
+ * Find the slot of KEY, or the empty slot where it would go.
+ */
+static int str_map_slot(const struct str_map *sm, const char *key)
+{
+    unsigned int i = str_hash(key, strlen(key)) & (sm->m - 1);
+
+    while (sm->k[i] && strcmp(sm->k[i], key) != 0)
+        i = (i + 1) & (sm->m - 1);
+
+    return (int) i;
+}
+
+static int str_map_grow(struct str_map *sm)
+{
+    struct str_map old = *sm;
+    int i;
+
+    sm->m = old.m ? old.m * 2 : 16;
+    sm->n = old.n;
+    sm->k = calloc(sm->m, sizeof (*sm->k));
+    sm->v = calloc(sm->m, sizeof (*sm->v));
+
+    if (!sm->k || !sm->v)
+    {
+        free(sm->k);
+        free(sm->v);
+
+        *sm = old;
+        return 0;
+    }
+
+    for (i = 0; i < old.m; i++)
+        if (old.k[i])
         {
-            /* We hit a newline, clean up and break. */
-            line = realloc(line, len1 + 1);
-            break;
+            int j = str_map_slot(sm, old.k[i]);
+
+            sm->k[j] = old.k[i];
+            sm->v[j] = old.v[i];
         }
-    }
 
-    return (*dst = line) ? 1 : 0;
+    free(old.k);
+    free(old.v);
+
+    return 1;
 }
 
-char *strip_newline(char *str)
+void str_map_put(struct str_map *sm, const char *key, int val)
 {
-    char *c = str + strlen(str) - 1;
+    int i;
 
-    while (c >= str && (*c == '\n' || *c =='\r'))
-        *c-- = '\0';
+    /* Keep the table at most half full. */
 
-    return str;
+    if (2 * (sm->n + 1) > sm->m && !str_map_grow(sm))
+        return;
+
+    i = str_map_slot(sm, key);
+
+    if (!sm->k[i])
+    {
+        if (!(sm->k[i] = strdup(key)))
+            return;
+
+        sm->n++;
+    }
+    sm->v[i] = val;
 }
 
-char *dupe_string(const char *src)
+int str_map_get(const struct str_map *sm, const char *key, int def)
 {
-    char *dst = NULL;
+    int i;
 
-    if (src && (dst = malloc(strlen(src) + 1)))
-        strcpy(dst, src);
+    if (sm->m && sm->k[i = str_map_slot(sm, key)])
+        return sm->v[i];
 
-    return dst;
+    return def;
 }
 
 char *concat_string(const char *first, ...)
@@ -175,6 +251,43 @@ int file_rename(const char *src, const char *dst)
     return rename(src, dst);
 }
 
+/*
+ * Map the named file into memory read-only.  Return NULL on failure or
+ * where mapping is not supported.
+ */
+void *file_map(const char *name, int *size)
+{
+    void *p = NULL;
+
+#ifndef _WIN32
+    struct stat st;
+    int fd;
+
+    if ((fd = open(name, O_RDONLY)) >= 0)
+    {
+        if (fstat(fd, &st) == 0 && 0 < st.st_size && st.st_size <= INT_MAX)
+        {
+            p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (p == MAP_FAILED)
+                p = NULL;
+            else
+                *size = (int) st.st_size;
+        }
+        close(fd);
+    }
+#endif
+
+    return p;
+}
+
+void file_unmap(void *p, int size)
+{
+#ifndef _WIN32
+    munmap(p, (size_t) size);
+#endif
+}
+
 void file_copy(FILE *fin, FILE *fout)
 {
     char   buff[MAXSTR];
@@ -67,7 +67,6 @@ int rand_between(int low, int high);
 #define SAFECAT(dst, src) \
     (strncat((dst), (src), MAXSTRLEN(dst) - MIN(strlen(dst), MAXSTRLEN(dst))))
 
-int   read_line(char **, fs_file);
 char *strip_newline(char *);
 
 char *dupe_string(const char *);
@@ -81,6 +80,25 @@ char *concat_string(const char *first, ...) NULL_TERMINATED;
 #define str_starts_with(s, h) (strncmp((s), (h), strlen(h)) == 0)
 #define str_ends_with(s, t) ((strlen(s) >= strlen(t)) && strcmp((s) + strlen(s) - strlen(t), (t)) == 0)
 
+unsigned int str_hash(const char *, size_t);
+
+/*
+ * Hash table mapping strings to integers.  Keys are copied.
+ */
+
+struct str_map
+{
+    char **k;                           /* Open-addressed keys               */
+    int   *v;                           /* Values                            */
+    int    n;                           /* Number of keys                    */
+    int    m;                           /* Table size, a power of two        */
+};
+
+void str_map_init(struct str_map *);
+void str_map_free(struct str_map *);
+void str_map_put(struct str_map *, const char *, int);
+int  str_map_get(const struct str_map *, const char *, int);
+
 /*
  * Declaring vsnprintf with the C99 signature, even though we're
  * claiming to be ANSI C. This is probably bad but is not known to not
@@ -101,6 +119,9 @@ int  file_exists(const char *);
 int  file_rename(const char *, const char *);
 void file_copy(FILE *fin, FILE *fout);
 
+void *file_map(const char *, int *);
+void  file_unmap(void *, int);
+
 /* Paths. */
 
 int path_is_sep(int);
@@ -38,9 +38,12 @@ int CONFIG_REFLECTION;
 int CONFIG_MULTISAMPLE;
 int CONFIG_MIPMAP;
 int CONFIG_ANISO;
+int CONFIG_TEXTURE_CACHE;
+int CONFIG_BASE_CACHE;
 int CONFIG_BACKGROUND;
 int CONFIG_SHADOW;
 int CONFIG_AUDIO_BUFF;
+int CONFIG_AUDIO_VOICES;
 int CONFIG_MOUSE_SENSE;
 int CONFIG_MOUSE_RESPONSE;
 int CONFIG_MOUSE_INVERT;
@@ -104,6 +107,7 @@ int CONFIG_ROTATE_FAST;
 int CONFIG_ROTATE_SLOW;
 int CONFIG_CHEAT;
 int CONFIG_STATS;
+int CONFIG_GRAPH;
 int CONFIG_SCREENSHOT;
 int CONFIG_LOCK_GOALS;
 int CONFIG_CAMERA_1_SPEED;
@@ -140,9 +144,12 @@ static struct
     { &CONFIG_MULTISAMPLE,  "multisample",  0 },
     { &CONFIG_MIPMAP,       "mipmap",       1 },
     { &CONFIG_ANISO,        "aniso",        8 },
+    { &CONFIG_TEXTURE_CACHE, "texture_cache", 1 },
+    { &CONFIG_BASE_CACHE,   "base_cache",   16 },
     { &CONFIG_BACKGROUND,   "background",   1 },
     { &CONFIG_SHADOW,       "shadow",       1 },
     { &CONFIG_AUDIO_BUFF,   "audio_buff",   AUDIO_BUFF_HI },
+    { &CONFIG_AUDIO_VOICES, "audio_voices", 16 },
     { &CONFIG_MOUSE_SENSE,  "mouse_sense",  300 },
     { &CONFIG_MOUSE_RESPONSE, "mouse_response", 50 },
     { &CONFIG_MOUSE_INVERT, "mouse_invert", 0 },
@@ -210,6 +217,7 @@ static struct
     { &CONFIG_ROTATE_SLOW, "rotate_slow", 150 },
     { &CONFIG_CHEAT,       "cheat",       0 },
     { &CONFIG_STATS,       "stats",       0 },
+    { &CONFIG_GRAPH,       "graph",       0 },
     { &CONFIG_SCREENSHOT,  "screenshot",  0 },
     { &CONFIG_LOCK_GOALS,  "lock_goals",  0 },
 
@@ -340,15 +348,15 @@ static int scan_key_and_value(char **dst_key, char **dst_val, char *line)
 
 void config_load(void)
 {
-    fs_file fh;
+    fs_lines lr;
 
     SDL_assert(SDL_WasInit(SDL_INIT_VIDEO));
 
-    if ((fh = fs_open(USER_CONFIG_FILE, "r")))
+    if ((lr = fs_lines_open(USER_CONFIG_FILE)))
     {
         char *line, *key, *val;
 
-        while (read_line(&line, fh))
+        while ((line = fs_lines_get(lr)))
         {
             if (scan_key_and_value(&key, &val, line))
             {
@@ -407,9 +415,8 @@ void config_load(void)
                     }
                 }
             }
-            free(line);
         }
-        fs_close(fh);
+        fs_lines_close(lr);
 
         dirty = 0;
     }
@@ -35,9 +35,12 @@ extern int CONFIG_REFLECTION;
 extern int CONFIG_MULTISAMPLE;
 extern int CONFIG_MIPMAP;
 extern int CONFIG_ANISO;
+extern int CONFIG_TEXTURE_CACHE;
+extern int CONFIG_BASE_CACHE;
 extern int CONFIG_BACKGROUND;
 extern int CONFIG_SHADOW;
 extern int CONFIG_AUDIO_BUFF;
+extern int CONFIG_AUDIO_VOICES;
 extern int CONFIG_MOUSE_SENSE;
 extern int CONFIG_MOUSE_RESPONSE;
 extern int CONFIG_MOUSE_INVERT;
@@ -101,6 +104,7 @@ extern int CONFIG_ROTATE_FAST;
 extern int CONFIG_ROTATE_SLOW;
 extern int CONFIG_CHEAT;
 extern int CONFIG_STATS;
+extern int CONFIG_GRAPH;
 extern int CONFIG_SCREENSHOT;
 extern int CONFIG_LOCK_GOALS;
 extern int CONFIG_CAMERA_1_SPEED;
@@ -155,6 +159,7 @@ int config_screenshot(void);
 
 #define KEY_FPS        SDLK_F9
 #define KEY_POSE       SDLK_F10
+#define KEY_GRAPH      SDLK_F11
 #define KEY_SCREENSHOT SDLK_F12
 
 #endif
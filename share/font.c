@@ -24,19 +24,335 @@
 
 /*---------------------------------------------------------------------------*/
 
+#define ATLAS_MIN 256
+
+/*
+ * Decode the next UTF-8 sequence, advancing the string pointer. Return
+ * zero at the end of the string.
+ */
+static Uint32 utf8_next(const char **s)
+{
+    const unsigned char *p = (const unsigned char *) *s;
+
+    Uint32 c;
+    int    n, i;
+
+    if      (p[0] == 0)    return 0;
+    else if (p[0] < 0x80) { c = p[0];        n = 0; }
+    else if (p[0] < 0xC0) { c = 0xFFFD;      n = 0; }
+    else if (p[0] < 0xE0) { c = p[0] & 0x1F; n = 1; }
+    else if (p[0] < 0xF0) { c = p[0] & 0x0F; n = 2; }
+    else                  { c = p[0] & 0x07; n = 3; }
+
+    for (i = 1; i <= n; i++)
+    {
+        if ((p[i] & 0xC0) != 0x80)
+        {
+            *s += i;
+            return 0xFFFD;
+        }
+        c = (c << 6) | (p[i] & 0x3F);
+    }
+
+    *s += n + 1;
+
+    return c;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static struct glyph *atlas_slot(struct glyph *gv, int gm, Uint32 c)
+{
+    Uint32 i = (c * 2654435761u) & (gm - 1);
+
+    /* Linear probing. The table is never full. */
+
+    while (gv[i].c && gv[i].c != c)
+        i = (i + 1) & (gm - 1);
+
+    return gv + i;
+}
+
+static int atlas_rehash(struct atlas *ap)
+{
+    int m = ap->gm ? ap->gm * 2 : 128;
+    int i;
+
+    struct glyph *gv;
+
+    if ((gv = calloc(m, sizeof (*gv))))
+    {
+        for (i = 0; i < ap->gm; i++)
+            if (ap->gv[i].c)
+                *atlas_slot(gv, m, ap->gv[i].c) = ap->gv[i];
+
+        free(ap->gv);
+
+        ap->gv = gv;
+        ap->gm = m;
+
+        return 1;
+    }
+    return 0;
+}
+
+static void atlas_upload(struct atlas *ap, int x, int y, int w, int h,
+                         const void *p)
+{
+    glBindTexture(GL_TEXTURE_2D, ap->tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (p)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h,
+                        GL_ALPHA, GL_UNSIGNED_BYTE, p);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ap->w, ap->h, 0,
+                     GL_ALPHA, GL_UNSIGNED_BYTE, ap->p);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static int atlas_init(struct atlas *ap, TTF_Font *ttf)
+{
+    int s = ATLAS_MIN;
+
+    /* Start with room for a few rows of glyphs. */
+
+    while (s < TTF_FontHeight(ttf) * 8 && s < gli.max_texture_size)
+        s *= 2;
+
+    if ((ap->p = calloc(s, s)))
+    {
+        ap->w = s;
+        ap->h = s;
+
+        glGenTextures(1, &ap->tex);
+        glBindTexture(GL_TEXTURE_2D, ap->tex);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+        atlas_upload(ap, 0, 0, 0, 0, NULL);
+
+        return 1;
+    }
+    return 0;
+}
+
+static void atlas_free(struct atlas *ap)
+{
+    if (ap->tex)
+        glDeleteTextures(1, &ap->tex);
+
+    free(ap->p);
+    free(ap->gv);
+
+    memset(ap, 0, sizeof (*ap));
+}
+
+/*
+ * Double the smaller dimension of the atlas, keeping existing texels
+ * in place.  Texture coordinates computed before this are invalid.
+ */
+static int atlas_grow(struct atlas *ap)
+{
+    int w = ap->w;
+    int h = ap->h;
+    int y;
+
+    unsigned char *p;
+
+    if (h < w) h *= 2;
+    else       w *= 2;
+
+    if (w > gli.max_texture_size || h > gli.max_texture_size)
+        return 0;
+
+    if ((p = calloc(w, h)))
+    {
+        for (y = 0; y < ap->h; y++)
+            memcpy(p + y * w, ap->p + y * ap->w, ap->w);
+
+        free(ap->p);
+
+        ap->p = p;
+        ap->w = w;
+        ap->h = h;
+        ap->serial++;
+
+        atlas_upload(ap, 0, 0, 0, 0, NULL);
+
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Find space for a w-by-h rectangle using rows of shelves, growing the
+ * atlas as needed.
+ */
+static int atlas_pack(struct atlas *ap, int w, int h, int *x, int *y)
+{
+    do
+    {
+        if (ap->x + w > ap->w)
+        {
+            ap->x  = 0;
+            ap->y += ap->r;
+            ap->r  = 0;
+        }
+
+        if (ap->x + w <= ap->w && ap->y + h <= ap->h)
+        {
+            *x = ap->x;
+            *y = ap->y;
+
+            ap->x += w;
+            ap->r  = MAX(ap->r, h);
+
+            return 1;
+        }
+    }
+    while (atlas_grow(ap));
+
+    return 0;
+}
+
+/*
+ * Rasterize a glyph, trim it to its coverage and store it in the atlas.
+ */
+static void atlas_make(struct atlas *ap, TTF_Font *ttf, struct glyph *gp,
+                       const char *str)
+{
+    SDL_Color    col = { 0xFF, 0xFF, 0xFF, 0xFF };
+    SDL_Surface *srf;
+
+    int minx, maxx, miny, maxy, adv;
+
+    if ((srf = TTF_RenderUTF8_Blended(ttf, str, col)))
+    {
+        const SDL_PixelFormat *fmt = srf->format;
+
+        int x0 = srf->w, x1 = -1;
+        int y0 = srf->h, y1 = -1;
+        int x, y;
+
+        /* Find the bounding box of the covered pixels. */
+
+        for (y = 0; y < srf->h; y++)
+            for (x = 0; x < srf->w; x++)
+            {
+                const Uint8 *p = (const Uint8 *) srf->pixels
+                               + y * srf->pitch + x * fmt->BytesPerPixel;
+
+                if (*(const Uint32 *) p & fmt->Amask)
+                {
+                    x0 = MIN(x0, x); x1 = MAX(x1, x);
+                    y0 = MIN(y0, y); y1 = MAX(y1, y);
+                }
+            }
+
+        gp->a = srf->w;
+
+        if (gp->c <= 0xFFFF && TTF_GlyphMetrics(ttf, (Uint16) gp->c,
+                                                &minx, &maxx,
+                                                &miny, &maxy, &adv) == 0)
+            gp->a = adv;
+
+        /* Copy the alpha channel to the atlas, with one texel of padding. */
+
+        if (x1 >= x0 && y1 >= y0)
+        {
+            int w = x1 - x0 + 1;
+            int h = y1 - y0 + 1;
+            int X, Y;
+
+            unsigned char *q;
+
+            if (atlas_pack(ap, w + 1, h + 1, &X, &Y) && (q = malloc(w * h)))
+            {
+                for (y = 0; y < h; y++)
+                    for (x = 0; x < w; x++)
+                    {
+                        const Uint8 *p = (const Uint8 *) srf->pixels
+                                       + (y + y0) * srf->pitch
+                                       + (x + x0) * fmt->BytesPerPixel;
+
+                        Uint32 a = *(const Uint32 *) p & fmt->Amask;
+
+                        q[y * w + x] = (unsigned char) (a >> fmt->Ashift);
+                    }
+
+                for (y = 0; y < h; y++)
+                    memcpy(ap->p + (Y + y) * ap->w + X, q + y * w, w);
+
+                atlas_upload(ap, X, Y, w, h, q);
+                free(q);
+
+                gp->x = X;
+                gp->y = Y;
+                gp->w = w;
+                gp->h = h;
+                gp->l = x0;
+                gp->t = y0;
+            }
+        }
+        SDL_FreeSurface(srf);
+    }
+}
+
+/*
+ * Return the cached glyph for the UTF-8 sequence s of length n, adding
+ * it to the atlas if needed.
+ */
+static const struct glyph *atlas_glyph(struct atlas *ap, TTF_Font *ttf,
+                                       Uint32 c, const char *s, int n)
+{
+    struct glyph *gp;
+
+    if (ap->tex == 0 && !atlas_init(ap, ttf))
+        return NULL;
+
+    if ((ap->gc + 1) * 4 > ap->gm * 3 && !atlas_rehash(ap))
+        return NULL;
+
+    gp = atlas_slot(ap->gv, ap->gm, c);
+
+    if (gp->c == 0)
+    {
+        char str[8];
+
+        memcpy(str, s, n);
+        str[n] = 0;
+
+        memset(gp, 0, sizeof (*gp));
+        gp->c = c;
+        ap->gc++;
+
+        atlas_make(ap, ttf, gp, str);
+    }
+    return gp;
+}
+
+/*---------------------------------------------------------------------------*/
+
 int font_load(struct font *ft, const char *path, int sizes[3])
 {
     if (ft && path && *path)
     {
         memset(ft, 0, sizeof (*ft));
 
-        if ((ft->data = fs_load(path, &ft->datalen)))
+        if (fs_map(path, &ft->map))
         {
             int i;
 
             SAFECPY(ft->path, path);
 
-            ft->rwops = SDL_RWFromConstMem(ft->data, ft->datalen);
+            ft->rwops = SDL_RWFromConstMem(ft->map.data, ft->map.size);
 
             for (i = 0; i < ARRAYSIZE(ft->ttf); i++)
             {
@@ -56,14 +372,17 @@ void font_free(struct font *ft)
         int i;
 
         for (i = 0; i < ARRAYSIZE(ft->ttf); i++)
+        {
+            atlas_free(&ft->atlas[i]);
+
             if (ft->ttf[i])
                 TTF_CloseFont(ft->ttf[i]);
+        }
 
         if (ft->rwops)
             SDL_RWclose(ft->rwops);
 
-        if (ft->data)
-            free(ft->data);
+        fs_unmap(&ft->map);
 
         memset(ft, 0, sizeof (*ft));
     }
@@ -80,3 +399,69 @@ void font_quit(void)
 }
 
 /*---------------------------------------------------------------------------*/
+
+/*
+ * Lay out the given string using the glyph atlas of the given size.
+ * Fill at most qm quads and return the number filled.
+ */
+int font_layout(struct font *ft, int i, const char *text,
+                struct font_quad *qv, int qm)
+{
+    struct atlas *ap;
+    TTF_Font     *ttf;
+
+    const struct glyph *gp;
+    const char *s, *t;
+
+    Uint32 c, d = 0;
+    int qc = 0;
+    int x  = 0;
+
+    if (!(ft && (ttf = ft->ttf[i]) && text))
+        return 0;
+
+    ap = &ft->atlas[i];
+
+    /* Cache all glyphs first, as a resize moves texture coordinates. */
+
+    for (s = text; (t = s, c = utf8_next(&s)); )
+        atlas_glyph(ap, ttf, c, t, (int) (s - t));
+
+    /* Place each glyph at the pen position. */
+
+    for (s = text; qc < qm && (t = s, c = utf8_next(&s)); d = c)
+    {
+        if (!(gp = atlas_glyph(ap, ttf, c, t, (int) (s - t))))
+            continue;
+
+#ifdef SDL_TTF_VERSION_ATLEAST
+#if SDL_TTF_VERSION_ATLEAST(2, 0, 14)
+        if (d && d <= 0xFFFF && c <= 0xFFFF)
+            x += TTF_GetFontKerningSizeGlyphs(ttf, (Uint16) d, (Uint16) c);
+#endif
+#endif
+        if (gp->w > 0 && gp->h > 0)
+        {
+            struct font_quad *qp = qv + qc++;
+
+            qp->x0 = (float) (x + gp->l);
+            qp->y0 = (float) (    gp->t);
+            qp->x1 = (float) (x + gp->l + gp->w);
+            qp->y1 = (float) (    gp->t + gp->h);
+
+            qp->s0 = (float) (gp->x)         / ap->w;
+            qp->t0 = (float) (gp->y)         / ap->h;
+            qp->s1 = (float) (gp->x + gp->w) / ap->w;
+            qp->t1 = (float) (gp->y + gp->h) / ap->h;
+        }
+        x += gp->a;
+    }
+    return qc;
+}
+
+const struct atlas *font_atlas(const struct font *ft, int i)
+{
+    return ft ? &ft->atlas[i] : NULL;
+}
+
+/*---------------------------------------------------------------------------*/
@@ -4,16 +4,63 @@
 #include <SDL_ttf.h>
 #include <SDL_rwops.h>
 
+#include "glext.h"
 #include "base_config.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Glyphs are rasterized once per font size and packed into a shared
+ * texture.  Text is then drawn as one textured quad per glyph.
+ */
+
+struct glyph
+{
+    Uint32 c;                                  /* Code point (0 if unused)   */
+    short  x, y;                               /* Position in the atlas      */
+    short  w, h;                               /* Size in the atlas          */
+    short  l, t;                               /* Offset from pen and top    */
+    short  a;                                  /* Horizontal advance         */
+};
+
+struct atlas
+{
+    GLuint tex;                                /* Texture object             */
+    int    w, h;                               /* Texture size               */
+    int    x, y, r;                            /* Shelf cursor and height    */
+    int    serial;                             /* Incremented on resize      */
+
+    unsigned char *p;                          /* Copy of the alpha texels   */
+
+    struct glyph *gv;                          /* Hash table of glyphs       */
+    int           gc;
+    int           gm;
+};
+
+/*
+ * A laid out glyph.  Positions are in pixels, downward from the top
+ * left of the text box.  Texture coordinates are valid for the atlas
+ * serial at the time of layout.
+ */
+
+struct font_quad
+{
+    float x0, y0, x1, y1;
+    float s0, t0, s1, t1;
+};
+
+/*---------------------------------------------------------------------------*/
 
 struct font
 {
     char path[PATHMAX];
 
-    TTF_Font  *ttf[3];
-    SDL_RWops *rwops;
-    void      *data;
-    int        datalen;
+    TTF_Font     *ttf[3];
+    SDL_RWops    *rwops;
+    struct fs_map map;
+
+    struct atlas atlas[3];
 };
 
 int  font_load(struct font *, const char *path, int sizes[3]);
@@ -22,4 +69,10 @@ void font_free(struct font *);
 int  font_init(void);
 void font_quit(void);
 
+int  font_layout(struct font *, int, const char *, struct font_quad *, int);
+
+const struct atlas *font_atlas(const struct font *, int);
+
+/*---------------------------------------------------------------------------*/
+
 #endif
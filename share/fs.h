@@ -18,6 +18,8 @@ int fs_exists(const char *);
 int fs_remove(const char *);
 int fs_rename(const char *, const char *);
 
+long fs_mtime(const char *);
+
 fs_file fs_open(const char *path, const char *mode);
 int     fs_close(fs_file);
 
@@ -36,6 +38,29 @@ int   fs_puts(const char *src, fs_file);
 
 void *fs_load(const char *path, int *size);
 
+/*
+ * A read-only view of a whole file.  Files in real directories are
+ * memory-mapped; files in archives are loaded.  fs_map_file only maps,
+ * and fails on files that cannot be mapped.
+ */
+
+struct fs_map
+{
+    const void *data;
+    int         size;
+    int         mapped;                 /* Memory-mapped, not loaded */
+};
+
+int  fs_map(const char *path, struct fs_map *);
+int  fs_map_file(const char *path, struct fs_map *);
+void fs_unmap(struct fs_map *);
+
+typedef struct fs_lines_s *fs_lines;
+
+fs_lines fs_lines_open(const char *path);
+void     fs_lines_close(fs_lines);
+char    *fs_lines_get(fs_lines);
+
 int fs_mkdir(const char *);
 
 #include <stdarg.h>
@@ -48,6 +73,21 @@ int fs_printf(fs_file, const char *fmt, ...);
 Array fs_dir_scan(const char *, int (*filter)(struct dir_item *));
 void  fs_dir_free(Array);
 
+/*
+ * Locking of backend state for programs that use the file system from
+ * several threads.  Without a lock installed, these do nothing.
+ */
+
+void fs_set_lock(void (*lock)(void), void (*unlock)(void));
+void fs_lock(void);
+void fs_unlock(void);
+
+/* Directory listing cache, shared by the backends. */
+
+List fs_dir_list(const char *, List (*list_files)(const char *));
+void fs_dir_touch(const char *);
+void fs_dir_flush(void);
+
 const char *fs_resolve(const char *);
 
 #endif
@@ -65,6 +65,130 @@ int fs_add_path_with_archives(const char *path)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Directory listing cache.
+ *
+ * A listing is the union of a directory over all search paths, which
+ * is costly to build with many paths and archives.  Listings are kept
+ * until the search paths change, or until a file in the directory is
+ * written or removed.  Writes can happen on any thread and only mark
+ * a bucket of listings stale; the listings themselves are touched only
+ * by the thread that scans.
+ */
+
+#define DIR_STALE 64
+
+struct dir_listing
+{
+    char         *path;
+    unsigned int  hash;
+    int           listed;               /* Files are up to date              */
+    List          files;
+};
+
+static Array        dir_listings;
+static volatile int dir_stale[DIR_STALE];
+
+/*
+ * Return the cached listing of PATH, made with LIST_FILES if need be.
+ * The listing belongs to the cache.
+ */
+List fs_dir_list(const char *path, List (*list_files)(const char *))
+{
+    unsigned int hash = str_hash(path, strlen(path));
+    struct dir_listing *dl = NULL;
+    int i;
+
+    if (!dir_listings)
+        dir_listings = array_new(sizeof (struct dir_listing));
+
+    /* Drop every listing in a stale bucket. */
+
+    if (dir_stale[hash % DIR_STALE])
+    {
+        dir_stale[hash % DIR_STALE] = 0;
+
+        for (i = 0; i < array_len(dir_listings); i++)
+        {
+            struct dir_listing *p = array_get(dir_listings, i);
+
+            if (p->hash % DIR_STALE == hash % DIR_STALE && p->listed)
+            {
+                dir_list_free(p->files);
+
+                p->files  = NULL;
+                p->listed = 0;
+            }
+        }
+    }
+
+    for (i = 0; i < array_len(dir_listings); i++)
+    {
+        struct dir_listing *p = array_get(dir_listings, i);
+
+        if (p->hash == hash && strcmp(p->path, path) == 0)
+        {
+            dl = p;
+            break;
+        }
+    }
+
+    if (!dl)
+    {
+        dl = array_add(dir_listings);
+
+        dl->path   = strdup(path);
+        dl->hash   = hash;
+        dl->listed = 0;
+        dl->files  = NULL;
+    }
+
+    if (!dl->listed)
+    {
+        dl->files  = list_files(path);
+        dl->listed = 1;
+    }
+
+    return dl->files;
+}
+
+/*
+ * Note that the named file has been created, written or removed.
+ */
+void fs_dir_touch(const char *path)
+{
+    const char *sep = path_last_sep(path);
+    size_t      len = sep ? (size_t) (sep - path) : 0;
+
+    dir_stale[str_hash(path, len) % DIR_STALE] = 1;
+}
+
+/*
+ * Forget all listings.  Call this when the search paths change.
+ */
+void fs_dir_flush(void)
+{
+    if (dir_listings)
+    {
+        while (array_len(dir_listings))
+        {
+            struct dir_listing *dl = array_get(dir_listings,
+                                               array_len(dir_listings) - 1);
+
+            if (dl->listed)
+                dir_list_free(dl->files);
+
+            free(dl->path);
+            array_del(dir_listings);
+        }
+
+        array_free(dir_listings);
+        dir_listings = NULL;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 int fs_rename(const char *src, const char *dst)
 {
     const char *write_dir;
@@ -78,6 +202,9 @@ int fs_rename(const char *src, const char *dst)
 
         rc = file_rename(real_src, real_dst);
 
+        fs_dir_touch(src);
+        fs_dir_touch(dst);
+
         free(real_src);
         free(real_dst);
     }
@@ -164,6 +291,137 @@ char *fs_gets(char *dst, int count, fs_file fh)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Buffered line reader. The file is read in large blocks, lines are
+ * found with memchr and handed out in place, without their line endings
+ * and without any copying. A line is valid until the next call.
+ */
+
+#define LINES_BLOCK 4096
+
+struct fs_lines_s
+{
+    fs_file fh;
+
+    char *buf;                          /* Block buffer                      */
+    int   len;                          /* Allocated size, less terminator   */
+    int   head;                         /* Start of unread data              */
+    int   tail;                         /* End of unread data                */
+    int   eof;                          /* No more data in the file          */
+};
+
+fs_lines fs_lines_open(const char *path)
+{
+    fs_lines lr;
+
+    if ((lr = calloc(1, sizeof (*lr))))
+    {
+        if ((lr->buf = malloc(LINES_BLOCK + 1)) &&
+            (lr->fh  = fs_open(path, "r")))
+        {
+            lr->len = LINES_BLOCK;
+            return lr;
+        }
+
+        free(lr->buf);
+        free(lr);
+    }
+    return NULL;
+}
+
+void fs_lines_close(fs_lines lr)
+{
+    if (lr)
+    {
+        fs_close(lr->fh);
+        free(lr->buf);
+        free(lr);
+    }
+}
+
+/*
+ * Read more data into the buffer, first moving unread data to the front
+ * and growing the buffer if a single line fills it.
+ */
+static int lines_fill(fs_lines lr)
+{
+    int n = lr->tail - lr->head;
+
+    if (lr->head > 0)
+    {
+        memmove(lr->buf, lr->buf + lr->head, n);
+
+        lr->head = 0;
+        lr->tail = n;
+    }
+
+    if (lr->tail == lr->len)
+    {
+        char *p;
+
+        if (!(p = realloc(lr->buf, lr->len * 2 + 1)))
+            return 0;
+
+        lr->buf  = p;
+        lr->len *= 2;
+    }
+
+    if ((n = fs_read(lr->buf + lr->tail, 1, lr->len - lr->tail, lr->fh)) > 0)
+    {
+        lr->tail += n;
+        return 1;
+    }
+    return 0;
+}
+
+char *fs_lines_get(fs_lines lr)
+{
+    char *s, *e, *c, *d;
+    int n = 0;
+
+    /* Scan for a newline, reading more only when none is buffered. */
+
+    while (!(e = memchr(lr->buf + lr->head + n, '\n',
+                        lr->tail - lr->head - n)))
+    {
+        n = lr->tail - lr->head;
+
+        if (lr->eof || !lines_fill(lr))
+        {
+            lr->eof = 1;
+
+            /* Hand out the last line, if it lacks a newline. */
+
+            if (lr->head == lr->tail)
+                return NULL;
+
+            e = lr->buf + lr->tail;
+            break;
+        }
+    }
+
+    s = lr->buf + lr->head;
+
+    lr->head = (e < lr->buf + lr->tail) ? (e - lr->buf) + 1 : lr->tail;
+
+    *e = '\0';
+
+    /* Drop carriage returns, as fs_gets does. */
+
+    if ((c = memchr(s, '\r', e - s)))
+    {
+        for (d = c; c < e; c++)
+            if (*c != '\r')
+                *d++ = *c;
+
+        *d = '\0';
+    }
+
+    return s;
+}
+
+/*---------------------------------------------------------------------------*/
+
 /*
  * Write out a multiline string to a file with appropriately converted
  * linefeed characters.
@@ -276,6 +534,51 @@ void *fs_load(const char *path, int *datalen)
     return data;
 }
 
+int fs_map(const char *path, struct fs_map *map)
+{
+    /* Load whatever can't be mapped. */
+
+    if (!fs_map_file(path, map))
+        map->data = fs_load(path, &map->size);
+
+    return (map->data != NULL);
+}
+
+void fs_unmap(struct fs_map *map)
+{
+    if (map->data)
+    {
+        if (map->mapped)
+            file_unmap((void *) map->data, map->size);
+        else
+            free((void *) map->data);
+    }
+    memset(map, 0, sizeof (*map));
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void (*lock_func)(void);
+static void (*unlock_func)(void);
+
+void fs_set_lock(void (*lock)(void), void (*unlock)(void))
+{
+    lock_func   = lock;
+    unlock_func = unlock;
+}
+
+void fs_lock(void)
+{
+    if (lock_func)
+        lock_func();
+}
+
+void fs_unlock(void)
+{
+    if (unlock_func)
+        unlock_func();
+}
+
 /*---------------------------------------------------------------------------*/
 
 /*
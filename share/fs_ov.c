@@ -12,8 +12,13 @@
  * General Public License for more details.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "fs.h"
 #include "fs_ov.h"
+#include "common.h"
 
 size_t fs_ov_read(void *ptr, size_t size, size_t nmemb, void *datasource)
 {
@@ -34,3 +39,81 @@ long fs_ov_tell(void *datasource)
 {
     return fs_tell(datasource);
 }
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Decode straight out of a memory-mapped file.  Files that can't be
+ * mapped are refused, and left to the regular file callbacks.
+ */
+
+struct ov_map
+{
+    struct fs_map map;
+    long          pos;
+};
+
+void *fs_ov_map_open(const char *path)
+{
+    struct ov_map *src;
+
+    if ((src = calloc(1, sizeof (*src))))
+    {
+        if (fs_map_file(path, &src->map))
+            return src;
+
+        fs_unmap(&src->map);
+        free(src);
+    }
+    return NULL;
+}
+
+size_t fs_ov_map_read(void *ptr, size_t size, size_t nmemb, void *datasource)
+{
+    struct ov_map *src = datasource;
+    size_t n = 0;
+
+    if (size)
+    {
+        n = MIN(nmemb, (size_t) (src->map.size - src->pos) / size);
+
+        memcpy(ptr, (const char *) src->map.data + src->pos, n * size);
+        src->pos += (long) (n * size);
+    }
+    return n;
+}
+
+int fs_ov_map_seek(void *datasource, ogg_int64_t offset, int whence)
+{
+    struct ov_map *src = datasource;
+    ogg_int64_t pos;
+
+    switch (whence)
+    {
+    case SEEK_SET: pos = offset;                 break;
+    case SEEK_CUR: pos = src->pos + offset;      break;
+    case SEEK_END: pos = src->map.size + offset; break;
+    default:       return -1;
+    }
+
+    if (pos < 0 || pos > src->map.size)
+        return -1;
+
+    src->pos = (long) pos;
+    return 0;
+}
+
+int fs_ov_map_close(void *datasource)
+{
+    struct ov_map *src = datasource;
+
+    fs_unmap(&src->map);
+    free(src);
+
+    return 0;
+}
+
+long fs_ov_map_tell(void *datasource)
+{
+    return ((struct ov_map *) datasource)->pos;
+}
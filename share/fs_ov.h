@@ -9,4 +9,10 @@ int    fs_ov_seek(void *datasource, ogg_int64_t offset, int whence);
 int    fs_ov_close(void *datasource);
 long   fs_ov_tell(void *datasource);
 
+void  *fs_ov_map_open(const char *path);
+size_t fs_ov_map_read(void *ptr, size_t size, size_t nmemb, void *datasource);
+int    fs_ov_map_seek(void *datasource, ogg_int64_t offset, int whence);
+int    fs_ov_map_close(void *datasource);
+long   fs_ov_map_tell(void *datasource);
+
 #endif
@@ -14,17 +14,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
+#include <sys/stat.h>
 #include <physfs.h>
 
 #include "fs.h"
 #include "dir.h"
 #include "array.h"
+#include "list.h"
 #include "common.h"
 
 /*
  * This file implements the low-level virtual file system routines
- * using the PhysicsFS 1.0 API.
+ * using the PhysicsFS 2.0 API.
  */
 
 /*---------------------------------------------------------------------------*/
@@ -34,6 +37,375 @@ struct fs_file_s
     PHYSFS_file *handle;
 };
 
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Archives.
+ *
+ * Mounting an archive reads its whole central directory, which makes
+ * start-up slow with many addon archives.  Instead, the contents of an
+ * archive are listed once into an index in the user directory, keyed by
+ * archive size and modification time, and the archive is mounted only
+ * when a file in it is first opened.
+ *
+ * Each archive gets a mount point of its own, so the order of mounting
+ * doesn't matter.  A lookup finds the directory holding a path through
+ * the search path and the archive holding it through the listings, and
+ * takes whichever source was added last.
+ *
+ * Sources are added on the main thread, while files are opened, and
+ * archives thus listed and mounted, from worker threads too.  All of
+ * this state is accessed under the file system lock.
+ */
+
+#define ARCHIVE_INDEX "archives.idx"
+#define ARCHIVE_MOUNT ".zip"
+
+struct source
+{
+    char *path;                         /* Directory or archive path         */
+    char *mount;                        /* Archive mount point               */
+    int   archive;                      /* Source is an archive              */
+    int   listed;                       /* Archive contents are known        */
+    int   mounted;                      /* Archive is mounted                */
+    long  size;                         /* Archive size                      */
+    long  mtime;                        /* Archive modification time         */
+
+    Array          files;               /* Archive files (char *)            */
+    struct str_map names;               /* Archive files and directories     */
+};
+
+static Array sources;                   /* Lowest precedence first           */
+static int   unlisted;                  /* Archives yet to be listed         */
+
+static struct source *get_source(int i)
+{
+    return array_get(sources, i);
+}
+
+static void add_source(const char *path, int archive, long size, long mtime)
+{
+    struct source *s;
+    char mount[MAXSTR];
+
+    if (!sources)
+        sources = array_new(sizeof (struct source));
+
+    if ((s = array_add(sources)))
+    {
+        memset(s, 0, sizeof (*s));
+
+        s->path    = strdup(path);
+        s->archive = archive;
+        s->size    = size;
+        s->mtime   = mtime;
+
+        if (archive)
+        {
+            sprintf(mount, "%s/%d", ARCHIVE_MOUNT, array_len(sources));
+
+            s->mount = strdup(mount);
+            s->files = array_new(sizeof (char *));
+
+            str_map_init(&s->names);
+            unlisted++;
+        }
+    }
+}
+
+static void free_files(struct source *s)
+{
+    int i;
+
+    for (i = 0; i < array_len(s->files); i++)
+        free(*((char **) array_get(s->files, i)));
+
+    array_free(s->files);
+    str_map_free(&s->names);
+}
+
+static void drop_files(struct source *s)
+{
+    free_files(s);
+
+    s->files = array_new(sizeof (char *));
+    str_map_init(&s->names);
+}
+
+static void free_sources(void)
+{
+    int i;
+
+    if (sources)
+    {
+        for (i = 0; i < array_len(sources); i++)
+        {
+            struct source *s = get_source(i);
+
+            if (s->archive)
+                free_files(s);
+
+            free(s->mount);
+            free(s->path);
+        }
+
+        array_free(sources);
+
+        sources  = NULL;
+        unlisted = 0;
+    }
+}
+
+/*
+ * Add a file to an archive listing, along with its parent directories.
+ */
+static void add_file(struct source *s, const char *file)
+{
+    char *name, *dir, *p;
+
+    if ((name = strdup(file)))
+    {
+        *((char **) array_add(s->files)) = name;
+        str_map_put(&s->names, name, 1);
+
+        if ((dir = strdup(file)))
+        {
+            while ((p = strrchr(dir, '/')))
+            {
+                *p = 0;
+
+                if (str_map_get(&s->names, dir, 0))
+                    break;
+
+                str_map_put(&s->names, dir, 2);
+            }
+            free(dir);
+        }
+    }
+}
+
+static int mount_archive(struct source *s)
+{
+    if (!s->mounted)
+        s->mounted = PHYSFS_mount(s->path, s->mount, 1);
+
+    return s->mounted;
+}
+
+static void scan_dir(struct source *s, const char *dir)
+{
+    char **files, **file;
+    char *path, *name, *real;
+
+    path = concat_string(s->mount, "/", dir, NULL);
+
+    if (path && (files = PHYSFS_enumerateFiles(path)))
+    {
+        for (file = files; *file; file++)
+        {
+            name = (dir[0] ?
+                    concat_string(dir, "/", *file, NULL) :
+                    strdup(*file));
+            real = concat_string(s->mount, "/", name, NULL);
+
+            if (name && real)
+            {
+                if (PHYSFS_isDirectory(real))
+                    scan_dir(s, name);
+                else
+                    add_file(s, name);
+            }
+
+            free(real);
+            free(name);
+        }
+        PHYSFS_freeList(files);
+    }
+    free(path);
+}
+
+/*
+ * List an archive the slow way, by mounting it.
+ */
+static void scan_archive(struct source *s)
+{
+    if (mount_archive(s))
+        scan_dir(s, "");
+
+    s->listed = 1;
+}
+
+static struct source *find_unlisted(const char *path, long size, long mtime)
+{
+    int i;
+
+    for (i = 0; i < array_len(sources); i++)
+    {
+        struct source *s = get_source(i);
+
+        if (s->archive && !s->listed && s->size == size && s->mtime == mtime &&
+            strcmp(s->path, path) == 0)
+            return s;
+    }
+    return NULL;
+}
+
+/*
+ * The index holds a "size mtime count path" line for each archive,
+ * followed by the paths of its files, one per line.
+ */
+static void load_index(void)
+{
+    const char *dir;
+    char *name;
+    FILE *fp;
+
+    char line[MAXSTR * 4];
+    long size, mtime;
+    int  count, n;
+
+    if (!(dir = PHYSFS_getWriteDir()) || !(name = path_join(dir, ARCHIVE_INDEX)))
+        return;
+
+    if ((fp = fopen(name, "r")))
+    {
+        while (fgets(line, sizeof (line), fp))
+        {
+            struct source *s;
+
+            if (sscanf(line, "%ld %ld %d %n", &size, &mtime, &count, &n) < 3)
+                break;
+
+            s = find_unlisted(strip_newline(line + n), size, mtime);
+
+            for (; count > 0 && fgets(line, sizeof (line), fp); count--)
+                if (s)
+                    add_file(s, strip_newline(line));
+
+            /* Ignore a truncated listing. */
+
+            if (s)
+            {
+                if (count == 0)
+                    s->listed = 1;
+                else
+                    drop_files(s);
+            }
+        }
+        fclose(fp);
+    }
+    free(name);
+}
+
+static void save_index(void)
+{
+    const char *dir;
+    char *name;
+    FILE *fp;
+    int i, j;
+
+    if (!(dir = PHYSFS_getWriteDir()) || !(name = path_join(dir, ARCHIVE_INDEX)))
+        return;
+
+    if ((fp = fopen(name, "w")))
+    {
+        for (i = 0; i < array_len(sources); i++)
+        {
+            struct source *s = get_source(i);
+
+            if (s->archive && s->listed)
+            {
+                fprintf(fp, "%ld %ld %d %s\n", s->size, s->mtime,
+                        array_len(s->files), s->path);
+
+                for (j = 0; j < array_len(s->files); j++)
+                    fprintf(fp, "%s\n", *((char **) array_get(s->files, j)));
+            }
+        }
+        fclose(fp);
+    }
+    free(name);
+
+    fs_dir_touch(ARCHIVE_INDEX);
+}
+
+/*
+ * Find listings for new archives, from the index where it's current.
+ */
+static void list_archives(void)
+{
+    int i, scanned = 0;
+
+    if (unlisted)
+    {
+        load_index();
+
+        for (i = 0; i < array_len(sources); i++)
+        {
+            struct source *s = get_source(i);
+
+            if (s->archive && !s->listed)
+            {
+                scan_archive(s);
+                scanned++;
+            }
+        }
+
+        if (scanned)
+            save_index();
+
+        unlisted = 0;
+    }
+}
+
+static int find_source(const char *path)
+{
+    int i;
+
+    for (i = array_len(sources) - 1; i >= 0; i--)
+        if (strcmp(get_source(i)->path, path) == 0)
+            return i;
+
+    return -1;
+}
+
+/*
+ * Return the archive holding PATH, unless a directory added later
+ * holds it too.
+ */
+static struct source *find_archive(const char *path)
+{
+    const char *dir;
+    int i, n = 0;
+
+    if (!sources)
+        return NULL;
+
+    list_archives();
+
+    if ((dir = PHYSFS_getRealDir(path)))
+        n = ((i = find_source(dir)) < 0 ? array_len(sources) : i + 1);
+
+    for (i = array_len(sources) - 1; i >= n; i--)
+    {
+        struct source *s = get_source(i);
+
+        if (s->archive && str_map_get(&s->names, path, 0))
+            return s;
+    }
+    return NULL;
+}
+
+/*
+ * Mount an archive and return the path of a file in it.
+ */
+static char *archive_path(struct source *s, const char *path)
+{
+    return mount_archive(s) ? concat_string(s->mount, "/", path, NULL) : NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+
 int fs_init(const char *argv0)
 {
     if (PHYSFS_init(argv0))
@@ -47,7 +419,18 @@ int fs_init(const char *argv0)
 
 int fs_quit(void)
 {
-    return PHYSFS_deinit();
+    int rc;
+
+    fs_dir_flush();
+
+    fs_lock();
+    {
+        rc = PHYSFS_deinit();
+        free_sources();
+    }
+    fs_unlock();
+
+    return rc;
 }
 
 const char *fs_error(void)
@@ -64,11 +447,34 @@ const char *fs_base_dir(void)
 
 int fs_add_path(const char *path)
 {
-    return PHYSFS_addToSearchPath(path, 0);
+    struct stat info;
+    int rc = 0;
+
+    fs_dir_flush();
+
+    fs_lock();
+    {
+        /* Archives are listed and mounted on first use. */
+
+        if (!dir_exists(path) && stat(path, &info) == 0)
+        {
+            add_source(path, 1, (long) info.st_size, (long) info.st_mtime);
+            rc = 1;
+        }
+        else if (PHYSFS_addToSearchPath(path, 0))
+        {
+            add_source(path, 0, 0, 0);
+            rc = 1;
+        }
+    }
+    fs_unlock();
+
+    return rc;
 }
 
 int fs_set_write_dir(const char *path)
 {
+    fs_dir_flush();
     return PHYSFS_setWriteDir(path);
 }
 
@@ -79,34 +485,107 @@ const char *fs_get_write_dir(void)
 
 /*---------------------------------------------------------------------------*/
 
-static List list_files(const char *path)
+static int cmp_names(const void *a, const void *b)
 {
-    List list = NULL;
-    char **files, **file;
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+static void add_name(Array names, const char *name, size_t len)
+{
+    char *copy;
 
-    if ((files = PHYSFS_enumerateFiles(path)))
+    if ((copy = malloc(len + 1)))
     {
-        for (file = files; *file; file++)
-            list = list_cons(strdup(*file), list);
+        memcpy(copy, name, len);
+        copy[len] = 0;
 
-        PHYSFS_freeList(files);
+        *((char **) array_add(names)) = copy;
     }
-
-    return list;
 }
 
-static void free_files(List list)
+static List list_files(const char *path)
 {
-    while (list)
+    Array  names = array_new(sizeof (char *));
+    List   files = NULL;
+    size_t len   = strlen(path);
+    char **list, **item;
+    int    i, j;
+
+    /* Gather names from the search path and from archive listings. */
+
+    if ((list = PHYSFS_enumerateFiles(path)))
+    {
+        for (item = list; *item; item++)
+            if (len || strcmp(*item, ARCHIVE_MOUNT) != 0)
+                add_name(names, *item, strlen(*item));
+
+        PHYSFS_freeList(list);
+    }
+
+    fs_lock();
+    {
+        list_archives();
+
+        for (i = 0; sources && i < array_len(sources); i++)
+        {
+            struct source *s = get_source(i);
+
+            if (!s->archive)
+                continue;
+
+            for (j = 0; j < array_len(s->files); j++)
+            {
+                const char *name = *((char **) array_get(s->files, j));
+                const char *next;
+
+                if (len)
+                {
+                    if (strncmp(name, path, len) != 0 || name[len] != '/')
+                        continue;
+
+                    name += len + 1;
+                }
+
+                next = strchr(name, '/');
+                add_name(names, name,
+                         next ? (size_t) (next - name) : strlen(name));
+            }
+        }
+    }
+    fs_unlock();
+
+    /* Sort and drop duplicates. */
+
+    array_sort(names, cmp_names);
+
+    for (i = array_len(names) - 1; i >= 0; i--)
     {
-        free(list->data);
-        list = list_rest(list);
+        char *name = *((char **) array_get(names, i));
+
+        if (files && strcmp(files->data, name) == 0)
+            free(name);
+        else
+            files = list_cons(name, files);
     }
+
+    array_free(names);
+
+    return files;
+}
+
+static List cached_files(const char *path)
+{
+    return fs_dir_list(path, list_files);
+}
+
+static void keep_files(List files)
+{
+    /* Listings belong to the cache. */
 }
 
 Array fs_dir_scan(const char *path, int (*filter)(struct dir_item *))
 {
-    return dir_scan(path, filter, list_files, free_files);
+    return dir_scan(path, filter, cached_files, keep_files);
 }
 
 void fs_dir_free(Array items)
@@ -118,7 +597,9 @@ void fs_dir_free(Array items)
 
 fs_file fs_open(const char *path, const char *mode)
 {
+    struct source *s;
     fs_file fh;
+    char *real = NULL;
 
     assert((mode[0] == 'r' && !mode[1]) ||
            (mode[0] == 'w' && (!mode[1] || mode[1] == '+')));
@@ -128,13 +609,23 @@ fs_file fs_open(const char *path, const char *mode)
         switch (mode[0])
         {
         case 'r':
-            fh->handle = PHYSFS_openRead(path);
+            fs_lock();
+            {
+                if ((s = find_archive(path)))
+                    real = archive_path(s, path);
+            }
+            fs_unlock();
+
+            fh->handle = PHYSFS_openRead(real ? real : path);
+            free(real);
             break;
 
         case 'w':
             fh->handle = (mode[1] == '+' ?
                           PHYSFS_openAppend(path) :
                           PHYSFS_openWrite(path));
+
+            fs_dir_touch(path);
             break;
         }
 
@@ -166,17 +657,78 @@ int fs_close(fs_file fh)
 
 int fs_mkdir(const char *path)
 {
-    return PHYSFS_mkdir(path);
+    int rc = PHYSFS_mkdir(path);
+
+    fs_dir_touch(path);
+    return rc;
 }
 
 int fs_exists(const char *path)
 {
-    return PHYSFS_exists(path);
+    int rc;
+
+    fs_lock();
+    {
+        rc = (find_archive(path) != NULL);
+    }
+    fs_unlock();
+
+    return rc || PHYSFS_exists(path);
 }
 
 int fs_remove(const char *path)
 {
-    return PHYSFS_delete(path);
+    int rc = PHYSFS_delete(path);
+
+    fs_dir_touch(path);
+    return rc;
+}
+
+long fs_mtime(const char *path)
+{
+    struct source *s;
+    long t = -1;
+
+    /* Files in an archive date from the archive. */
+
+    fs_lock();
+    {
+        if ((s = find_archive(path)))
+            t = s->mtime;
+    }
+    fs_unlock();
+
+    return s ? t : (long) PHYSFS_getLastModTime(path);
+}
+
+int fs_map_file(const char *path, struct fs_map *map)
+{
+    const char *dir;
+    char *real;
+    int archived;
+
+    memset(map, 0, sizeof (*map));
+
+    fs_lock();
+    {
+        archived = (find_archive(path) != NULL);
+    }
+    fs_unlock();
+
+    /* Files in archives have no real path to map. */
+
+    if (!archived && (dir = PHYSFS_getRealDir(path)) && dir_exists(dir))
+    {
+        if ((real = path_join(dir, path)))
+        {
+            map->data   = file_map(real, &map->size);
+            map->mapped = (map->data != NULL);
+
+            free(real);
+        }
+    }
+
+    return map->mapped;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -67,3 +67,27 @@ SDL_RWops *fs_rwops_open(const char *path, const char *mode)
 
     return NULL;
 }
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Guard the file system with an SDL mutex, for use from SDL threads.
+ */
+
+static SDL_mutex *fs_mutex;
+
+static void rwops_lock(void)
+{
+    SDL_LockMutex(fs_mutex);
+}
+
+static void rwops_unlock(void)
+{
+    SDL_UnlockMutex(fs_mutex);
+}
+
+void fs_rwops_lock(void)
+{
+    if (!fs_mutex && (fs_mutex = SDL_CreateMutex()))
+        fs_set_lock(rwops_lock, rwops_unlock);
+}
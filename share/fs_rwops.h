@@ -7,4 +7,6 @@
 SDL_RWops *fs_rwops_make(fs_file);
 SDL_RWops *fs_rwops_open(const char *path, const char *mode);
 
+void fs_rwops_lock(void);
+
 #endif
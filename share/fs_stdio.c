@@ -17,6 +17,7 @@
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include "fs.h"
 #include "dir.h"
@@ -69,6 +70,8 @@ int fs_quit(void)
         fs_path = list_rest(fs_path);
     }
 
+    fs_dir_flush();
+
     return 1;
 }
 
@@ -91,6 +94,7 @@ int fs_add_path(const char *path)
     if (dir_exists(path))
     {
         fs_path = list_cons(strdup(path), fs_path);
+        fs_dir_flush();
         return 1;
     }
     return 0;
@@ -107,6 +111,7 @@ int fs_set_write_dir(const char *path)
         }
 
         fs_dir_write = strdup(path);
+        fs_dir_flush();
         return 1;
     }
     return 0;
@@ -119,74 +124,65 @@ const char *fs_get_write_dir(void)
 
 /*---------------------------------------------------------------------------*/
 
-static void add_files(List *items, const char *real)
+static int cmp_names(const void *a, const void *b)
 {
-    List files, file;
-
-    if ((files = dir_list_files(real)))
-    {
-        for (file = files; file; file = file->next)
-        {
-            int skip = 0;
-            List p, l;
-
-            /* "Inspired" by PhysicsFS file enumeration code. */
-
-            for (p = NULL, l = *items; l; p = l, l = l->next)
-            {
-                int cmp;
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
 
-                if ((cmp = strcmp(l->data, file->data)) >= 0)
-                {
-                    skip = (cmp == 0);
-                    break;
-                }
-            }
+static List list_files(const char *path)
+{
+    Array names = array_new(sizeof (char *));
+    List  files = NULL;
+    List  p, l;
+    int   i;
 
-            if (!skip)
-            {
-                if (p)
-                    p->next = list_cons(file->data, p->next);
-                else
-                    *items = list_cons(file->data, *items);
+    /* Gather names from all search paths, then sort and drop duplicates. */
 
-                /* Take over memory management duties. */
+    for (p = fs_path; p; p = p->next)
+    {
+        char *real = path_join(p->data, path);
+        List  list = dir_list_files(real);
 
-                file->data = NULL;
-            }
+        for (l = list; l; l = l->next)
+        {
+            *((char **) array_add(names)) = l->data;
+            l->data = NULL;
         }
 
-        dir_list_free(files);
+        dir_list_free(list);
+        free(real);
     }
-}
 
-static List list_files(const char *path)
-{
-    List files = NULL;
-    List p;
+    array_sort(names, cmp_names);
 
-    for (p = fs_path; p; p = p->next)
+    for (i = array_len(names) - 1; i >= 0; i--)
     {
-        char *real = path_join(p->data, path);
-        add_files(&files, real);
-        free(real);
+        char *name = *((char **) array_get(names, i));
+
+        if (files && strcmp(files->data, name) == 0)
+            free(name);
+        else
+            files = list_cons(name, files);
     }
 
+    array_free(names);
+
     return files;
 }
 
-static void free_files(List files)
+static List cached_files(const char *path)
 {
-    while (files)
-    {
-        free(files->data);
-        files = list_rest(files);
-    }
+    return fs_dir_list(path, list_files);
+}
+
+static void keep_files(List files)
+{
+    /* Listings belong to the cache. */
 }
 
 Array fs_dir_scan(const char *path, int (*filter)(struct dir_item *))
 {
-    return dir_scan(path, filter, list_files, free_files);
+    return dir_scan(path, filter, cached_files, keep_files);
 }
 
 void fs_dir_free(Array items)
@@ -251,6 +247,8 @@ fs_file fs_open(const char *path, const char *mode)
                               fopen(real, "wb+"));
 
                 free(real);
+
+                fs_dir_touch(path);
             }
             break;
         }
@@ -286,6 +284,8 @@ int fs_mkdir(const char *path)
     rc = dir_make(real);
     free((void *) real);
 
+    fs_dir_touch(path);
+
     return rc == 0;
 }
 
@@ -310,9 +310,44 @@ int fs_remove(const char *path)
     rc = (remove(real) == 0);
     free(real);
 
+    fs_dir_touch(path);
+
     return rc;
 }
 
+long fs_mtime(const char *path)
+{
+    struct stat st;
+    char *real;
+    long t = -1;
+
+    if ((real = real_path(path)))
+    {
+        if (stat(real, &st) == 0)
+            t = (long) st.st_mtime;
+
+        free(real);
+    }
+    return t;
+}
+
+int fs_map_file(const char *path, struct fs_map *map)
+{
+    char *real;
+
+    memset(map, 0, sizeof (*map));
+
+    if ((real = real_path(path)))
+    {
+        map->data   = file_map(real, &map->size);
+        map->mapped = (map->data != NULL);
+
+        free(real);
+    }
+
+    return map->mapped;
+}
+
 /*---------------------------------------------------------------------------*/
 
 int fs_read(void *data, int size, int count, fs_file fh)
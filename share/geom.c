@@ -315,6 +315,13 @@ static struct s_full vect;
 static struct s_full back;
 static struct s_full item[GEOM_MAX];
 
+/* Per-model item batches and the positions gathered for them. */
+
+static struct s_batch item_batch[GEOM_MAX];
+
+static float *item_pv[GEOM_MAX];
+static int    item_pm[GEOM_MAX];
+
 static int back_state = 0;
 
 /*---------------------------------------------------------------------------*/
@@ -331,7 +338,10 @@ void geom_init(void)
     sol_load_full(&vect, "geom/vect/vect.sol", 0);
 
     for (i = 0; i < GEOM_MAX; i++)
+    {
         sol_load_full(&item[i], item_sols[i], 0);
+        sol_load_batch(&item_batch[i], &item[i].draw);
+    }
 }
 
 void geom_free(void)
@@ -346,7 +356,14 @@ void geom_free(void)
     sol_free_full(&beam);
 
     for (i = 0; i < GEOM_MAX; i++)
+    {
+        sol_free_batch(&item_batch[i]);
         sol_free_full(&item[i]);
+
+        free(item_pv[i]);
+        item_pv[i] = NULL;
+        item_pm[i] = 0;
+    }
 }
 
 void geom_step(float dt)
@@ -364,7 +381,7 @@ void geom_step(float dt)
 
 /*---------------------------------------------------------------------------*/
 
-static struct s_draw *item_file(const struct v_item *hp)
+static int item_geom(const struct v_item *hp)
 {
     int g = GEOM_COIN;
 
@@ -382,7 +399,12 @@ static struct s_draw *item_file(const struct v_item *hp)
         }
     }
 
-    return &item[g].draw;
+    return g;
+}
+
+static struct s_draw *item_file(const struct v_item *hp)
+{
+    return &item[item_geom(hp)].draw;
 }
 
 void item_color(const struct v_item *hp, float *c)
@@ -431,6 +453,75 @@ void item_draw(struct s_rend *rend,
     glPopMatrix();
 }
 
+/*
+ * Draw all items that have not been picked up.  Opaque models without
+ * billboards are drawn in one batch per model, which leaves the result
+ * independent of order.  Any other model is drawn item by item, in the
+ * order of the item list.
+ */
+
+void item_draw_all(struct s_rend *rend,
+                   const struct v_item *hv, int hc,
+                   const GLfloat *M, float t)
+{
+    const GLfloat s = ITEM_RADIUS;
+
+    int pn[GEOM_MAX] = { 0 };
+    int hi, g;
+
+    /* Gather item positions by batched model. */
+
+    for (hi = 0; hi < hc; hi++)
+    {
+        const struct v_item *hp = hv + hi;
+
+        if (hp->t == ITEM_NONE)
+            continue;
+
+        g = item_geom(hp);
+
+        if (item_batch[g].ordered)
+            continue;
+
+        if (pn[g] == item_pm[g])
+        {
+            int    m = item_pm[g] ? item_pm[g] * 2 : 16;
+            float *v = realloc(item_pv[g], m * 3 * sizeof (float));
+
+            if (!v)
+                continue;
+
+            item_pv[g] = v;
+            item_pm[g] = m;
+        }
+
+        v_cpy(item_pv[g] + pn[g] * 3, hp->p);
+        pn[g]++;
+    }
+
+    for (g = 0; g < GEOM_MAX; g++)
+        sol_draw_batch(&item_batch[g], rend, item_pv[g], pn[g], s, 0, 1);
+
+    /* Draw the remaining items one by one. */
+
+    for (hi = 0; hi < hc; hi++)
+    {
+        const struct v_item *hp = hv + hi;
+
+        if (hp->t == ITEM_NONE || !item_batch[item_geom(hp)].ordered)
+            continue;
+
+        glPushMatrix();
+        {
+            glTranslatef(hp->p[0],
+                         hp->p[1],
+                         hp->p[2]);
+            item_draw(rend, hp, M, t);
+        }
+        glPopMatrix();
+    }
+}
+
 /*---------------------------------------------------------------------------*/
 
 void back_init(const char *name)
@@ -720,22 +811,19 @@ void light_conf(void)
 
 void light_load(void)
 {
-    static char buf[MAXSTR];
-
     int light = -1;
 
-    fs_file fp;
+    fs_lines lr;
+    char *buf;
     float v[4];
     int i;
 
     light_reset();
 
-    if ((fp = fs_open("lights.txt", "r")))
+    if ((lr = fs_lines_open("lights.txt")))
     {
-        while (fs_gets(buf, sizeof (buf), fp))
+        while ((buf = fs_lines_get(lr)))
         {
-            strip_newline(buf);
-
             if      (sscanf(buf, "light %d", &i) == 1)
             {
                 if (i >= 0 && i < LIGHT_MAX)
@@ -768,7 +856,7 @@ void light_load(void)
                     q_cpy(lights[light].s, v);
             }
         }
-        fs_close(fp);
+        fs_lines_close(lr);
     }
 }
 
@@ -32,6 +32,8 @@ void back_draw(struct s_rend *);
 
 void item_color(const struct v_item *, float *);
 void item_draw(struct s_rend *, const struct v_item *, const GLfloat *, float);
+void item_draw_all(struct s_rend *, const struct v_item *, int,
+                   const GLfloat *, float);
 
 /*---------------------------------------------------------------------------*/
 
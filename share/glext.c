@@ -33,6 +33,8 @@ PFNGLBUFFERDATA_PROC             glBufferData_;
 PFNGLBUFFERSUBDATA_PROC          glBufferSubData_;
 PFNGLDELETEBUFFERS_PROC          glDeleteBuffers_;
 PFNGLISBUFFER_PROC               glIsBuffer_;
+PFNGLMAPBUFFER_PROC              glMapBuffer_;
+PFNGLUNMAPBUFFER_PROC            glUnmapBuffer_;
 
 PFNGLPOINTPARAMETERF_PROC        glPointParameterf_;
 PFNGLPOINTPARAMETERFV_PROC       glPointParameterfv_;
@@ -62,6 +64,12 @@ PFNGLGENFRAMEBUFFERS_PROC        glGenFramebuffers_;
 PFNGLFRAMEBUFFERTEXTURE2D_PROC   glFramebufferTexture2D_;
 PFNGLCHECKFRAMEBUFFERSTATUS_PROC glCheckFramebufferStatus_;
 
+PFNGLGENQUERIES_PROC             glGenQueries_;
+PFNGLDELETEQUERIES_PROC          glDeleteQueries_;
+PFNGLBEGINQUERY_PROC             glBeginQuery_;
+PFNGLENDQUERY_PROC               glEndQuery_;
+PFNGLGETQUERYOBJECTUIV_PROC      glGetQueryObjectuiv_;
+
 PFNGLSTRINGMARKERGREMEDY_PROC    glStringMarkerGREMEDY_;
 
 #endif
@@ -155,6 +163,11 @@ int glext_init(void)
         SDL_GL_GFPA(glBufferSubData_,       "glBufferSubDataARB");
         SDL_GL_GFPA(glDeleteBuffers_,       "glDeleteBuffersARB");
         SDL_GL_GFPA(glIsBuffer_,            "glIsBufferARB");
+        SDL_GL_GFPA(glMapBuffer_,           "glMapBufferARB");
+        SDL_GL_GFPA(glUnmapBuffer_,         "glUnmapBufferARB");
+
+        if (glext_check("ARB_pixel_buffer_object"))
+            gli.pixel_buffer_object = 1;
     }
 
     if (glext_assert("ARB_point_parameters"))
@@ -198,6 +211,19 @@ int glext_init(void)
         gli.framebuffer_object = 1;
     }
 
+    if (glext_check("ARB_timer_query") || glext_check("EXT_timer_query"))
+    {
+        SDL_GL_GFPA(glGenQueries_,         "glGenQueries");
+        SDL_GL_GFPA(glDeleteQueries_,      "glDeleteQueries");
+        SDL_GL_GFPA(glBeginQuery_,         "glBeginQuery");
+        SDL_GL_GFPA(glEndQuery_,           "glEndQuery");
+        SDL_GL_GFPA(glGetQueryObjectuiv_,  "glGetQueryObjectuiv");
+
+        if (glGenQueries_ && glDeleteQueries_ && glBeginQuery_ &&
+            glEndQuery_ && glGetQueryObjectuiv_)
+            gli.timer_query = 1;
+    }
+
     if (glext_check("GREMEDY_string_marker"))
         SDL_GL_GFPA(glStringMarkerGREMEDY_, "glStringMarkerGREMEDY");
 
@@ -80,6 +80,15 @@
 #ifndef GL_DYNAMIC_DRAW
 #define GL_DYNAMIC_DRAW               0x88E8
 #endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ                0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY                  0x88B8
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER          0x88EB
+#endif
 
 #ifndef GL_POINT_SPRITE
 #define GL_POINT_SPRITE               0x8861
@@ -151,6 +160,16 @@
 #define GL_INFO_LOG_LENGTH            0x8B84
 #endif
 
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED               0x88BF
+#endif
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT               0x8866
+#endif
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE     0x8867
+#endif
+
 /*---------------------------------------------------------------------------*/
 
 int glext_check(const char *);
@@ -202,6 +221,8 @@ typedef void      (APIENTRYP PFNGLBUFFERDATA_PROC)(GLenum, long, const GLvoid *,
 typedef void      (APIENTRYP PFNGLBUFFERSUBDATA_PROC)(GLenum, long, long, const GLvoid *);
 typedef void      (APIENTRYP PFNGLDELETEBUFFERS_PROC)(GLsizei, const GLuint *);
 typedef GLboolean (APIENTRYP PFNGLISBUFFER_PROC)(GLuint);
+typedef void *    (APIENTRYP PFNGLMAPBUFFER_PROC)(GLenum, GLenum);
+typedef GLboolean (APIENTRYP PFNGLUNMAPBUFFER_PROC)(GLenum);
 
 extern PFNGLGENBUFFERS_PROC    glGenBuffers_;
 extern PFNGLBINDBUFFER_PROC    glBindBuffer_;
@@ -209,6 +230,8 @@ extern PFNGLBUFFERDATA_PROC    glBufferData_;
 extern PFNGLBUFFERSUBDATA_PROC glBufferSubData_;
 extern PFNGLDELETEBUFFERS_PROC glDeleteBuffers_;
 extern PFNGLISBUFFER_PROC      glIsBuffer_;
+extern PFNGLMAPBUFFER_PROC     glMapBuffer_;
+extern PFNGLUNMAPBUFFER_PROC   glUnmapBuffer_;
 
 /*---------------------------------------------------------------------------*/
 /* ARB_point_parameters                                                      */
@@ -275,6 +298,21 @@ extern PFNGLGENFRAMEBUFFERS_PROC        glGenFramebuffers_;
 extern PFNGLFRAMEBUFFERTEXTURE2D_PROC   glFramebufferTexture2D_;
 extern PFNGLCHECKFRAMEBUFFERSTATUS_PROC glCheckFramebufferStatus_;
 
+/*---------------------------------------------------------------------------*/
+/* ARB_timer_query                                                           */
+
+typedef void (APIENTRYP PFNGLGENQUERIES_PROC)(GLsizei, GLuint *);
+typedef void (APIENTRYP PFNGLDELETEQUERIES_PROC)(GLsizei, const GLuint *);
+typedef void (APIENTRYP PFNGLBEGINQUERY_PROC)(GLenum, GLuint);
+typedef void (APIENTRYP PFNGLENDQUERY_PROC)(GLenum);
+typedef void (APIENTRYP PFNGLGETQUERYOBJECTUIV_PROC)(GLuint, GLenum, GLuint *);
+
+extern PFNGLGENQUERIES_PROC        glGenQueries_;
+extern PFNGLDELETEQUERIES_PROC     glDeleteQueries_;
+extern PFNGLBEGINQUERY_PROC        glBeginQuery_;
+extern PFNGLENDQUERY_PROC          glEndQuery_;
+extern PFNGLGETQUERYOBJECTUIV_PROC glGetQueryObjectuiv_;
+
 /*---------------------------------------------------------------------------*/
 /* GREMEDY_string_marker                                                     */
 
@@ -301,6 +339,8 @@ struct gl_info
     unsigned int texture_filter_anisotropic : 1;
     unsigned int shader_objects             : 1;
     unsigned int framebuffer_object         : 1;
+    unsigned int pixel_buffer_object        : 1;
+    unsigned int timer_query                : 1;
 };
 
 extern struct gl_info gli;
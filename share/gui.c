@@ -26,6 +26,7 @@
 #include "common.h"
 #include "font.h"
 #include "theme.h"
+#include "profile.h"
 
 #include "fs.h"
 #include "fs_rwops.h"
@@ -45,7 +46,7 @@ const GLubyte gui_shd[4] = { 0x00, 0x00, 0x00, 0x80 };  /* Shadow */
 
 /*---------------------------------------------------------------------------*/
 
-#define WIDGET_MAX 256
+#define WIDGET_MIN 256
 
 #define GUI_FREE   0
 #define GUI_HARRAY 1
@@ -69,6 +70,13 @@ const GLubyte gui_shd[4] = { 0x00, 0x00, 0x00, 0x80 };  /* Shadow */
 
 /*---------------------------------------------------------------------------*/
 
+struct vert
+{
+    GLubyte c[4];
+    GLfloat u[2];
+    GLfloat p[2];
+};
+
 struct widget
 {
     int     type;
@@ -90,9 +98,14 @@ struct widget
     GLuint  image;
     GLfloat scale;
 
+    char   *text;
     int     text_w;
     int     text_h;
 
+    struct vert *text_v;                /* Glyph quads, shadows first */
+    int          text_n;
+    int          text_serial;
+
     enum trunc trunc;
 };
 
@@ -100,12 +113,13 @@ struct widget
 
 /* GUI widget state */
 
-static struct widget widget[WIDGET_MAX];
-static int           active;
-static int           hovered;
-static int           clicked;
-static int           padding;
-static int           borders[4];
+static struct widget *widget;
+static int            widget_max;
+static int            active;
+static int            hovered;
+static int            clicked;
+static int            padding;
+static int            borders[4];
 
 /* Digit widgets for the HUD. */
 
@@ -120,6 +134,12 @@ static int cursor_st = 0;
 
 static struct theme curr_theme;
 
+/* Loaded fonts. */
+
+#define FONT_MAX 4
+
+static struct font fonts[FONT_MAX];
+
 /*---------------------------------------------------------------------------*/
 
 static int gui_hot(int id)
@@ -142,27 +162,84 @@ static int gui_size(void)
 /* Vertex count */
 
 #define RECT_VERT 16
-#define TEXT_VERT  8
 #define IMAGE_VERT 4
 
-#define WIDGET_VERT (RECT_VERT + MAX(TEXT_VERT, IMAGE_VERT))
+#define WIDGET_VERT (RECT_VERT + IMAGE_VERT)
 
-/* Element count */
+/* Element count, as triangle lists. */
 
-#define RECT_ELEM 28
+#define RECT_ELEM  54
+#define IMAGE_ELEM 6
 
-#define WIDGET_ELEM (RECT_ELEM)
+/* Text vertex count per glyph: two triangles, plus a shadow. */
 
-struct vert
+#define GLYPH_VERT 12
+
+/* Untransformed rectangle and image vertices, WIDGET_VERT per widget. */
+
+static struct vert *vert_buf;
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Widgets are painted in batches. Each gui_paint walks the widget tree
+ * and records one draw per rectangle, image or text label, sorts these
+ * by pass, and writes their transformed vertices into a single stream.
+ * Only the span of the stream that changed since the last paint of the
+ * same root is uploaded, and each run of consecutive draws sharing a
+ * texture becomes a single draw call. Within a pass, draws keep their
+ * tree order, so that overlapping widgets stack as before.
+ */
+
+#define PASS_RECT   0
+#define PASS_TEXT   1
+#define PASS_CURSOR 2
+
+#define BATCH_MAX 16
+
+struct xform
 {
-    GLubyte c[4];
-    GLfloat u[2];
-    GLshort p[2];
+    GLfloat k;                          /* Scale                          */
+    GLfloat x, y;                       /* Translation                    */
+};
+
+struct draw
+{
+    int    pass;
+    GLuint tex;
+    int    seq;                         /* Tree order within a pass       */
+    int    id;
+    int    type;                        /* GUI_IMAGE, GUI_LABEL or 0      */
+
+    struct xform t;
+};
+
+struct run
+{
+    int    pass;
+    GLuint tex;
+    int    first;
+    int    count;
 };
 
-static struct vert vert_buf[WIDGET_MAX * WIDGET_VERT];
-static GLuint      vert_vbo = 0;
-static GLuint      vert_ebo = 0;
+struct batch
+{
+    int          root;                  /* Widget painted from this batch */
+    GLuint       vbo;
+    struct vert *v;                     /* Copy of the VBO contents       */
+    int          vm;                    /* Capacity of both               */
+};
+
+static struct batch batch[BATCH_MAX];
+static int          batch_next;
+
+static struct draw *draw_v;
+static int          draw_c;
+static int          draw_m;
+
+static struct run  *run_v;
+static int          run_c;
+static int          run_m;
 
 /*---------------------------------------------------------------------------*/
 
@@ -175,83 +252,307 @@ static void set_vert(struct vert *v, int x, int y,
     v->c[3] = c[3];
     v->u[0] = s;
     v->u[1] = t;
-    v->p[0] = x;
-    v->p[1] = y;
+    v->p[0] = (GLfloat) x;
+    v->p[1] = (GLfloat) y;
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void draw_enable(GLboolean c, GLboolean u, GLboolean p)
+static void xform_move(struct xform *t, GLfloat x, GLfloat y)
+{
+    t->x += t->k * x;
+    t->y += t->k * y;
+}
+
+static void xform_scale(struct xform *t, GLfloat k)
+{
+    t->k *= k;
+}
+
+static void add_draw(int pass, GLuint tex, int id, int type,
+                     const struct xform *t)
+{
+    if (draw_c == draw_m)
+    {
+        int m = draw_m ? draw_m * 2 : 256;
+        struct draw *v;
+
+        if ((v = realloc(draw_v, m * sizeof (*v))) == NULL)
+            return;
+
+        draw_v = v;
+        draw_m = m;
+    }
+
+    draw_v[draw_c].pass = pass;
+    draw_v[draw_c].tex  = tex;
+    draw_v[draw_c].seq  = draw_c;
+    draw_v[draw_c].id   = id;
+    draw_v[draw_c].type = type;
+    draw_v[draw_c].t    = *t;
+
+    draw_c++;
+}
+
+static void add_run(int pass, GLuint tex, int first, int count)
 {
-    glBindBuffer_(GL_ARRAY_BUFFER,         vert_vbo);
-    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
+    /* Extend the last run if it shares the texture. */
 
-    if (c)
+    if (run_c && run_v[run_c - 1].pass == pass
+              && run_v[run_c - 1].tex  == tex)
     {
-        glEnableClientState(GL_COLOR_ARRAY);
-        glColorPointer   (4, GL_UNSIGNED_BYTE, sizeof (struct vert),
-                                  (GLvoid *) offsetof (struct vert, c));
+        run_v[run_c - 1].count += count;
+        return;
     }
-    if (u)
+
+    if (run_c == run_m)
     {
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-        glTexCoordPointer(2, GL_FLOAT,         sizeof (struct vert),
-                                  (GLvoid *) offsetof (struct vert, u));
+        int m = run_m ? run_m * 2 : 32;
+        struct run *v;
+
+        if ((v = realloc(run_v, m * sizeof (*v))) == NULL)
+            return;
+
+        run_v = v;
+        run_m = m;
     }
-    if (p)
+
+    run_v[run_c].pass  = pass;
+    run_v[run_c].tex   = tex;
+    run_v[run_c].first = first;
+    run_v[run_c].count = count;
+
+    run_c++;
+}
+
+static int cmp_draw(const void *a, const void *b)
+{
+    const struct draw *p = (const struct draw *) a;
+    const struct draw *q = (const struct draw *) b;
+
+    if (p->pass != q->pass) return p->pass < q->pass ? -1 : +1;
+
+    return p->seq - q->seq;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Rectangles are a 3x3 grid of quads. Vertices are arranged
+ * top-to-bottom and left-to-right, two triangles per quad.
+ */
+
+static const GLushort rect_elem[RECT_ELEM] = {
+     0,  1,  4,  4,  1,  5,   1,  2,  5,  5,  2,  6,   2,  3,  6,  6,  3,  7,
+     4,  5,  8,  8,  5,  9,   5,  6,  9,  9,  6, 10,   6,  7, 10, 10,  7, 11,
+     8,  9, 12, 12,  9, 13,   9, 10, 13, 13, 10, 14,  10, 11, 14, 14, 11, 15
+};
+
+static const GLushort image_elem[IMAGE_ELEM] = {
+    0, 1, 2, 2, 1, 3
+};
+
+static const struct vert *draw_vert(const struct draw *dp,
+                                    const GLushort **e, int *n)
+{
+    /* Find the source vertices of a draw, and their indices, if any. */
+
+    const GLushort *f = NULL;
+    const struct vert *v;
+
+    switch (dp->type)
     {
-        glEnableClientState(GL_VERTEX_ARRAY);
-        glVertexPointer  (2, GL_SHORT,         sizeof (struct vert),
-                                  (GLvoid *) offsetof (struct vert, p));
+    case GUI_IMAGE:
+        v  = vert_buf + dp->id * WIDGET_VERT + RECT_VERT;
+        f  = image_elem;
+        *n = IMAGE_ELEM;
+        break;
+
+    case GUI_LABEL:
+        v  = widget[dp->id].text_v;
+        *n = widget[dp->id].text_n;
+        break;
+
+    default:
+        v  = vert_buf + dp->id * WIDGET_VERT;
+        f  = rect_elem;
+        *n = RECT_ELEM;
+        break;
     }
+
+    if (e) *e = f;
+
+    return v;
 }
 
-static void draw_rect(int id)
+static struct batch *get_batch(int root)
 {
-    glDrawElements(GL_TRIANGLE_STRIP, RECT_ELEM, GL_UNSIGNED_SHORT,
-                   (const GLvoid *) (id * WIDGET_ELEM * sizeof (GLushort)));
+    int i;
+
+    for (i = 0; i < BATCH_MAX; i++)
+        if (batch[i].root == root)
+            return batch + i;
+
+    /* Recycle the oldest batch. Its contents are simply overwritten. */
+
+    i = batch_next;
+    batch_next = (batch_next + 1) % BATCH_MAX;
+
+    batch[i].root = root;
+
+    return batch + i;
 }
 
-static void draw_text(int id)
+static int fit_batch(struct batch *bp, int n)
 {
-    glDrawArrays(GL_TRIANGLE_STRIP, id * WIDGET_VERT + RECT_VERT, TEXT_VERT);
+    /* Ensure the batch has room for n vertices. */
+
+    if (n > bp->vm)
+    {
+        int m = bp->vm ? bp->vm : 1024;
+        struct vert *v;
+
+        while (m < n)
+            m *= 2;
+
+        if ((v = realloc(bp->v, m * sizeof (*v))) == NULL)
+            return 0;
+
+        memset(v, 0, m * sizeof (*v));
+
+        bp->v  = v;
+        bp->vm = m;
+
+        if (!bp->vbo)
+            glGenBuffers_(1, &bp->vbo);
+
+        glBindBuffer_(GL_ARRAY_BUFFER, bp->vbo);
+        glBufferData_(GL_ARRAY_BUFFER, m * sizeof (*v), v, GL_DYNAMIC_DRAW);
+        glBindBuffer_(GL_ARRAY_BUFFER, 0);
+    }
+    return 1;
 }
 
-static void draw_image(int id)
+static void fill_batch(struct batch *bp)
 {
-    glDrawArrays(GL_TRIANGLE_STRIP, id * WIDGET_VERT + RECT_VERT, IMAGE_VERT);
+    int i, j, k, n, lo = INT_MAX, hi = 0;
+
+    /* Count the vertices. */
+
+    for (k = 0, i = 0; i < draw_c; i++)
+    {
+        draw_vert(draw_v + i, NULL, &n);
+        k += n;
+    }
+
+    run_c = 0;
+
+    if (!fit_batch(bp, k))
+        return;
+
+    /* Write transformed vertices, noting the span that changed. */
+
+    for (k = 0, i = 0; i < draw_c; i++)
+    {
+        const struct draw *dp = draw_v + i;
+        const GLushort    *e;
+        const struct vert *v = draw_vert(dp, &e, &n);
+
+        for (j = 0; j < n; j++, k++)
+        {
+            struct vert u = e ? v[e[j]] : v[j];
+
+            u.p[0] = dp->t.x + dp->t.k * u.p[0];
+            u.p[1] = dp->t.y + dp->t.k * u.p[1];
+
+            if (memcmp(bp->v + k, &u, sizeof (u)))
+            {
+                bp->v[k] = u;
+
+                if (lo > k)     lo = k;
+                if (hi < k + 1) hi = k + 1;
+            }
+        }
+
+        add_run(dp->pass, dp->tex, k - n, n);
+    }
+
+    /* Upload the changed span. */
+
+    if (lo < hi)
+    {
+        glBindBuffer_   (GL_ARRAY_BUFFER, bp->vbo);
+        glBufferSubData_(GL_ARRAY_BUFFER,
+                         lo * sizeof (struct vert),
+                         (hi - lo) * sizeof (struct vert), bp->v + lo);
+        glBindBuffer_   (GL_ARRAY_BUFFER, 0);
+    }
 }
 
-static void draw_disable(void)
+static void draw_batch(const struct batch *bp)
 {
-    glBindBuffer_(GL_ARRAY_BUFFER,         0);
-    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+    const GLubyte *b = NULL;
+    int i;
+
+    glBindBuffer_(GL_ARRAY_BUFFER, bp->vbo);
+
+    glColorPointer   (4, GL_UNSIGNED_BYTE, sizeof (struct vert),
+                      b + offsetof (struct vert, c));
+    glTexCoordPointer(2, GL_FLOAT,         sizeof (struct vert),
+                      b + offsetof (struct vert, u));
+    glVertexPointer  (2, GL_FLOAT,         sizeof (struct vert),
+                      b + offsetof (struct vert, p));
+
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    for (i = 0; i < run_c; i++)
+    {
+        /* Backgrounds take the current color, everything else its own. */
+
+        if (run_v[i].pass != PASS_RECT)
+            glEnableClientState(GL_COLOR_ARRAY);
+
+        glBindTexture(GL_TEXTURE_2D, run_v[i].tex);
+        glDrawArrays(GL_TRIANGLES, run_v[i].first, run_v[i].count);
+    }
+
+    glBindBuffer_(GL_ARRAY_BUFFER, 0);
 
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
 }
 
-/*---------------------------------------------------------------------------*/
+static void free_batch(void)
+{
+    int i;
 
-/*
- * Generate vertices for a 3x3 rectangle. Vertices are arranged
- * top-to-bottom and left-to-right, triangle strips are arranged
- * left-to-right and top-to-bottom (one strip per row). Degenerate
- * triangles (two extra indices per stitch) are inserted for a
- * continous strip.
- */
+    for (i = 0; i < BATCH_MAX; i++)
+    {
+        if (batch[i].vbo)
+            glDeleteBuffers_(1, &batch[i].vbo);
 
-static const GLushort rect_elem_base[RECT_ELEM] = {
-    0, 1, 4, 5, 8, 9, 12, 13, 13, 1,    /* Top    */
-    1, 2, 5, 6, 9, 10, 13, 14, 14, 2,   /* Middle */
-    2, 3, 6, 7, 10, 11, 14, 15          /* Bottom */
-};
+        free(batch[i].v);
+    }
+    memset(batch, 0, sizeof (batch));
+
+    free(draw_v);
+    free(run_v);
+
+    draw_v = NULL;
+    draw_c = 0;
+    draw_m = 0;
+
+    run_v = NULL;
+    run_c = 0;
+    run_m = 0;
+}
+
+/*---------------------------------------------------------------------------*/
 
 static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
 {
-    GLushort rect_elem[RECT_ELEM];
-
     struct vert *v = vert_buf + id * WIDGET_VERT;
     struct vert *p = v;
 
@@ -260,7 +561,7 @@ static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
 
     int i, j;
 
-    /* Generate vertex and element data for the widget's rectangle. */
+    /* Generate vertex data for the widget's rectangle. */
 
     X[0] = x;
     X[1] = x +     ((f & GUI_W) ? borders[0] : 0);
@@ -275,71 +576,86 @@ static void gui_geom_rect(int id, int x, int y, int w, int h, int f)
     for (i = 0; i < 4; i++)
         for (j = 0; j < 4; j++)
             set_vert(p++, X[i], Y[j], curr_theme.s[i], curr_theme.t[j], gui_wht);
+}
 
-    for (i = 0; i < RECT_ELEM; i++)
-        rect_elem[i] = id * WIDGET_VERT + rect_elem_base[i];
+static void set_glyph(struct vert *v, int x0, int y0, int x1, int y1,
+                      const struct font_quad *qp, const GLubyte *c0,
+                                                  const GLubyte *c1)
+{
+    /* Two triangles, top color c1 and bottom color c0. */
 
-    /* Copy this off to the VBOs. */
+    set_vert(v + 0, x0, y1, qp->s0, qp->t0, c1);
+    set_vert(v + 1, x0, y0, qp->s0, qp->t1, c0);
+    set_vert(v + 2, x1, y1, qp->s1, qp->t0, c1);
+    set_vert(v + 3, x1, y1, qp->s1, qp->t0, c1);
+    set_vert(v + 4, x0, y0, qp->s0, qp->t1, c0);
+    set_vert(v + 5, x1, y0, qp->s1, qp->t1, c0);
+}
 
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     id * WIDGET_VERT * sizeof (struct vert),
-                            RECT_VERT * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
+static void mix_color(GLubyte *c, const GLubyte *c0, const GLubyte *c1,
+                      int k, int n)
+{
+    int i;
 
-    glBindBuffer_   (GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
-    glBufferSubData_(GL_ELEMENT_ARRAY_BUFFER,
-                     id * WIDGET_ELEM * sizeof (GLushort),
-                            RECT_ELEM * sizeof (GLushort), rect_elem);
-    glBindBuffer_   (GL_ELEMENT_ARRAY_BUFFER, 0);
+    for (i = 0; i < 4; i++)
+        c[i] = (GLubyte) (c0[i] + (c1[i] - c0[i]) * k / n);
 }
 
 static void gui_geom_text(int id, int x, int y, int w, int h,
                           const GLubyte *c0, const GLubyte *c1)
 {
-    struct vert *v = vert_buf + id * WIDGET_VERT + RECT_VERT;
+    struct widget *wp = widget + id;
+    struct font   *ft = fonts  + wp->font;
+
+    struct font_quad *qv = NULL;
+
+    int i, n = 0, qc = 0;
 
-    /* Assume the applied texture size is rect size rounded to power-of-two. */
+    /* Lay out the text, caching any new glyphs in the atlas. */
 
-    int W;
-    int H;
+    if (wp->text && w > 0 && h > 0)
+        n = (int) strlen(wp->text);
 
-    image_size(&W, &H, w, h);
+    if (n && (qv = malloc(n * sizeof (*qv))))
+        qc = font_layout(ft, wp->size, wp->text, qv, n);
 
-    if (w > 0 && h > 0 && W > 0 && H > 0)
+    free(wp->text_v);
+
+    wp->text_v      = NULL;
+    wp->text_n      = 0;
+    wp->text_serial = font_atlas(ft, wp->size)->serial;
+
+    if (qc && (wp->text_v = malloc(qc * GLYPH_VERT * sizeof (struct vert))))
     {
         const int d = h / 16;  /* Shadow offset */
 
-        const int ww = ((W - w) % 2) ? w + 1 : w;
-        const int hh = ((H - h) % 2) ? h + 1 : h;
-
-        const GLfloat s0 = 0.5f * (W - ww) / W;
-        const GLfloat t0 = 0.5f * (H - hh) / H;
-        const GLfloat s1 = 1.0f - s0;
-        const GLfloat t1 = 1.0f - t0;
+        struct vert *v = wp->text_v;
+        struct vert *u = wp->text_v + qc * GLYPH_VERT / 2;
 
-        /* Generate vertex data for the colored text and its shadow. */
+        /* Generate vertex data for the glyphs, all shadows first. */
 
-        set_vert(v + 0, x      + d, y + hh - d, s0, t0, gui_shd);
-        set_vert(v + 1, x      + d, y      - d, s0, t1, gui_shd);
-        set_vert(v + 2, x + ww + d, y + hh - d, s1, t0, gui_shd);
-        set_vert(v + 3, x + ww + d, y      - d, s1, t1, gui_shd);
+        for (i = 0; i < qc; i++)
+        {
+            const struct font_quad *qp = qv + i;
 
-        set_vert(v + 4, x,          y + hh,     s0, t0, c1);
-        set_vert(v + 5, x,          y,          s0, t1, c0);
-        set_vert(v + 6, x + ww,     y + hh,     s1, t0, c1);
-        set_vert(v + 7, x + ww,     y,          s1, t1, c0);
+            const int x0 = x +     (int) qp->x0;
+            const int x1 = x +     (int) qp->x1;
+            const int y0 = y + h - (int) qp->y1;
+            const int y1 = y + h - (int) qp->y0;
 
-    }
-    else memset(v, 0, TEXT_VERT * sizeof (struct vert));
+            GLubyte b[4];
+            GLubyte t[4];
 
-    /* Copy this off to the VBO. */
+            mix_color(b, c0, c1, y0 - y, h);
+            mix_color(t, c0, c1, y1 - y, h);
 
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     (id * WIDGET_VERT + RECT_VERT) * sizeof (struct vert),
-                                         TEXT_VERT  * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
+            set_glyph(v + i * 6, x0 + d, y0 - d, x1 + d, y1 - d, qp,
+                      gui_shd, gui_shd);
+            set_glyph(u + i * 6, x0, y0, x1, y1, qp, b, t);
+        }
+        wp->text_n = qc * GLYPH_VERT;
+    }
+    free(qv);
 }
 
 static void gui_geom_image(int id, int x, int y, int w, int h, int f)
@@ -361,14 +677,6 @@ static void gui_geom_image(int id, int x, int y, int w, int h, int f)
     set_vert(v + 1, X[0], Y[1], 0.0f, 0.0f, gui_wht);
     set_vert(v + 2, X[1], Y[0], 1.0f, 1.0f, gui_wht);
     set_vert(v + 3, X[1], Y[1], 1.0f, 0.0f, gui_wht);
-
-    /* Copy this off to the VBO. */
-
-    glBindBuffer_   (GL_ARRAY_BUFFER, vert_vbo);
-    glBufferSubData_(GL_ARRAY_BUFFER,
-                     (id * WIDGET_VERT + RECT_VERT) * sizeof (struct vert),
-                     IMAGE_VERT * sizeof (struct vert), v);
-    glBindBuffer_   (GL_ARRAY_BUFFER, 0);
 }
 
 static void gui_geom_widget(int id, int flags)
@@ -419,10 +727,7 @@ static void gui_geom_widget(int id, int flags)
 
 /*---------------------------------------------------------------------------*/
 
-#define FONT_MAX 4
-
-static struct font fonts[FONT_MAX];
-static int         fontc;
+static int fontc;
 
 static int font_sizes[3];
 
@@ -500,13 +805,50 @@ static void gui_theme_init(void)
 
 /*---------------------------------------------------------------------------*/
 
+static int gui_grow(void)
+{
+    int m = widget_max ? widget_max * 2 : WIDGET_MIN;
+
+    struct widget *w;
+    struct vert   *v;
+
+    /* Double the widget table and its vertex storage. */
+
+    if ((w = realloc(widget, m * sizeof (*w))) == NULL)
+        return 0;
+
+    widget = w;
+
+    if ((v = realloc(vert_buf, m * sizeof (*v) * WIDGET_VERT)) == NULL)
+        return 0;
+
+    vert_buf = v;
+
+    memset(widget   + widget_max, 0,
+           (m - widget_max) * sizeof (*w));
+    memset(vert_buf + widget_max * WIDGET_VERT, 0,
+           (m - widget_max) * sizeof (*v) * WIDGET_VERT);
+
+    widget_max = m;
+
+    return 1;
+}
+
 void gui_init(void)
 {
     const int s = gui_size();
 
     int i, j;
 
-    memset(widget, 0, sizeof (struct widget) * WIDGET_MAX);
+    /* Allocate the widget table, or clear the one we already have. */
+
+    if (widget_max)
+    {
+        memset(widget,   0, widget_max * sizeof (struct widget));
+        memset(vert_buf, 0, widget_max * sizeof (struct vert) * WIDGET_VERT);
+    }
+    else
+        gui_grow();
 
     /* Compute default widget/text padding. */
 
@@ -517,27 +859,15 @@ void gui_init(void)
 
     /* Initialize font rendering. */
 
+    profile_begin("fonts", NULL);
     gui_font_init();
+    profile_end();
 
     /* Initialize GUI theme. */
 
+    profile_begin("theme", NULL);
     gui_theme_init();
-
-    /* Initialize the VBOs. */
-
-    memset(vert_buf, 0, sizeof (vert_buf));
-
-    glGenBuffers_(1,              &vert_vbo);
-    glBindBuffer_(GL_ARRAY_BUFFER, vert_vbo);
-    glBufferData_(GL_ARRAY_BUFFER, sizeof (vert_buf), vert_buf, GL_STATIC_DRAW);
-    glBindBuffer_(GL_ARRAY_BUFFER, 0);
-
-    glGenBuffers_(1,                      &vert_ebo);
-    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, vert_ebo);
-    glBufferData_(GL_ELEMENT_ARRAY_BUFFER,
-                  WIDGET_MAX * WIDGET_ELEM * sizeof (GLushort),
-                  NULL, GL_STATIC_DRAW);
-    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+    profile_end();
 
     /* Cache digit glyphs for HUD rendering. */
 
@@ -573,23 +903,31 @@ void gui_free(void)
 {
     int id;
 
-    /* Release the VBOs. */
+    /* Release the batch VBOs. */
 
-    glDeleteBuffers_(1, &vert_vbo);
-    glDeleteBuffers_(1, &vert_ebo);
+    free_batch();
 
     /* Release any remaining widget texture and display list indices. */
 
-    for (id = 1; id < WIDGET_MAX; id++)
+    for (id = 1; id < widget_max; id++)
     {
         if (widget[id].image)
+        {
+            image_cancel(widget[id].image);
             glDeleteTextures(1, &widget[id].image);
+        }
 
-        widget[id].type  = GUI_FREE;
-        widget[id].flags = 0;
-        widget[id].image = 0;
-        widget[id].cdr   = 0;
-        widget[id].car   = 0;
+        free(widget[id].text);
+        free(widget[id].text_v);
+
+        widget[id].type   = GUI_FREE;
+        widget[id].flags  = 0;
+        widget[id].image  = 0;
+        widget[id].text   = NULL;
+        widget[id].text_v = NULL;
+        widget[id].text_n = 0;
+        widget[id].cdr    = 0;
+        widget[id].car    = 0;
     }
 
     /* Release all loaded fonts and finalize font rendering. */
@@ -607,9 +945,9 @@ static int gui_widget(int pd, int type)
 {
     int id;
 
-    /* Find an unused entry in the widget table. */
+    /* Find an unused entry in the widget table, growing it if full. */
 
-    for (id = 1; id < WIDGET_MAX; id++)
+    for (id = 1; id < widget_max || gui_grow(); id++)
         if (widget[id].type == GUI_FREE)
         {
             /* Set the type and default properties. */
@@ -628,8 +966,11 @@ static int gui_widget(int pd, int type)
             widget[id].color1 = gui_wht;
             widget[id].scale  = 1.0f;
             widget[id].trunc  = TRUNC_NONE;
+            widget[id].text   = NULL;
             widget[id].text_w = 0;
             widget[id].text_h = 0;
+            widget[id].text_v = NULL;
+            widget[id].text_n = 0;
 
             /* Insert the new widget into the parent's widget list. */
 
@@ -762,9 +1103,33 @@ static char *gui_truncate(const char *text,
 
 void gui_set_image(int id, const char *file)
 {
+    image_cancel(widget[id].image);
     glDeleteTextures(1, &widget[id].image);
 
-    widget[id].image = make_image_from_file(file, IF_MIPMAP);
+    widget[id].image = make_image_async(file, IF_MIPMAP);
+}
+
+/*
+ * Give a widget its text, taking ownership of the string, and measure
+ * it.  Glyphs come from the font atlas, so nothing is rasterized here.
+ */
+static void gui_text(int id, char *str)
+{
+    struct size size = { 0, 0 };
+
+    free(widget[id].text);
+
+    widget[id].text = str;
+
+    if (str && *str)
+    {
+        TTF_Font *ttf = fonts[widget[id].font].ttf[widget[id].size];
+
+        size = gui_measure_ttf(str, ttf);
+    }
+
+    widget[id].text_w = size.w;
+    widget[id].text_h = size.h;
 }
 
 void gui_set_label(int id, const char *text)
@@ -774,24 +1139,15 @@ void gui_set_label(int id, const char *text)
     int w = 0;
     int h = 0;
 
-    char *str;
+    gui_text(id, gui_truncate(text, widget[id].w - padding, ttf,
+                              widget[id].trunc));
 
-    glDeleteTextures(1, &widget[id].image);
-
-    str = gui_truncate(text, widget[id].w - padding, ttf, widget[id].trunc);
-
-    widget[id].image = make_image_from_font(NULL, NULL,
-                                            &widget[id].text_w,
-                                            &widget[id].text_h,
-                                            str, ttf, 0);
     w = widget[id].text_w;
     h = widget[id].text_h;
 
     gui_geom_text(id, -w / 2, -h / 2, w, h,
                   widget[id].color0,
                   widget[id].color1);
-
-    free(str);
 }
 
 void gui_set_count(int id, int value)
@@ -910,7 +1266,7 @@ int gui_image(int pd, const char *file, int w, int h)
 
     if ((id = gui_widget(pd, GUI_IMAGE)))
     {
-        widget[id].image  = make_image_from_file(file, IF_MIPMAP);
+        widget[id].image  = make_image_async(file, IF_MIPMAP);
         widget[id].w      = w;
         widget[id].h      = h;
         widget[id].flags |= GUI_RECT;
@@ -934,17 +1290,13 @@ int gui_state(int pd, const char *text, int size, int token, int value)
 
     if ((id = gui_widget(pd, GUI_BUTTON)))
     {
-        TTF_Font *ttf = fonts[widget[id].font].ttf[size];
-
         widget[id].flags |= (GUI_STATE | GUI_RECT);
+        widget[id].size   = size;
+
+        gui_text(id, text ? strdup(text) : NULL);
 
-        widget[id].image = make_image_from_font(NULL, NULL,
-                                                &widget[id].text_w,
-                                                &widget[id].text_h,
-                                                text, ttf, 0);
         widget[id].w     = widget[id].text_w;
         widget[id].h     = widget[id].text_h;
-        widget[id].size  = size;
         widget[id].token = token;
         widget[id].value = value;
     }
@@ -958,15 +1310,12 @@ int gui_label(int pd, const char *text, int size, const GLubyte *c0,
 
     if ((id = gui_widget(pd, GUI_LABEL)))
     {
-        TTF_Font *ttf = fonts[widget[id].font].ttf[size];
+        widget[id].size   = size;
+
+        gui_text(id, text ? strdup(text) : NULL);
 
-        widget[id].image = make_image_from_font(NULL, NULL,
-                                                &widget[id].text_w,
-                                                &widget[id].text_h,
-                                                text, ttf, 0);
         widget[id].w      = widget[id].text_w;
         widget[id].h      = widget[id].text_h;
-        widget[id].size   = size;
         widget[id].color0 = c0 ? c0 : gui_yel;
         widget[id].color1 = c1 ? c1 : gui_red;
         widget[id].flags |= GUI_RECT;
@@ -1428,15 +1777,24 @@ int gui_delete(int id)
         /* Release any GL resources held by this widget. */
 
         if (widget[id].image)
+        {
+            image_cancel(widget[id].image);
             glDeleteTextures(1, &widget[id].image);
+        }
+
+        free(widget[id].text);
+        free(widget[id].text_v);
 
         /* Mark this widget unused. */
 
-        widget[id].type  = GUI_FREE;
-        widget[id].flags = 0;
-        widget[id].image = 0;
-        widget[id].cdr   = 0;
-        widget[id].car   = 0;
+        widget[id].type   = GUI_FREE;
+        widget[id].flags  = 0;
+        widget[id].image  = 0;
+        widget[id].text   = NULL;
+        widget[id].text_v = NULL;
+        widget[id].text_n = 0;
+        widget[id].cdr    = 0;
+        widget[id].car    = 0;
 
         /* Clear focus from this widget. */
 
@@ -1461,15 +1819,12 @@ static void gui_paint_rect(int id, int st, int flags)
     {
         /* Draw a leaf's background, colored by widget state. */
 
-        glPushMatrix();
-        {
-            glTranslatef((GLfloat) (widget[id].x + widget[id].w / 2),
-                         (GLfloat) (widget[id].y + widget[id].h / 2), 0.f);
+        struct xform t = { 1.0f, 0.0f, 0.0f };
 
-            glBindTexture(GL_TEXTURE_2D, curr_theme.tex[i]);
-            draw_rect(id);
-        }
-        glPopMatrix();
+        xform_move(&t, (GLfloat) (widget[id].x + widget[id].w / 2),
+                       (GLfloat) (widget[id].y + widget[id].h / 2));
+
+        add_draw(PASS_RECT, curr_theme.tex[i], id, 0, &t);
 
         flags |= GUI_RECT;
     }
@@ -1492,103 +1847,108 @@ static void gui_paint_rect(int id, int st, int flags)
 
 /*---------------------------------------------------------------------------*/
 
-static void gui_paint_text(int id);
-
-static void gui_paint_array(int id)
+static void gui_paint_glyphs(int id, const struct xform *t)
 {
-    int jd;
+    const struct atlas *ap = font_atlas(&fonts[widget[id].font],
+                                        widget[id].size);
 
-    glPushMatrix();
-    {
-        GLfloat cx = widget[id].x + widget[id].w / 2.0f;
-        GLfloat cy = widget[id].y + widget[id].h / 2.0f;
-        GLfloat ck = widget[id].scale;
-
-        if (1.0f < ck || ck < 1.0f)
-        {
-            glTranslatef(+cx, +cy, 0.0f);
-            glScalef(ck, ck, ck);
-            glTranslatef(-cx, -cy, 0.0f);
-        }
+    /* Regenerate glyph texture coordinates if the atlas was resized. */
 
-        /* Recursively paint all subwidgets. */
+    if (widget[id].text_serial != ap->serial)
+    {
+        int w = widget[id].text_w;
+        int h = widget[id].text_h;
 
-        for (jd = widget[id].car; jd; jd = widget[jd].cdr)
-            gui_paint_text(jd);
+        gui_geom_text(id, -w / 2, -h / 2, w, h,
+                      widget[id].color0,
+                      widget[id].color1);
     }
-    glPopMatrix();
+
+    if (widget[id].text_n)
+        add_draw(PASS_TEXT, ap->tex, id, GUI_LABEL, t);
 }
 
-static void gui_paint_image(int id)
+static void gui_paint_text(int id, const struct xform *);
+
+static void gui_paint_array(int id, const struct xform *p)
 {
-    /* Draw the widget rect, textured using the image. */
+    struct xform t = *p;
+    int jd;
 
-    glPushMatrix();
+    GLfloat cx = widget[id].x + widget[id].w / 2.0f;
+    GLfloat cy = widget[id].y + widget[id].h / 2.0f;
+    GLfloat ck = widget[id].scale;
+
+    if (1.0f < ck || ck < 1.0f)
     {
-        glTranslatef((GLfloat) (widget[id].x + widget[id].w / 2),
-                     (GLfloat) (widget[id].y + widget[id].h / 2), 0.f);
+        xform_move (&t, +cx, +cy);
+        xform_scale(&t, ck);
+        xform_move (&t, -cx, -cy);
+    }
 
-        glScalef(widget[id].scale,
-                 widget[id].scale,
-                 widget[id].scale);
+    /* Recursively paint all subwidgets. */
 
-        glBindTexture(GL_TEXTURE_2D, widget[id].image);
-        glColor4ub(gui_wht[0], gui_wht[1], gui_wht[2], gui_wht[3]);
-        draw_image(id);
-    }
-    glPopMatrix();
+    for (jd = widget[id].car; jd; jd = widget[jd].cdr)
+        gui_paint_text(jd, &t);
 }
 
-static void gui_paint_count(int id)
+static void gui_paint_image(int id, const struct xform *p, int pass)
 {
-    int j, i = widget[id].size;
+    struct xform t = *p;
 
-    glPushMatrix();
-    {
-        /* Translate to the widget center, and apply the pulse scale. */
+    /* Draw the widget rect, textured using the image. */
 
-        glTranslatef((GLfloat) (widget[id].x + widget[id].w / 2),
-                     (GLfloat) (widget[id].y + widget[id].h / 2), 0.f);
+    xform_move (&t, (GLfloat) (widget[id].x + widget[id].w / 2),
+                    (GLfloat) (widget[id].y + widget[id].h / 2));
+    xform_scale(&t, widget[id].scale);
 
-        glScalef(widget[id].scale,
-                 widget[id].scale,
-                 widget[id].scale);
+    add_draw(pass, widget[id].image, id, GUI_IMAGE, &t);
+}
 
-        if (widget[id].value > 0)
-        {
-            /* Translate right by half the total width of the rendered value. */
+static void gui_paint_count(int id, const struct xform *p)
+{
+    struct xform t = *p;
+    int j, i = widget[id].size;
 
-            GLfloat w = -widget[digit_id[i][0]].text_w * 0.5f;
+    /* Translate to the widget center, and apply the pulse scale. */
 
-            for (j = widget[id].value; j; j /= 10)
-                w += widget[digit_id[i][j % 10]].text_w * 0.5f;
+    xform_move (&t, (GLfloat) (widget[id].x + widget[id].w / 2),
+                    (GLfloat) (widget[id].y + widget[id].h / 2));
+    xform_scale(&t, widget[id].scale);
 
-            glTranslatef(w, 0.0f, 0.0f);
+    if (widget[id].value > 0)
+    {
+        /* Translate right by half the total width of the rendered value. */
 
-            /* Render each digit, moving left after each. */
+        GLfloat w = -widget[digit_id[i][0]].text_w * 0.5f;
 
-            for (j = widget[id].value; j; j /= 10)
-            {
-                int jd = digit_id[i][j % 10];
+        for (j = widget[id].value; j; j /= 10)
+            w += widget[digit_id[i][j % 10]].text_w * 0.5f;
 
-                glBindTexture(GL_TEXTURE_2D, widget[jd].image);
-                draw_text(jd);
-                glTranslatef((GLfloat) -widget[jd].text_w, 0.0f, 0.0f);
-            }
-        }
-        else if (widget[id].value == 0)
+        xform_move(&t, w, 0.0f);
+
+        /* Render each digit, moving left after each. */
+
+        for (j = widget[id].value; j; j /= 10)
         {
-            /* If the value is zero, just display a zero in place. */
+            int jd = digit_id[i][j % 10];
 
-            glBindTexture(GL_TEXTURE_2D, widget[digit_id[i][0]].image);
-            draw_text(digit_id[i][0]);
+            gui_paint_glyphs(jd, &t);
+            xform_move(&t, (GLfloat) -widget[jd].text_w, 0.0f);
         }
     }
-    glPopMatrix();
+    else if (widget[id].value == 0)
+    {
+        /* If the value is zero, just display a zero in place. */
+
+        gui_paint_glyphs(digit_id[i][0], &t);
+    }
 }
 
-static void gui_paint_clock(int id)
+static void gui_paint_clock(int id, const struct xform *p)
 {
+    struct xform t = *p;
+
     int i  =   widget[id].size;
     int mt =  (widget[id].value / 6000) / 10;
     int mo =  (widget[id].value / 6000) % 10;
@@ -1603,105 +1963,85 @@ static void gui_paint_clock(int id)
     if (widget[id].value < 0)
         return;
 
-    glPushMatrix();
-    {
-        /* Translate to the widget center, and apply the pulse scale. */
-
-        glTranslatef((GLfloat) (widget[id].x + widget[id].w / 2),
-                     (GLfloat) (widget[id].y + widget[id].h / 2), 0.f);
+    /* Translate to the widget center, and apply the pulse scale. */
 
-        glScalef(widget[id].scale,
-                 widget[id].scale,
-                 widget[id].scale);
+    xform_move (&t, (GLfloat) (widget[id].x + widget[id].w / 2),
+                    (GLfloat) (widget[id].y + widget[id].h / 2));
+    xform_scale(&t, widget[id].scale);
 
-        /* Translate left by half the total width of the rendered value. */
+    /* Translate left by half the total width of the rendered value. */
 
-        if (mt > 0)
-            glTranslatef(-2.25f * dx_large, 0.0f, 0.0f);
-        else
-            glTranslatef(-1.75f * dx_large, 0.0f, 0.0f);
+    if (mt > 0)
+        xform_move(&t, -2.25f * dx_large, 0.0f);
+    else
+        xform_move(&t, -1.75f * dx_large, 0.0f);
 
-        /* Render the minutes counter. */
+    /* Render the minutes counter. */
 
-        if (mt > 0)
-        {
-            glBindTexture(GL_TEXTURE_2D, widget[digit_id[i][mt]].image);
-            draw_text(digit_id[i][mt]);
-            glTranslatef(dx_large, 0.0f, 0.0f);
-        }
+    if (mt > 0)
+    {
+        gui_paint_glyphs(digit_id[i][mt], &t);
+        xform_move(&t, dx_large, 0.0f);
+    }
 
-        glBindTexture(GL_TEXTURE_2D, widget[digit_id[i][mo]].image);
-        draw_text(digit_id[i][mo]);
-        glTranslatef(dx_small, 0.0f, 0.0f);
+    gui_paint_glyphs(digit_id[i][mo], &t);
+    xform_move(&t, dx_small, 0.0f);
 
-        /* Render the colon. */
+    /* Render the colon. */
 
-        glBindTexture(GL_TEXTURE_2D, widget[digit_id[i][10]].image);
-        draw_text(digit_id[i][10]);
-        glTranslatef(dx_small, 0.0f, 0.0f);
+    gui_paint_glyphs(digit_id[i][10], &t);
+    xform_move(&t, dx_small, 0.0f);
 
-        /* Render the seconds counter. */
+    /* Render the seconds counter. */
 
-        glBindTexture(GL_TEXTURE_2D, widget[digit_id[i][st]].image);
-        draw_text(digit_id[i][st]);
-        glTranslatef(dx_large, 0.0f, 0.0f);
+    gui_paint_glyphs(digit_id[i][st], &t);
+    xform_move(&t, dx_large, 0.0f);
 
-        glBindTexture(GL_TEXTURE_2D, widget[digit_id[i][so]].image);
-        draw_text(digit_id[i][so]);
-        glTranslatef(dx_small, 0.0f, 0.0f);
+    gui_paint_glyphs(digit_id[i][so], &t);
+    xform_move(&t, dx_small, 0.0f);
 
-        /* Render hundredths counter half size. */
+    /* Render hundredths counter half size. */
 
-        glScalef(0.5f, 0.5f, 1.0f);
+    xform_scale(&t, 0.5f);
 
-        glBindTexture(GL_TEXTURE_2D, widget[digit_id[i][ht]].image);
-        draw_text(digit_id[i][ht]);
-        glTranslatef(dx_large, 0.0f, 0.0f);
+    gui_paint_glyphs(digit_id[i][ht], &t);
+    xform_move(&t, dx_large, 0.0f);
 
-        glBindTexture(GL_TEXTURE_2D, widget[digit_id[i][ho]].image);
-        draw_text(digit_id[i][ho]);
-    }
-    glPopMatrix();
+    gui_paint_glyphs(digit_id[i][ho], &t);
 }
 
-static void gui_paint_label(int id)
+static void gui_paint_label(int id, const struct xform *p)
 {
+    struct xform t = *p;
+
     /* Short-circuit empty labels. */
 
-    if (widget[id].image == 0)
+    if (widget[id].text_n == 0)
         return;
 
-    /* Draw the widget text box, textured using the glyph. */
+    /* Draw the widget text box, textured using the glyph atlas. */
 
-    glPushMatrix();
-    {
-        glTranslatef((GLfloat) (widget[id].x + widget[id].w / 2),
-                     (GLfloat) (widget[id].y + widget[id].h / 2), 0.f);
+    xform_move (&t, (GLfloat) (widget[id].x + widget[id].w / 2),
+                    (GLfloat) (widget[id].y + widget[id].h / 2));
+    xform_scale(&t, widget[id].scale);
 
-        glScalef(widget[id].scale,
-                 widget[id].scale,
-                 widget[id].scale);
-
-        glBindTexture(GL_TEXTURE_2D, widget[id].image);
-        draw_text(id);
-    }
-    glPopMatrix();
+    gui_paint_glyphs(id, &t);
 }
 
-static void gui_paint_text(int id)
+static void gui_paint_text(int id, const struct xform *t)
 {
     switch (widget[id].type)
     {
     case GUI_SPACE:  break;
     case GUI_FILLER: break;
-    case GUI_HARRAY: gui_paint_array(id); break;
-    case GUI_VARRAY: gui_paint_array(id); break;
-    case GUI_HSTACK: gui_paint_array(id); break;
-    case GUI_VSTACK: gui_paint_array(id); break;
-    case GUI_IMAGE:  gui_paint_image(id); break;
-    case GUI_COUNT:  gui_paint_count(id); break;
-    case GUI_CLOCK:  gui_paint_clock(id); break;
-    default:         gui_paint_label(id); break;
+    case GUI_HARRAY: gui_paint_array(id, t); break;
+    case GUI_VARRAY: gui_paint_array(id, t); break;
+    case GUI_HSTACK: gui_paint_array(id, t); break;
+    case GUI_VSTACK: gui_paint_array(id, t); break;
+    case GUI_IMAGE:  gui_paint_image(id, t, PASS_TEXT); break;
+    case GUI_COUNT:  gui_paint_count(id, t); break;
+    case GUI_CLOCK:  gui_paint_clock(id, t); break;
+    default:         gui_paint_label(id, t); break;
     }
 }
 
@@ -1709,27 +2049,41 @@ void gui_paint(int id)
 {
     if (id)
     {
+        const struct xform t = { 1.0f, 0.0f, 0.0f };
+
+        struct batch *bp = get_batch(id);
+
+        profile_phase_begin(PHASE_GUI);
+
+        /* Gather, sort, and upload this frame's draws. */
+
+        draw_c = 0;
+
+        gui_paint_rect(id, 0, 0);
+        gui_paint_text(id, &t);
+
+        if (cursor_st && cursor_id)
+            gui_paint_image(cursor_id, &t, PASS_CURSOR);
+
+        if (draw_c)
+            qsort(draw_v, draw_c, sizeof (struct draw), cmp_draw);
+
+        fill_batch(bp);
+
         video_push_ortho();
         {
             glDisable(GL_LIGHTING);
             glDisable(GL_DEPTH_TEST);
             {
-                draw_enable(GL_FALSE, GL_TRUE, GL_TRUE);
-                gui_paint_rect(id, 0, 0);
-
-                draw_enable(GL_TRUE, GL_TRUE, GL_TRUE);
-                gui_paint_text(id);
-
-                if (cursor_st && cursor_id)
-                    gui_paint_image(cursor_id);
-
-                draw_disable();
+                draw_batch(bp);
                 glColor4ub(gui_wht[0], gui_wht[1], gui_wht[2], gui_wht[3]);
             }
             glEnable(GL_DEPTH_TEST);
             glEnable(GL_LIGHTING);
         }
         video_pop_matrix();
+
+        profile_phase_end();
     }
 }
 
@@ -24,33 +24,84 @@
 #include "base_image.h"
 #include "config.h"
 #include "video.h"
+#include "common.h"
+#include "binary.h"
+#include "log.h"
 
 #include "fs.h"
 #include "fs_png.h"
 
 /*---------------------------------------------------------------------------*/
 
-void image_snap(const char *filename)
+/*
+ * Screenshots.
+ *
+ * The frame is read back into one of a small ring of pixel buffer
+ * objects and copied out once it has aged a full ring of frames, when
+ * the GPU is done with it.
+ * A writer thread then does the PNG encoding, so that a run of captures
+ * doesn't stall rendering. Without PBOs the read back is immediate, but
+ * encoding is still deferred.
+ */
+
+#define SNAP_BUFFERS 2
+#define SNAP_QUEUE   8
+
+struct image_shot
+{
+    struct image_shot *next;
+
+    unsigned char *p;                   /* RGBA pixels, bottom row first  */
+    int            w, h;
+
+    char path[MAXSTR];
+};
+
+struct snap_buffer
+{
+    GLuint             o;               /* Pixel buffer object            */
+    struct image_shot *sp;              /* Pending read back, if any      */
+    int                age;             /* Frames since the read back     */
+};
+
+static struct snap_buffer snap_buffer[SNAP_BUFFERS];
+static int                snap_next;
+
+static struct image_shot *snap_head;
+static struct image_shot *snap_tail;
+static int                snap_count;
+
+static SDL_mutex  *snap_mutex;
+static SDL_cond   *snap_cond;
+static SDL_Thread *snap_thread;
+static int         snap_running;
+
+static void write_shot(const struct image_shot *sp)
 {
     fs_file     filep  = NULL;
     png_structp writep = NULL;
     png_infop   infop  = NULL;
     png_bytep  *bytep  = NULL;
 
-    int w = video.device_w;
-    int h = video.device_h;
+    int w = sp->w;
+    int h = sp->h;
     int i;
 
-    unsigned char *p = NULL;
-
     /* Initialize all PNG export data structures. */
 
-    if (!(filep = fs_open(filename, "w")))
+    if (!(filep = fs_open(sp->path, "w")))
         return;
     if (!(writep = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0)))
+    {
+        fs_close(filep);
         return;
+    }
     if (!(infop = png_create_info_struct(writep)))
+    {
+        png_destroy_write_struct(&writep, NULL);
+        fs_close(filep);
         return;
+    }
 
     /* Enable the default PNG error handler. */
 
@@ -65,29 +116,21 @@ void image_snap(const char *filename)
                      PNG_COMPRESSION_TYPE_DEFAULT,
                      PNG_FILTER_TYPE_DEFAULT);
 
-        /* Allocate the pixel buffer and copy pixels there. */
+        /* Allocate and initialize the row pointers. */
 
-        if ((p = (unsigned char *) malloc(w * h * 4)))
+        if ((bytep = (png_bytep *) png_malloc(writep, h * sizeof (png_bytep))))
         {
-            glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, p);
-
-            /* Allocate and initialize the row pointers. */
-
-            if ((bytep = (png_bytep *) png_malloc(writep, h * sizeof (png_bytep))))
-            {
-                for (i = 0; i < h; ++i)
-                    bytep[h - i - 1] = (png_bytep) (p + i * w * 4);
+            for (i = 0; i < h; ++i)
+                bytep[h - i - 1] = (png_bytep) (sp->p + i * w * 4);
 
-                /* Write the PNG image file. */
+            /* Write the PNG image file. */
 
-                png_write_info(writep, infop);
-                png_set_filler(writep, 0, PNG_FILLER_AFTER);
-                png_write_image(writep, bytep);
-                png_write_end(writep, infop);
+            png_write_info(writep, infop);
+            png_set_filler(writep, 0, PNG_FILLER_AFTER);
+            png_write_image(writep, bytep);
+            png_write_end(writep, infop);
 
-                free(bytep);
-            }
-            free(p);
+            png_free(writep, bytep);
         }
     }
 
@@ -97,95 +140,1171 @@ void image_snap(const char *filename)
     fs_close(filep);
 }
 
-/*---------------------------------------------------------------------------*/
+static void free_shot(struct image_shot *sp)
+{
+    free(sp->p);
+    free(sp);
+}
+
+static int snap_work(void *data)
+{
+    struct image_shot *sp;
+
+    SDL_mutexP(snap_mutex);
+
+    for (;;)
+    {
+        if ((sp = snap_head))
+        {
+            if (!(snap_head = sp->next))
+                snap_tail = NULL;
+
+            snap_count--;
+            SDL_CondBroadcast(snap_cond);
+
+            SDL_mutexV(snap_mutex);
+            write_shot(sp);
+            free_shot(sp);
+            SDL_mutexP(snap_mutex);
+        }
+        else if (snap_running)
+            SDL_CondWait(snap_cond, snap_mutex);
+        else
+            break;
+    }
+
+    SDL_mutexV(snap_mutex);
+
+    return 0;
+}
+
+static int snap_start(void)
+{
+    if (snap_thread)
+        return 1;
+
+    if ((snap_mutex = SDL_CreateMutex()) && (snap_cond = SDL_CreateCond()))
+    {
+        snap_running = 1;
+
+        if ((snap_thread = SDL_CreateThread(snap_work, "snap", NULL)))
+            return 1;
+    }
+
+    if (snap_cond)  SDL_DestroyCond (snap_cond);
+    if (snap_mutex) SDL_DestroyMutex(snap_mutex);
+
+    snap_cond    = NULL;
+    snap_mutex   = NULL;
+    snap_running = 0;
+
+    return 0;
+}
 
 /*
- * Create an OpenGL texture object using the given image buffer.
+ * Wait for the writer to finish all queued screenshots, and stop it.
  */
-GLuint make_texture(const void *p, int w, int h, int b, int fl)
+static void snap_stop(void)
 {
-    static const GLenum format[] =
-        { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
+    if (snap_thread)
+    {
+        SDL_mutexP(snap_mutex);
+        snap_running = 0;
+        SDL_CondBroadcast(snap_cond);
+        SDL_mutexV(snap_mutex);
 
-    GLuint o = 0;
+        SDL_WaitThread(snap_thread, NULL);
 
-    /* Scale the image as configured, or to fit the OpenGL limitations. */
+        SDL_DestroyCond (snap_cond);
+        SDL_DestroyMutex(snap_mutex);
 
-#ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
-    int a = config_get_d(CONFIG_ANISO);
+        snap_thread = NULL;
+        snap_cond   = NULL;
+        snap_mutex  = NULL;
+    }
+}
+
+/*
+ * Hand a screenshot to the writer, waiting if it has fallen too far
+ * behind. Without a writer thread, write it right away.
+ */
+static void queue_shot(struct image_shot *sp)
+{
+    if (!snap_start())
+    {
+        write_shot(sp);
+        free_shot(sp);
+        return;
+    }
+
+    SDL_mutexP(snap_mutex);
+    {
+        while (snap_count >= SNAP_QUEUE)
+            SDL_CondWait(snap_cond, snap_mutex);
+
+        if (snap_tail)
+            snap_tail->next = sp;
+        else
+            snap_head = sp;
+
+        snap_tail = sp;
+        snap_count++;
+
+        SDL_CondBroadcast(snap_cond);
+    }
+    SDL_mutexV(snap_mutex);
+}
+
+#if !ENABLE_OPENGLES
+/*
+ * Copy a finished read back out of its pixel buffer and queue it.
+ */
+static void retire_buffer(struct snap_buffer *bp)
+{
+    struct image_shot *sp = bp->sp;
+    const void *q;
+
+    size_t n = (size_t) sp->w * sp->h * 4;
+
+    bp->sp = NULL;
+
+    glBindBuffer_(GL_PIXEL_PACK_BUFFER, bp->o);
+
+    if ((q = glMapBuffer_(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY)))
+    {
+        if ((sp->p = malloc(n)))
+            memcpy(sp->p, q, n);
+
+        glUnmapBuffer_(GL_PIXEL_PACK_BUFFER);
+    }
+
+    glBindBuffer_(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (sp->p)
+        queue_shot(sp);
+    else
+    {
+        log_printf("Failure to capture %s\n", sp->path);
+        free_shot(sp);
+    }
+}
 #endif
-#ifdef GL_GENERATE_MIPMAP_SGIS
-    int m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
+
+/*
+ * Queue the screenshots read back at least the given number of frames
+ * ago, oldest first.
+ */
+static void retire_buffers(int age)
+{
+#if !ENABLE_OPENGLES
+    int i;
+
+    for (i = 0; i < SNAP_BUFFERS; i++)
+    {
+        struct snap_buffer *bp = &snap_buffer[(snap_next + i) % SNAP_BUFFERS];
+
+        if (bp->sp && bp->age >= age)
+            retire_buffer(bp);
+    }
+#endif
+}
+
+/*
+ * Start capturing the back buffer to the named PNG file.
+ */
+void image_snap(const char *filename)
+{
+    struct image_shot *sp;
+
+    int w = video.device_w;
+    int h = video.device_h;
+
+    if (!(sp = (struct image_shot *) calloc(1, sizeof (*sp))))
+        return;
+
+    sp->w = w;
+    sp->h = h;
+
+    SAFECPY(sp->path, filename);
+
+#if !ENABLE_OPENGLES
+    if (gli.pixel_buffer_object)
+    {
+        struct snap_buffer *bp = &snap_buffer[snap_next];
+
+        snap_next = (snap_next + 1) % SNAP_BUFFERS;
+
+        /* Make room by finishing the oldest capture. */
+
+        if (bp->sp)
+            retire_buffer(bp);
+
+        if (bp->o == 0)
+            glGenBuffers_(1, &bp->o);
+
+        glBindBuffer_(GL_PIXEL_PACK_BUFFER, bp->o);
+        glBufferData_(GL_PIXEL_PACK_BUFFER, w * h * 4, NULL, GL_STREAM_READ);
+        glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindBuffer_(GL_PIXEL_PACK_BUFFER, 0);
+
+        bp->sp  = sp;
+        bp->age = 0;
+        return;
+    }
 #endif
-    int k = config_get_d(CONFIG_TEXTURES);
-    int W = w;
-    int H = h;
 
+    if ((sp->p = (unsigned char *) malloc(w * h * 4)))
+    {
+        glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, sp->p);
+        queue_shot(sp);
+    }
+    else free(sp);
+}
+
+/*
+ * Finish all pending captures and release the pixel buffers. Do this
+ * before the OpenGL context goes away.
+ */
+void image_snap_flush(void)
+{
+    int i;
+
+    retire_buffers(0);
+
+    for (i = 0; i < SNAP_BUFFERS; i++)
+        if (snap_buffer[i].o)
+        {
+            glDeleteBuffers_(1, &snap_buffer[i].o);
+            snap_buffer[i].o = 0;
+        }
+
+    snap_next = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Scale the image as configured, or to fit the OpenGL limitations.
+ * Return a new buffer, or NULL if the image fits as it is.
+ */
+static void *fit_texture(const void *p, int w, int h, int b, int k,
+                         int *W, int *H)
+{
     GLint max = gli.max_texture_size;
 
-    void *q = NULL;
+    *W = w;
+    *H = h;
 
     while (w / k > (int) max || h / k > (int) max)
         k *= 2;
 
-    if (k > 1)
-        q = image_scale(p, w, h, b, &W, &H, k);
+    return (k > 1) ? image_scale(p, w, h, b, W, H, k) : NULL;
+}
 
-    /* Generate and configure a new OpenGL texture. */
+/*
+ * Configure filtering of the bound texture and copy the image to it.
+ * If n is greater than one, the buffer holds a complete mipmap chain.
+ */
+static void load_texture(const void *p, int w, int h, int b, int n, int fl)
+{
+    static const GLenum format[] =
+        { 0, GL_LUMINANCE, GL_LUMINANCE_ALPHA, GL_RGB, GL_RGBA };
 
-    glGenTextures(1, &o);
-    glBindTexture(GL_TEXTURE_2D, o);
+#ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
+    int a = config_get_d(CONFIG_ANISO);
+#endif
+#ifdef GL_GENERATE_MIPMAP_SGIS
+    int m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
+#endif
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    const GLubyte *q = (const GLubyte *) p;
+    int i;
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
 #ifdef GL_GENERATE_MIPMAP_SGIS
-    if (m)
+    if (m && n == 1)
     {
         glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP_SGIS, GL_TRUE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                         GL_LINEAR_MIPMAP_LINEAR);
     }
 #endif
+    if (n > 1)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR);
+
 #ifdef GL_TEXTURE_MAX_ANISOTROPY_EXT
     if (a && gli.texture_filter_anisotropic) glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, a);
 #endif
 
-    /* Copy the image to an OpenGL texture. */
+    /* Copy the image, level by level, to an OpenGL texture. */
 
-    glTexImage2D(GL_TEXTURE_2D, 0,
-                 format[b], W, H, 0,
-                 format[b], GL_UNSIGNED_BYTE, q ? q : p);
+    if (n > 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-    if (q) free(q);
+    for (i = 0; i < n; i++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, i,
+                     format[b], w, h, 0,
+                     format[b], GL_UNSIGNED_BYTE, q);
 
+        q += w * h * b;
 
-    return o;
+        w = (w > 1) ? w / 2 : 1;
+        h = (h > 1) ? h / 2 : 1;
+    }
+
+    if (n > 1)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
 /*
- * Load an image from the named file.  Return an OpenGL texture object.
+ * Create an OpenGL texture object using the given image buffer.
  */
-GLuint make_image_from_file(const char *filename, int fl)
+GLuint make_texture(const void *p, int w, int h, int b, int fl)
 {
-    void  *p;
-    int    w;
-    int    h;
-    int    b;
     GLuint o = 0;
 
-    /* Load the image. */
+    int W;
+    int H;
 
-    if ((p = image_load(filename, &w, &h, &b)))
+    void *q = fit_texture(p, w, h, b, config_get_d(CONFIG_TEXTURES), &W, &H);
+
+    /* Generate and configure a new OpenGL texture. */
+
+    glGenTextures(1, &o);
+    glBindTexture(GL_TEXTURE_2D, o);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    load_texture(q ? q : p, W, H, b, 1, fl);
+
+    if (q) free(q);
+
+    return o;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Texture cache.
+ *
+ * Decoded images are stored in the user directory exactly as they are
+ * uploaded: downscaled per the texture quality setting and, for mipmapped
+ * textures, with their full mipmap chain. A cache file is keyed by the
+ * source path, the texture quality, mipmapping, and the GL size limit,
+ * and it records the size and hash of the source file, so that an edited
+ * image is decoded afresh. A source that can't be memory-mapped, such as
+ * a file in an archive, is recorded by size and modification time. A hit
+ * costs a read and at most a hash of the source, and no decoding at all.
+ */
+
+#define CACHE_DIR   "texcache"
+#define CACHE_MAGIC 0x5854424E          /* "NBTX" */
+#define CACHE_VER   1
+
+struct image_opt
+{
+    int k;                              /* Configured downscale           */
+    int m;                              /* Generate mipmaps               */
+    int c;                              /* Use the texture cache          */
+};
+
+struct image_key
+{
+    unsigned int hash;                  /* Hash of the source file        */
+    int          size;                  /* Size of the source file        */
+    int          max;                   /* GL texture size limit          */
+};
+
+/* Timing of cached (warm) and decoded (cold) loads. */
+
+static int    load_hit_c;
+static int    load_miss_c;
+static double load_hit_t;
+static double load_miss_t;
+
+static unsigned int hash_bytes(const unsigned char *p, int n, unsigned int h)
+{
+    /* FNV-1a */
+
+    int i;
+
+    for (i = 0; i < n; i++)
+        h = (h ^ p[i]) * 16777619u;
+
+    return h;
+}
+
+static int mipmap_bytes(int w, int h, int b, int n)
+{
+    int i, s = 0;
+
+    for (i = 0; i < n; i++)
     {
-        o = make_texture(p, w, h, b, fl);
-        free(p);
+        s += w * h * b;
+
+        w = (w > 1) ? w / 2 : 1;
+        h = (h > 1) ? h / 2 : 1;
     }
+    return s;
+}
 
-    return o;
+static void cache_path(char *dst, const char *path,
+                       const struct image_opt *opt)
+{
+    unsigned int h = 2166136261u;
+
+    h = hash_bytes((const unsigned char *) path, strlen(path), h);
+
+    sprintf(dst, CACHE_DIR "/%08x-%d%d.tex", h, opt->k, opt->m);
+}
+
+static void *cache_read(const char *path, const struct image_opt *opt,
+                        const struct image_key *key,
+                        int *w, int *h, int *b, int *n)
+{
+    char file[MAXSTR];
+    char name[MAXSTR];
+    fs_file fp;
+
+    void *p = NULL;
+
+    cache_path(file, path, opt);
+
+    if ((fp = fs_open(file, "r")))
+    {
+        if (get_index(fp) == CACHE_MAGIC &&
+            get_index(fp) == CACHE_VER)
+        {
+            get_string(fp, name, sizeof (name));
+
+            if (strcmp(name, path) == 0 &&
+                (unsigned int) get_index(fp) == key->hash &&
+                get_index(fp) == key->size &&
+                get_index(fp) == key->max)
+            {
+                int s;
+
+                *w = get_index(fp);
+                *h = get_index(fp);
+                *b = get_index(fp);
+                *n = get_index(fp);
+                s  = get_index(fp);
+
+                if (*b >= 1 && *b <= 4 && *n >= 1 &&
+                    s == mipmap_bytes(*w, *h, *b, *n) && (p = malloc(s)))
+                {
+                    if (fs_read(p, 1, s, fp) != s)
+                    {
+                        free(p);
+                        p = NULL;
+                    }
+                }
+            }
+        }
+        fs_close(fp);
+    }
+    return p;
+}
+
+static void cache_write(const char *path, const struct image_opt *opt,
+                        const struct image_key *key,
+                        const void *p, int w, int h, int b, int n)
+{
+    char file[MAXSTR];
+    char temp[MAXSTR];
+    fs_file fp;
+
+    int s = mipmap_bytes(w, h, b, n);
+
+    /* Write to a temporary, so that readers never see a partial file. */
+
+    cache_path(file, path, opt);
+    SAFECPY(temp, file);
+    SAFECAT(temp, ".tmp");
+
+    if ((fp = fs_open(temp, "w")))
+    {
+        int ok;
+
+        put_index(fp, CACHE_MAGIC);
+        put_index(fp, CACHE_VER);
+        put_string(fp, path);
+        put_index(fp, (int) key->hash);
+        put_index(fp, key->size);
+        put_index(fp, key->max);
+        put_index(fp, w);
+        put_index(fp, h);
+        put_index(fp, b);
+        put_index(fp, n);
+        put_index(fp, s);
+
+        ok = (fs_write(p, 1, s, fp) == s);
+
+        fs_close(fp);
+
+        if (ok)
+            fs_rename(temp, file);
+        else
+            fs_remove(temp);
+    }
+}
+
+/*
+ * Load the named image, downscaled and mipmapped as given, through the
+ * texture cache. This touches no GL state and is safe on any thread.
+ */
+static void *load_image(const char *path, const struct image_opt *opt,
+                        int *w, int *h, int *b, int *n, int *hit)
+{
+    struct image_key key = { 0, 0, 0 };
+
+    void *p = NULL;
+    void *q;
+
+    *hit = 0;
+
+    if (opt->c)
+    {
+        struct fs_map map;
+        fs_file fp;
+
+        /* Hash a mapped file.  Don't read anything else twice: an archived */
+        /* file is keyed by size and modification time instead.             */
+
+        if (fs_map_file(path, &map))
+        {
+            key.size = map.size;
+            key.hash = hash_bytes(map.data, map.size, 2166136261u);
+            fs_unmap(&map);
+        }
+        else if ((fp = fs_open(path, "r")))
+        {
+            key.size = fs_length(fp);
+            key.hash = (unsigned int) fs_mtime(path);
+            fs_close(fp);
+        }
+
+        if (key.size)
+        {
+            key.max = gli.max_texture_size;
+
+            if ((p = cache_read(path, opt, &key, w, h, b, n)))
+            {
+                *hit = 1;
+                return p;
+            }
+        }
+    }
+
+    if ((p = image_load(path, w, h, b)))
+    {
+        int W;
+        int H;
+
+        if ((q = fit_texture(p, *w, *h, *b, opt->k, &W, &H)))
+        {
+            free(p);
+
+            p  = q;
+            *w = W;
+            *h = H;
+        }
+
+        *n = 1;
+
+        if (opt->m && (q = image_mipmap(p, *w, *h, *b, n)))
+        {
+            free(p);
+            p = q;
+        }
+
+        if (opt->c && key.size)
+            cache_write(path, opt, &key, p, *w, *h, *b, *n);
+    }
+    return p;
+}
+
+static void get_image_opt(struct image_opt *opt, int fl)
+{
+    opt->k = config_get_d(CONFIG_TEXTURES);
+    opt->m = (fl & IF_MIPMAP) ? config_get_d(CONFIG_MIPMAP) : 0;
+    opt->c = config_get_d(CONFIG_TEXTURE_CACHE);
+}
+
+static void add_load_time(int hit, double t)
+{
+    if (hit)
+    {
+        load_hit_c++;
+        load_hit_t += t;
+    }
+    else
+    {
+        load_miss_c++;
+        load_miss_t += t;
+    }
+}
+
+static double get_time(void)
+{
+    return (double) SDL_GetPerformanceCounter() /
+           (double) SDL_GetPerformanceFrequency();
+}
+
+/*
+ * Load an image from the named file.  Return an OpenGL texture object.
+ */
+GLuint make_image_from_file(const char *filename, int fl)
+{
+    struct image_opt opt;
+
+    void  *p;
+    int    w;
+    int    h;
+    int    b;
+    int    n;
+    int    hit;
+    GLuint o = 0;
+
+    double t = get_time();
+
+    /* Load the image. */
+
+    get_image_opt(&opt, fl);
+
+    if ((p = load_image(filename, &opt, &w, &h, &b, &n, &hit)))
+    {
+        glGenTextures(1, &o);
+        glBindTexture(GL_TEXTURE_2D, o);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        load_texture(p, w, h, b, n, fl);
+        free(p);
+
+        add_load_time(hit, get_time() - t);
+    }
+
+    return o;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Asynchronous image loading.
+ *
+ * A pool of worker threads decodes (and, if configured, downscales)
+ * requested images. Each request gets its texture object up front,
+ * holding a single transparent texel, so callers can keep and bind it
+ * immediately. Decoded images are copied to their textures on the main
+ * thread by image_step, a few at a time.
+ *
+ * A pending texture must be released with image_cancel before it is
+ * deleted, lest its name be reused and overwritten later.
+ *
+ * Images may also be prefetched without a texture. A prefetched image is
+ * decoded like any other and then parked until make_image_async asks for
+ * the same image, which adopts the request instead of queuing a new one.
+ */
+
+#define IMAGE_THREADS 4
+#define IMAGE_STEP_MS 4
+#define IMAGE_PARKED  64
+
+#define REQ_WAIT 0
+#define REQ_WORK 1
+#define REQ_DONE 2
+
+struct image_req
+{
+    struct image_req *next;
+
+    int    state;
+    GLuint o;                           /* Target texture, 0 if cancelled */
+    int    fl;
+    int    park;                        /* Prefetched, not yet adopted    */
+
+    struct image_opt opt;
+
+    void  *p;                           /* Decoded image and mipmaps      */
+    int    w, h, b, n;
+    int    hit;                         /* Loaded from the cache          */
+    double t;                           /* Time spent loading             */
+
+    char   path[MAXSTR];
+};
+
+static struct image_req *req_head;
+static struct image_req *req_tail;
+
+static SDL_mutex  *req_mutex;
+static SDL_cond   *req_cond;
+static SDL_Thread *req_thread[IMAGE_THREADS];
+static int         req_threads;
+static int         req_running;
+
+static void free_req(struct image_req *rp)
+{
+    free(rp->p);
+    free(rp);
+}
+
+/*
+ * Unlink the first unparked request in the given state. Call with the
+ * lock held.
+ */
+static struct image_req *take_req(int state)
+{
+    struct image_req *rp, *pp = NULL;
+
+    for (rp = req_head; rp; pp = rp, rp = rp->next)
+        if (rp->state == state && !rp->park)
+        {
+            if (pp) pp->next = rp->next;
+            else    req_head = rp->next;
+
+            if (req_tail == rp)
+                req_tail = pp;
+
+            rp->next = NULL;
+            return rp;
+        }
+
+    return NULL;
+}
+
+/*
+ * Append a request to the queue. Call with the lock held.
+ */
+static void queue_req(struct image_req *rp)
+{
+    if (req_tail)
+        req_tail->next = rp;
+    else
+        req_head = rp;
+
+    req_tail = rp;
+
+    SDL_CondSignal(req_cond);
+}
+
+/*
+ * Find a parked request for the given image. Call with the lock held.
+ */
+static struct image_req *find_parked(const char *path,
+                                     const struct image_opt *opt)
+{
+    struct image_req *rp;
+
+    for (rp = req_head; rp; rp = rp->next)
+        if (rp->park && strcmp(rp->path, path) == 0 &&
+            memcmp(&rp->opt, opt, sizeof (*opt)) == 0)
+            return rp;
+
+    return NULL;
+}
+
+static int count_parked(void)
+{
+    struct image_req *rp;
+    int n = 0;
+
+    for (rp = req_head; rp; rp = rp->next)
+        n += rp->park;
+
+    return n;
+}
+
+/*
+ * Drop up to n parked requests, oldest first. One that a worker holds is
+ * merely unparked, which leaves it cancelled for image_step to discard.
+ * Call with the lock held.
+ */
+static void drop_parked(int n)
+{
+    struct image_req *rp, *pp = NULL, *np;
+
+    for (rp = req_head; rp && n > 0; rp = np)
+    {
+        np = rp->next;
+
+        if (!rp->park)
+        {
+            pp = rp;
+            continue;
+        }
+
+        n--;
+
+        if (rp->state == REQ_WORK)
+        {
+            rp->park = 0;
+            pp = rp;
+            continue;
+        }
+
+        if (pp) pp->next = np;
+        else    req_head = np;
+
+        if (req_tail == rp)
+            req_tail = pp;
+
+        free_req(rp);
+    }
+}
+
+static void decode_req(struct image_req *rp)
+{
+    double t = get_time();
+
+    rp->p = load_image(rp->path, &rp->opt, &rp->w, &rp->h, &rp->b, &rp->n,
+                       &rp->hit);
+    rp->t = get_time() - t;
+}
+
+static int image_work(void *data)
+{
+    struct image_req *rp;
+
+    SDL_mutexP(req_mutex);
+
+    while (req_running)
+    {
+        /* Claim the oldest waiting request, leaving it in the queue. */
+
+        for (rp = req_head; rp; rp = rp->next)
+            if (rp->state == REQ_WAIT)
+                break;
+
+        if (rp == NULL)
+        {
+            SDL_CondWait(req_cond, req_mutex);
+            continue;
+        }
+
+        rp->state = REQ_WORK;
+
+        SDL_mutexV(req_mutex);
+        decode_req(rp);
+        SDL_mutexP(req_mutex);
+
+        rp->state = REQ_DONE;
+    }
+
+    SDL_mutexV(req_mutex);
+
+    return 0;
+}
+
+void image_init(void)
+{
+    int i, n = SDL_GetCPUCount() - 1;
+
+    image_quit();
+
+    if (config_get_d(CONFIG_TEXTURE_CACHE))
+        fs_mkdir(CACHE_DIR);
+
+    n = CLAMP(1, n, IMAGE_THREADS);
+
+    if ((req_mutex = SDL_CreateMutex()) && (req_cond = SDL_CreateCond()))
+    {
+        req_running = 1;
+
+        for (i = 0; i < n; i++)
+            if ((req_thread[req_threads] = SDL_CreateThread(image_work,
+                                                            "image", NULL)))
+                req_threads++;
+    }
+}
+
+void image_quit(void)
+{
+    struct image_req *rp;
+    int i;
+
+    image_snap_flush();
+    snap_stop();
+
+    if (req_mutex)
+    {
+        SDL_mutexP(req_mutex);
+        req_running = 0;
+        SDL_CondBroadcast(req_cond);
+        SDL_mutexV(req_mutex);
+    }
+
+    for (i = 0; i < req_threads; i++)
+        SDL_WaitThread(req_thread[i], NULL);
+
+    req_threads = 0;
+
+    while ((rp = req_head))
+    {
+        req_head = rp->next;
+        free_req(rp);
+    }
+    req_tail = NULL;
+
+    if (req_cond)  SDL_DestroyCond (req_cond);
+    if (req_mutex) SDL_DestroyMutex(req_mutex);
+
+    req_cond  = NULL;
+    req_mutex = NULL;
+
+    /* Report cold and warm load times. */
+
+    if (load_hit_c || load_miss_c)
+        log_printf("Textures: %d cached in %.1f ms, %d decoded in %.1f ms\n",
+                   load_hit_c,  load_hit_t  * 1000.0,
+                   load_miss_c, load_miss_t * 1000.0);
+
+    load_hit_c  = 0;
+    load_miss_c = 0;
+    load_hit_t  = 0.0;
+    load_miss_t = 0.0;
+}
+
+/*
+ * Create a placeholder texture for the named image and queue the image
+ * for decoding. Without worker threads, load it right away instead.
+ */
+GLuint make_image_async(const char *filename, int fl)
+{
+    static const GLubyte texel[4] = { 0x80, 0x80, 0x80, 0x00 };
+
+    struct image_req *rp, *pp;
+    GLuint o = 0;
+
+    if (req_threads == 0)
+        return make_image_from_file(filename, fl);
+
+    if (!filename || !fs_exists(filename))
+        return 0;
+
+    if ((rp = calloc(1, sizeof (*rp))))
+    {
+        glGenTextures(1, &o);
+        glBindTexture(GL_TEXTURE_2D, o);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, texel);
+
+        rp->state = REQ_WAIT;
+        rp->o     = o;
+        rp->fl    = fl;
+
+        get_image_opt(&rp->opt, fl);
+
+        SAFECPY(rp->path, filename);
+
+        SDL_mutexP(req_mutex);
+        {
+            if ((pp = find_parked(filename, &rp->opt)))
+            {
+                /* Adopt the prefetched image instead. */
+
+                pp->o    = o;
+                pp->fl   = fl;
+                pp->park = 0;
+
+                free_req(rp);
+            }
+            else
+                queue_req(rp);
+        }
+        SDL_mutexV(req_mutex);
+    }
+    return o;
+}
+
+/*
+ * Queue the named image for decoding ahead of its use. Safe on any
+ * thread. Return zero if there is no such image.
+ */
+int image_prefetch(const char *filename, int fl)
+{
+    struct image_req *rp;
+
+    if (!filename || !fs_exists(filename))
+        return 0;
+
+    if (req_threads == 0)
+        return 1;
+
+    if ((rp = calloc(1, sizeof (*rp))))
+    {
+        rp->state = REQ_WAIT;
+        rp->fl    = fl;
+        rp->park  = 1;
+
+        get_image_opt(&rp->opt, fl);
+
+        SAFECPY(rp->path, filename);
+
+        SDL_mutexP(req_mutex);
+        {
+            if (find_parked(filename, &rp->opt))
+                free_req(rp);
+            else
+            {
+                /* Keep the parking lot bounded. */
+
+                if (count_parked() >= IMAGE_PARKED)
+                    drop_parked(1);
+
+                queue_req(rp);
+            }
+        }
+        SDL_mutexV(req_mutex);
+    }
+    return 1;
+}
+
+/*
+ * Forget prefetched images that no texture has asked for.
+ */
+void image_prefetch_drop(void)
+{
+    if (req_mutex)
+    {
+        SDL_mutexP(req_mutex);
+        drop_parked(IMAGE_PARKED);
+        SDL_mutexV(req_mutex);
+    }
+}
+
+/*
+ * Forget any pending request for the given texture.
+ */
+void image_cancel(GLuint o)
+{
+    struct image_req *rp, *pp = NULL, *np;
+
+    if (o == 0 || req_mutex == NULL)
+        return;
+
+    SDL_mutexP(req_mutex);
+
+    for (rp = req_head; rp; rp = np)
+    {
+        np = rp->next;
+
+        if (rp->o != o)
+        {
+            pp = rp;
+            continue;
+        }
+
+        if (rp->state == REQ_WORK)
+        {
+            /* A worker owns this one. Let image_step discard it. */
+
+            rp->o = 0;
+            pp = rp;
+            continue;
+        }
+
+        if (pp) pp->next = np;
+        else    req_head = np;
+
+        if (req_tail == rp)
+            req_tail = pp;
+
+        free_req(rp);
+    }
+
+    SDL_mutexV(req_mutex);
+}
+
+/*
+ * Copy decoded images to their textures, for a few milliseconds.
+ */
+static void upload_images(void)
+{
+    const Uint32 t0 = SDL_GetTicks();
+
+    struct image_req *rp;
+
+    if (req_mutex == NULL)
+        return;
+
+    do
+    {
+        SDL_mutexP(req_mutex);
+        rp = take_req(REQ_DONE);
+        SDL_mutexV(req_mutex);
+
+        if (rp == NULL)
+            break;
+
+        if (rp->o && rp->p)
+        {
+            glBindTexture(GL_TEXTURE_2D, rp->o);
+            load_texture(rp->p, rp->w, rp->h, rp->b, rp->n, rp->fl);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            add_load_time(rp->hit, rp->t);
+        }
+        else if (rp->o)
+            log_printf("Failure to load %s\n", rp->path);
+
+        free_req(rp);
+    }
+    while (SDL_GetTicks() - t0 < IMAGE_STEP_MS);
+}
+
+/*
+ * Do the per-frame image work: queue screenshots that have aged a full
+ * ring of frames, and upload decoded images.
+ */
+void image_step(void)
+{
+    int i;
+
+    for (i = 0; i < SNAP_BUFFERS; i++)
+        if (snap_buffer[i].sp)
+            snap_buffer[i].age++;
+
+    retire_buffers(SNAP_BUFFERS);
+
+    upload_images();
+}
+
+/*
+ * Finish all pending image loads. Use this where frames must not depend
+ * on how quickly images decode.
+ */
+void image_wait(void)
+{
+    int n;
+
+    while (req_mutex)
+    {
+        struct image_req *rp;
+
+        SDL_mutexP(req_mutex);
+        for (n = 0, rp = req_head; rp; rp = rp->next)
+            n += !rp->park;
+        SDL_mutexV(req_mutex);
+
+        if (n == 0)
+            break;
+
+        upload_images();
+        SDL_Delay(1);
+    }
 }
 
 /*---------------------------------------------------------------------------*/
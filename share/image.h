@@ -24,12 +24,24 @@
 #endif
 
 void   image_snap(const char *);
+void   image_snap_flush(void);
 
 GLuint make_image_from_file(const char *, int);
 GLuint make_image_from_font(int *, int *,
                             int *, int *, const char *, TTF_Font *, int);
 GLuint make_texture(const void *, int, int, int, int);
 
+void   image_init(void);
+void   image_quit(void);
+void   image_step(void);
+void   image_wait(void);
+
+GLuint make_image_async(const char *, int);
+void   image_cancel(GLuint);
+
+int    image_prefetch(const char *, int);
+void   image_prefetch_drop(void);
+
 SDL_Surface *load_surface(const char *);
 
 /*---------------------------------------------------------------------------*/
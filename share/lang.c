@@ -129,20 +129,18 @@ int lang_load(struct lang_desc *desc, const char *path)
 {
     if (desc && path && *path)
     {
-        fs_file fp;
+        fs_lines lr;
 
         memset(desc, 0, sizeof (*desc));
 
-        if ((fp = fs_open(path, "r")))
+        if ((lr = fs_lines_open(path)))
         {
-            char buf[MAXSTR];
+            char *buf;
 
             SAFECPY(desc->code, base_name_sans(path, ".txt"));
 
-            while (fs_gets(buf, sizeof (buf), fp))
+            while ((buf = fs_lines_get(lr)))
             {
-                strip_newline(buf);
-
                 if (str_starts_with(buf, "name1 "))
                     SAFECPY(desc->name1, buf + 6);
                 else if (str_starts_with(buf, "name2 "))
@@ -151,7 +149,7 @@ int lang_load(struct lang_desc *desc, const char *path)
                     SAFECPY(desc->font, buf + 5);
             }
 
-            fs_close(fp);
+            fs_lines_close(lr);
 
             if (*desc->name1)
                 return 1;
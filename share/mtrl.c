@@ -20,6 +20,7 @@
 #include "common.h"
 #include "image.h"
 #include "lang.h"
+#include "profile.h"
 
 /*
  * Material cache.
@@ -91,7 +92,7 @@ static GLuint find_texture(const char *name)
     {
         CONCAT_PATH(path, &tex_paths[i], name);
 
-        if ((o = make_image_from_file(path, IF_MIPMAP)))
+        if ((o = make_image_async(path, IF_MIPMAP)))
             return o;
     }
     return 0;
@@ -109,7 +110,11 @@ static void load_mtrl_objects(struct mtrl *mp)
 
     /* Load the texture. */
 
-    if ((mp->o = find_texture(_(mp->base.f))))
+    profile_begin("texture", mp->base.f);
+    mp->o = find_texture(_(mp->base.f));
+    profile_end();
+
+    if (mp->o)
     {
         /* Set the texture to clamp or repeat based on material type. */
 
@@ -132,6 +137,7 @@ static void free_mtrl_objects(struct mtrl *mp)
 {
     if (mp->o)
     {
+        image_cancel(mp->o);
         glDeleteTextures(1, &mp->o);
 
         mp->o = 0;
@@ -261,6 +267,26 @@ void mtrl_cache_sol(struct s_base *fp)
     }
 }
 
+/*
+ * Start decoding the textures of SOL materials ahead of caching them.
+ * This touches neither GL nor the material cache and is safe on any
+ * thread.
+ */
+void mtrl_prefetch_sol(const struct s_base *fp)
+{
+    char path[MAXSTR];
+    int mi, i;
+
+    for (mi = 0; mi < fp->mc; mi++)
+        for (i = 0; i < ARRAYSIZE(tex_paths); i++)
+        {
+            CONCAT_PATH(path, &tex_paths[i], _(fp->mv[mi].f));
+
+            if (image_prefetch(path, IF_MIPMAP))
+                break;
+        }
+}
+
 /*
  * Free cached materials.
  */
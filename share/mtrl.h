@@ -40,6 +40,8 @@ struct mtrl *mtrl_get(int);
 void mtrl_cache_sol(struct s_base *);
 void mtrl_free_sol (struct s_base *);
 
+void mtrl_prefetch_sol(const struct s_base *);
+
 void mtrl_load_objects(void);
 void mtrl_free_objects(void);
 
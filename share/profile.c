@@ -0,0 +1,784 @@
+/*
+ * Copyright (C) 2026 Neverball authors
+ *
+ * NEVERBALL is  free software; you can redistribute  it and/or modify
+ * it under the  terms of the GNU General  Public License as published
+ * by the Free  Software Foundation; either version 2  of the License,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT  ANY  WARRANTY;  without   even  the  implied  warranty  of
+ * MERCHANTABILITY or  FITNESS FOR A PARTICULAR PURPOSE.   See the GNU
+ * General Public License for more details.
+ */
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "profile.h"
+#include "common.h"
+#include "config.h"
+#include "video.h"
+#include "glext.h"
+#include "fs.h"
+
+/*---------------------------------------------------------------------------*/
+
+#define PROFILE_MAX   4096
+#define PROFILE_DEPTH 32
+#define PROFILE_ARG   64
+
+struct phase
+{
+    const char *name;                   /* Phase name                        */
+    char        arg[PROFILE_ARG];       /* Detail, such as a file name       */
+    Uint64      t0;                     /* Performance counter at start      */
+    Uint64      t1;                     /* Performance counter at end        */
+};
+
+static struct phase *phases;
+static int           phase_count;
+static int           phase_dropped;
+
+static int           stack[PROFILE_DEPTH];
+static int           depth;
+
+static Uint64        origin;
+static SDL_threadID  thread;
+
+/*---------------------------------------------------------------------------*/
+
+void profile_init(void)
+{
+    if (!phases && (phases = calloc(PROFILE_MAX, sizeof (*phases))))
+    {
+        phase_count   = 0;
+        phase_dropped = 0;
+        depth         = 0;
+
+        origin = SDL_GetPerformanceCounter();
+        thread = SDL_ThreadID();
+    }
+}
+
+void profile_quit(void)
+{
+    free(phases);
+    phases = NULL;
+}
+
+void profile_begin(const char *name, const char *arg)
+{
+    int i = -1;
+
+    if (!phases || SDL_ThreadID() != thread)
+        return;
+
+    /* Drop phases past the end of the buffer, but keep pairs matched. */
+
+    if (phase_count < PROFILE_MAX)
+    {
+        struct phase *p = phases + (i = phase_count++);
+
+        p->name = name;
+        p->t0   = SDL_GetPerformanceCounter();
+        p->t1   = 0;
+
+        if (arg)
+            SAFECPY(p->arg, arg);
+        else
+            p->arg[0] = 0;
+    }
+    else phase_dropped++;
+
+    if (depth < PROFILE_DEPTH)
+        stack[depth] = i;
+
+    depth++;
+}
+
+void profile_end(void)
+{
+    int i;
+
+    if (!phases || SDL_ThreadID() != thread || depth == 0)
+        return;
+
+    if (--depth < PROFILE_DEPTH && (i = stack[depth]) >= 0)
+        phases[i].t1 = SDL_GetPerformanceCounter();
+}
+
+/*
+ * Return milliseconds since profile_init.
+ */
+double profile_time(void)
+{
+    if (!phases)
+        return 0.0;
+
+    return 1000.0 * (SDL_GetPerformanceCounter() - origin) /
+        SDL_GetPerformanceFrequency();
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void put_string(fs_file fp, const char *s)
+{
+    fs_putc('"', fp);
+
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fs_putc('\\', fp);
+            fs_putc(*s, fp);
+        }
+        else if ((unsigned char) *s < 0x20)
+            fs_printf(fp, "\\u%04x", (unsigned char) *s);
+        else
+            fs_putc(*s, fp);
+    }
+
+    fs_putc('"', fp);
+}
+
+/*
+ * Write recorded phases in the Chrome trace event format, which can be
+ * loaded in chrome://tracing or Perfetto.  Phases still open end now.
+ */
+int profile_dump(const char *path)
+{
+    const double us = 1000000.0 / SDL_GetPerformanceFrequency();
+    const Uint64 now = SDL_GetPerformanceCounter();
+
+    fs_file fp;
+    int i;
+
+    if (!phases || !(fp = fs_open(path, "w")))
+        return 0;
+
+    fs_puts("{\"traceEvents\":[\n", fp);
+
+    for (i = 0; i < phase_count; i++)
+    {
+        const struct phase *p = phases + i;
+        const Uint64 t1 = p->t1 ? p->t1 : now;
+
+        fs_puts(i ? ",\n{\"name\":" : "{\"name\":", fp);
+        put_string(fp, p->name);
+        fs_printf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                  "\"ts\":%.1f,\"dur\":%.1f",
+                  (p->t0 - origin) * us, (t1 - p->t0) * us);
+
+        if (p->arg[0])
+        {
+            fs_puts(",\"args\":{\"arg\":", fp);
+            put_string(fp, p->arg);
+            fs_putc('}', fp);
+        }
+        fs_putc('}', fp);
+    }
+
+    fs_printf(fp, "\n],\"displayTimeUnit\":\"ms\","
+              "\"otherData\":{\"dropped\":%d}}\n", phase_dropped);
+
+    fs_close(fp);
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#define FRAME_MAX   4096                /* Frames kept                       */
+#define FRAME_DEPTH 16                  /* Phase nesting limit               */
+#define QUERY_LAG   4                   /* Frames until GPU results are read */
+#define QUERY_MAX   64                  /* Phase switches timed per frame    */
+
+static const char *phase_names[PHASE_MAX] = {
+    "input",
+    "physics",
+    "sync",
+    "back",
+    "reflection",
+    "fore",
+    "particles",
+    "gui",
+    "swap",
+    "other"
+};
+
+static const GLubyte phase_colors[PHASE_MAX][4] = {
+    { 0x80, 0x80, 0xff, 0xc0 },
+    { 0xff, 0x40, 0x40, 0xc0 },
+    { 0xff, 0xa0, 0x40, 0xc0 },
+    { 0x40, 0x80, 0x40, 0xc0 },
+    { 0x40, 0xc0, 0xc0, 0xc0 },
+    { 0x40, 0xff, 0x40, 0xc0 },
+    { 0xff, 0xff, 0x40, 0xc0 },
+    { 0xff, 0x80, 0xff, 0xc0 },
+    { 0xc0, 0xc0, 0xc0, 0xc0 },
+    { 0x60, 0x60, 0x60, 0xc0 }
+};
+
+struct frame
+{
+    double t;                           /* Start, in ms since the first frame */
+    float  total;                       /* Frame time in ms                  */
+    float  cpu[PHASE_MAX];              /* CPU time in ms                    */
+    float  gpu[PHASE_MAX];              /* GPU time in ms, or -1 if unknown  */
+};
+
+struct query_set
+{
+    GLuint q[QUERY_MAX];                /* Time elapsed queries              */
+    int    p[QUERY_MAX];                /* Phase timed by each query         */
+    int    n;                           /* Queries issued                    */
+    int    f;                           /* Frame timed                       */
+    int    full;                        /* Ran out of queries                */
+};
+
+static struct frame     *frame_v;
+static int               frame_n;       /* Frames recorded                   */
+static int               frame_on;      /* Recording                         */
+static int               frame_force;   /* Record regardless of config       */
+static struct frame      frame_curr;
+static Uint64            frame_t0;      /* Counter at the start of the frame */
+static Uint64            frame_origin;
+
+static int               phase_stack[FRAME_DEPTH];
+static int               phase_depth;
+static Uint64            phase_t;       /* Counter at the last phase switch  */
+
+static struct query_set  query_v[QUERY_LAG];
+static int               query_ok;      /* Query objects exist               */
+static int               query_on;      /* A query is running                */
+
+static double ticks_to_ms(Uint64 t)
+{
+    return 1000.0 * t / SDL_GetPerformanceFrequency();
+}
+
+static int curr_phase(void)
+{
+    if (phase_depth > 0 && phase_depth <= FRAME_DEPTH)
+        return phase_stack[phase_depth - 1];
+    else
+        return PHASE_OTHER;
+}
+
+/*
+ * End the running GPU timer and, unless stopping, start one for the
+ * given phase.
+ */
+static void query_switch(int p, int stop)
+{
+#if !ENABLE_OPENGLES
+    struct query_set *qs = query_v + frame_n % QUERY_LAG;
+
+    if (!query_ok)
+        return;
+
+    if (query_on)
+    {
+        glEndQuery_(GL_TIME_ELAPSED);
+        query_on = 0;
+    }
+
+    if (!stop)
+    {
+        if (qs->n < QUERY_MAX)
+        {
+            glBeginQuery_(GL_TIME_ELAPSED, qs->q[qs->n]);
+            qs->p[qs->n++] = p;
+            query_on = 1;
+        }
+        else qs->full = 1;
+    }
+#endif
+}
+
+/*
+ * Charge time since the last switch to the current phase.
+ */
+static void phase_charge(void)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    frame_curr.cpu[curr_phase()] += (float) ticks_to_ms(now - phase_t);
+    phase_t = now;
+}
+
+void profile_phase_begin(int p)
+{
+    if (!frame_on)
+        return;
+
+    phase_charge();
+
+    if (phase_depth < FRAME_DEPTH)
+        phase_stack[phase_depth] = p;
+
+    phase_depth++;
+
+    query_switch(p, 0);
+}
+
+void profile_phase_end(void)
+{
+    if (!frame_on || phase_depth == 0)
+        return;
+
+    phase_charge();
+
+    phase_depth--;
+
+    query_switch(curr_phase(), 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void query_init(void)
+{
+#if !ENABLE_OPENGLES
+    int i;
+
+    if (!query_ok && gli.timer_query)
+    {
+        for (i = 0; i < QUERY_LAG; i++)
+        {
+            glGenQueries_(QUERY_MAX, query_v[i].q);
+            query_v[i].n    = 0;
+            query_v[i].full = 0;
+        }
+        query_ok = 1;
+    }
+#endif
+}
+
+/*
+ * Add up the GPU timers of an old frame, if they're ready.  Results
+ * never block: a frame whose timers aren't done stays unknown.
+ */
+static void query_read(struct query_set *qs)
+{
+#if !ENABLE_OPENGLES
+    GLuint ready = 0, ns;
+    int i, n = qs->n;
+
+    if (query_ok && n > 0 && !qs->full && qs->f > frame_n - FRAME_MAX)
+    {
+        struct frame *fp = frame_v + qs->f % FRAME_MAX;
+
+        glGetQueryObjectuiv_(qs->q[n - 1], GL_QUERY_RESULT_AVAILABLE, &ready);
+
+        if (ready)
+        {
+            for (i = 0; i < PHASE_MAX; i++)
+                fp->gpu[i] = 0.0f;
+
+            for (i = 0; i < n; i++)
+            {
+                glGetQueryObjectuiv_(qs->q[i], GL_QUERY_RESULT, &ns);
+                fp->gpu[qs->p[i]] += ns / 1000000.0f;
+            }
+        }
+    }
+#endif
+    qs->n    = 0;
+    qs->full = 0;
+}
+
+void profile_free_objects(void)
+{
+#if !ENABLE_OPENGLES
+    int i;
+
+    if (query_ok)
+    {
+        if (query_on)
+        {
+            glEndQuery_(GL_TIME_ELAPSED);
+            query_on = 0;
+        }
+
+        for (i = 0; i < QUERY_LAG; i++)
+        {
+            glDeleteQueries_(QUERY_MAX, query_v[i].q);
+            query_v[i].n    = 0;
+            query_v[i].full = 0;
+        }
+        query_ok = 0;
+    }
+#endif
+}
+
+/*
+ * Close the current frame and start the next.  Call after the swap.
+ */
+void profile_frame(void)
+{
+    int on = (frame_force ||
+              config_get_d(CONFIG_GRAPH) ||
+              config_get_d(CONFIG_STATS));
+    Uint64 now;
+    int i;
+
+    if (frame_on)
+    {
+        struct frame *fp = frame_v + frame_n % FRAME_MAX;
+
+        now = SDL_GetPerformanceCounter();
+
+        frame_curr.cpu[curr_phase()] += (float) ticks_to_ms(now - phase_t);
+        query_switch(PHASE_OTHER, 1);
+
+        frame_curr.t     = ticks_to_ms(frame_t0 - frame_origin);
+        frame_curr.total = (float) ticks_to_ms(now - frame_t0);
+
+        for (i = 0; i < PHASE_MAX; i++)
+            frame_curr.gpu[i] = -1.0f;
+
+        *fp = frame_curr;
+
+        query_v[frame_n % QUERY_LAG].f = frame_n;
+        frame_n++;
+    }
+
+    if (on && !frame_v)
+    {
+        if (!(frame_v = calloc(FRAME_MAX, sizeof (*frame_v))))
+            on = 0;
+
+        frame_origin = SDL_GetPerformanceCounter();
+    }
+
+    if ((frame_on = on))
+    {
+        query_init();
+        query_read(query_v + frame_n % QUERY_LAG);
+
+        memset(&frame_curr, 0, sizeof (frame_curr));
+
+        frame_t0 = phase_t = SDL_GetPerformanceCounter();
+        phase_depth = 0;
+
+        query_switch(PHASE_OTHER, 0);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
+struct graph_vert
+{
+    GLfloat p[2];
+    GLubyte c[4];
+};
+
+static struct graph_vert *graph_v;
+static int                graph_n;
+static int                graph_m;
+
+static void graph_rect(float x0, float y0, float x1, float y1,
+                       const GLubyte *c)
+{
+    static const int k[6][2] = {
+        { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 }
+    };
+    int i;
+
+    for (i = 0; i < 6; i++)
+    {
+        struct graph_vert *v = graph_v + graph_n++;
+
+        v->p[0] = k[i][0] ? x1 : x0;
+        v->p[1] = k[i][1] ? y1 : y0;
+
+        memcpy(v->c, c, 4);
+    }
+}
+
+/*
+ * Draw the recent frames as stacked bars, CPU time at the bottom and
+ * GPU time above, with marks at 60 and 30 frames per second.
+ */
+void profile_graph(void)
+{
+    static const GLubyte mark[4] = { 0xff, 0xff, 0xff, 0x60 };
+
+    const float w = 2.0f * video.device_scale;
+    const float s = 4.0f * video.device_scale;
+    const float h = 34.0f * s;
+
+    int i, j, n, m;
+
+    if (!frame_on || !config_get_d(CONFIG_GRAPH) || frame_n == 0)
+        return;
+
+    /* Fill half the width.  Each frame is two stacks of quads. */
+
+    n = MIN(MIN(frame_n, FRAME_MAX), (int) (video.device_w / (2 * w)));
+    m = (2 * n * PHASE_MAX + 4) * 6;
+
+    if (m > graph_m)
+    {
+        struct graph_vert *v;
+
+        if (!(v = realloc(graph_v, m * sizeof (*v))))
+            return;
+
+        graph_v = v;
+        graph_m = m;
+    }
+
+    graph_n = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        const struct frame *fp = frame_v + (frame_n - n + i) % FRAME_MAX;
+        const float x = w * i;
+
+        float y0 = 0.0f;
+        float y1 = h;
+
+        for (j = 0; j < PHASE_MAX; j++)
+        {
+            if (fp->cpu[j] > 0.0f)
+            {
+                graph_rect(x, y0, x + w, y0 + fp->cpu[j] * s, phase_colors[j]);
+                y0 += fp->cpu[j] * s;
+            }
+
+            if (fp->gpu[j] > 0.0f)
+            {
+                graph_rect(x, y1, x + w, y1 + fp->gpu[j] * s, phase_colors[j]);
+                y1 += fp->gpu[j] * s;
+            }
+        }
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+        graph_rect(0.0f, i * h + 16.7f * s, n * w, i * h + 16.7f * s + 1, mark);
+        graph_rect(0.0f, i * h + 33.3f * s, n * w, i * h + 33.3f * s + 1, mark);
+    }
+
+    profile_phase_begin(PHASE_GUI);
+
+    video_push_ortho();
+    {
+        glDisable(GL_LIGHTING);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_TEXTURE_2D);
+        {
+            glBindBuffer_(GL_ARRAY_BUFFER, 0);
+
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+
+            glVertexPointer(2, GL_FLOAT,         sizeof (*graph_v), graph_v->p);
+            glColorPointer (4, GL_UNSIGNED_BYTE, sizeof (*graph_v), graph_v->c);
+
+            glDrawArrays(GL_TRIANGLES, 0, graph_n);
+
+            glDisableClientState(GL_COLOR_ARRAY);
+            glDisableClientState(GL_VERTEX_ARRAY);
+
+            glColor4ub(0xff, 0xff, 0xff, 0xff);
+        }
+        glEnable(GL_TEXTURE_2D);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_LIGHTING);
+    }
+    video_pop_matrix();
+
+    profile_phase_end();
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int cmp_floats(const void *a, const void *b)
+{
+    const float x = *((const float *) a);
+    const float y = *((const float *) b);
+
+    return (x < y) ? -1 : ((x > y) ? +1 : 0);
+}
+
+/*
+ * Record frames from the next call to profile_frame on, whatever the
+ * configuration says.
+ */
+void profile_frame_record(int on)
+{
+    frame_force = on;
+}
+
+int profile_frame_count(void)
+{
+    return frame_n;
+}
+
+/*
+ * Return the given percentile of the last N frame times.
+ */
+float profile_frame_time(int n, float pct)
+{
+    float *v, t = 0.0f;
+    int i;
+
+    n = MIN(n, MIN(frame_n, FRAME_MAX));
+
+    if (n > 0 && (v = malloc(n * sizeof (*v))))
+    {
+        for (i = 0; i < n; i++)
+            v[i] = frame_v[(frame_n - n + i) % FRAME_MAX].total;
+
+        qsort(v, n, sizeof (*v), cmp_floats);
+
+        t = v[MIN(n - 1, (int) (n * pct / 100.0f))];
+
+        free(v);
+    }
+    return t;
+}
+
+/*
+ * Return the mean CPU or GPU time of a phase over the last N frames.
+ * GPU time is averaged over the frames whose timers were read, and is
+ * -1 if there are none.
+ */
+float profile_frame_phase(int n, int p, int gpu)
+{
+    float t = 0.0f;
+    int i, c = 0;
+
+    n = MIN(n, MIN(frame_n, FRAME_MAX));
+
+    for (i = 0; i < n; i++)
+    {
+        const struct frame *fp = frame_v + (frame_n - n + i) % FRAME_MAX;
+
+        if (!gpu)
+        {
+            t += fp->cpu[p];
+            c++;
+        }
+        else if (fp->gpu[p] >= 0.0f)
+        {
+            t += fp->gpu[p];
+            c++;
+        }
+    }
+
+    if (c > 0)
+        return t / c;
+    else
+        return gpu ? -1.0f : 0.0f;
+}
+
+static void put_phases(fs_file fp, const float *v)
+{
+    int i;
+
+    for (i = 0; i < PHASE_MAX; i++)
+        fs_printf(fp, "%s\"%s\":%.3f", i ? "," : "", phase_names[i], v[i]);
+}
+
+/*
+ * Write the recorded frames in the Chrome trace event format.  Each
+ * frame is a slice, with its phase times as counters.
+ */
+int profile_frame_dump(const char *path)
+{
+    const int n = MIN(frame_n, FRAME_MAX);
+
+    fs_file fp;
+    int i;
+
+    if (n == 0 || !(fp = fs_open(path, "w")))
+        return 0;
+
+    fs_puts("{\"traceEvents\":[\n", fp);
+
+    for (i = 0; i < n; i++)
+    {
+        const int f = frame_n - n + i;
+        const struct frame *p = frame_v + f % FRAME_MAX;
+
+        fs_printf(fp, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                  "\"ts\":%.1f,\"dur\":%.1f,\"args\":{\"frame\":%d}},\n",
+                  i ? ",\n" : "", p->t * 1000.0, p->total * 1000.0, f);
+
+        fs_printf(fp, "{\"name\":\"cpu\",\"ph\":\"C\",\"pid\":1,"
+                  "\"ts\":%.1f,\"args\":{", p->t * 1000.0);
+        put_phases(fp, p->cpu);
+        fs_puts("}}", fp);
+
+        if (p->gpu[0] >= 0.0f)
+        {
+            fs_printf(fp, ",\n{\"name\":\"gpu\",\"ph\":\"C\",\"pid\":1,"
+                      "\"ts\":%.1f,\"args\":{", p->t * 1000.0);
+            put_phases(fp, p->gpu);
+            fs_puts("}}", fp);
+        }
+    }
+
+    fs_printf(fp, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":"
+              "{\"frames\":%d,\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f}}\n",
+              n,
+              profile_frame_time(n, 50.0f),
+              profile_frame_time(n, 99.0f),
+              profile_frame_time(n, 100.0f));
+
+    fs_close(fp);
+
+    return 1;
+}
+
+/*---------------------------------------------------------------------------*/
+
+void profile_memory(long *heap, long *peak)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+
+    *heap = (long) ((mi.uordblks + mi.hblkhd) / 1024);
+#elif defined(__GLIBC__)
+    struct mallinfo mi = mallinfo();
+
+    *heap = ((long) (unsigned int) mi.uordblks +
+             (long) (unsigned int) mi.hblkhd) / 1024;
+#else
+    *heap = -1;
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+    {
+        struct rusage ru;
+
+        if (getrusage(RUSAGE_SELF, &ru) == 0)
+        {
+#if defined(__APPLE__)
+            *peak = (long) ru.ru_maxrss / 1024;
+#else
+            *peak = (long) ru.ru_maxrss;
+#endif
+        }
+        else *peak = -1;
+    }
+#else
+    *peak = -1;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,71 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Phase timing.  Phases are opened and closed in pairs and may nest.
+ * Only the main thread is recorded, and nothing is recorded until
+ * profile_init is called.  Phase names must be string constants.
+ */
+
+void profile_init(void);
+void profile_quit(void);
+
+void profile_begin(const char *name, const char *arg);
+void profile_end(void);
+
+double profile_time(void);
+int    profile_dump(const char *path);
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Frame timing.  CPU time, and GPU time where timer queries are
+ * available, is kept per phase for the last few thousand frames while
+ * the graph or stats are enabled, or recording is forced.  Time is
+ * charged to the innermost open phase, and time outside any phase to
+ * PHASE_OTHER.
+ */
+
+enum
+{
+    PHASE_INPUT = 0,
+    PHASE_PHYSICS,
+    PHASE_SYNC,
+    PHASE_BACK,
+    PHASE_REFL,
+    PHASE_FORE,
+    PHASE_PARTS,
+    PHASE_GUI,
+    PHASE_SWAP,
+    PHASE_OTHER,
+
+    PHASE_MAX
+};
+
+void  profile_phase_begin(int);
+void  profile_phase_end(void);
+
+void  profile_frame(void);
+void  profile_frame_record(int);
+void  profile_graph(void);
+void  profile_free_objects(void);
+
+int   profile_frame_count(void);
+float profile_frame_time(int, float);
+float profile_frame_phase(int, int, int);
+int   profile_frame_dump(const char *path);
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Memory use in kilobytes: heap in use and peak resident set size.
+ * Either is -1 where the platform can't tell.
+ */
+
+void  profile_memory(long *heap, long *peak);
+
+/*---------------------------------------------------------------------------*/
+
+#endif
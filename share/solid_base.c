@@ -36,7 +36,11 @@ enum
 
 /*---------------------------------------------------------------------------*/
 
-static int sol_version;
+/*
+ * Read the file header and return the file version, or zero if the file
+ * cannot be read.  The version goes with each load, as SOLs may be read
+ * on several threads at once.
+ */
 
 static int sol_file(fs_file fin)
 {
@@ -50,12 +54,10 @@ static int sol_file(fs_file fin)
                                version > SOL_VERSION_CURR))
         return 0;
 
-    sol_version = version;
-
-    return 1;
+    return version;
 }
 
-static void sol_load_mtrl(fs_file fin, struct b_mtrl *mp)
+static void sol_load_mtrl(fs_file fin, struct b_mtrl *mp, int version)
 {
     get_array(fin, mp->d, 4);
     get_array(fin, mp->a, 4);
@@ -67,7 +69,7 @@ static void sol_load_mtrl(fs_file fin, struct b_mtrl *mp)
 
     fs_read(mp->f, 1, PATHMAX, fin);
 
-    if (sol_version >= SOL_VERSION_DEV)
+    if (version >= SOL_VERSION_DEV)
     {
         if (mp->fl & M_ALPHA_TEST)
         {
@@ -78,7 +80,7 @@ static void sol_load_mtrl(fs_file fin, struct b_mtrl *mp)
 
     /* Convert 1.5.4 material flags. */
 
-    if (sol_version == SOL_VERSION_1_5)
+    if (version == SOL_VERSION_1_5)
     {
         static const int flags[][2] = {
             { 1, M_SHADOWED },
@@ -141,11 +143,12 @@ static void sol_load_offs(fs_file fin, struct b_offs *op)
     op->vi = get_index(fin);
 }
 
-static void sol_load_geom(fs_file fin, struct b_geom *gp, struct s_base *fp)
+static void sol_load_geom(fs_file fin, struct b_geom *gp, struct s_base *fp,
+                          int version)
 {
     gp->mi = get_index(fin);
 
-    if (sol_version >= SOL_VERSION_DEV)
+    if (version >= SOL_VERSION_DEV)
     {
         gp->oi = get_index(fin);
         gp->oj = get_index(fin);
@@ -220,7 +223,7 @@ static void sol_load_node(fs_file fin, struct b_node *np)
     np->lc = get_index(fin);
 }
 
-static void sol_load_path(fs_file fin, struct b_path *pp)
+static void sol_load_path(fs_file fin, struct b_path *pp, int version)
 {
     get_array(fin, pp->p, 3);
 
@@ -232,7 +235,7 @@ static void sol_load_path(fs_file fin, struct b_path *pp)
     pp->tm = TIME_TO_MS(pp->t);
     pp->t  = MS_TO_TIME(pp->tm);
 
-    if (sol_version >= SOL_VERSION_DEV)
+    if (version >= SOL_VERSION_DEV)
         pp->fl = get_index(fin);
 
     pp->e[0] = 1.0f;
@@ -244,11 +247,11 @@ static void sol_load_path(fs_file fin, struct b_path *pp)
         get_array(fin, pp->e, 4);
 }
 
-static void sol_load_body(fs_file fin, struct b_body *bp)
+static void sol_load_body(fs_file fin, struct b_body *bp, int version)
 {
     bp->pi = get_index(fin);
 
-    if (sol_version >= SOL_VERSION_DEV)
+    if (version >= SOL_VERSION_DEV)
     {
         bp->pj = get_index(fin);
 
@@ -338,7 +341,7 @@ static void sol_load_dict(fs_file fin, struct b_dict *dp)
     dp->aj = get_index(fin);
 }
 
-static void sol_load_indx(fs_file fin, struct s_base *fp)
+static void sol_load_indx(fs_file fin, struct s_base *fp, int version)
 {
     fp->ac = get_index(fin);
     fp->dc = get_index(fin);
@@ -348,7 +351,7 @@ static void sol_load_indx(fs_file fin, struct s_base *fp)
     fp->sc = get_index(fin);
     fp->tc = get_index(fin);
 
-    if (sol_version >= SOL_VERSION_DEV)
+    if (version >= SOL_VERSION_DEV)
         fp->oc = get_index(fin);
 
     fp->gc = get_index(fin);
@@ -368,12 +371,12 @@ static void sol_load_indx(fs_file fin, struct s_base *fp)
 
 static int sol_load_file(fs_file fin, struct s_base *fp)
 {
-    int i;
+    int i, v;
 
-    if (!sol_file(fin))
+    if (!(v = sol_file(fin)))
         return 0;
 
-    sol_load_indx(fin, fp);
+    sol_load_indx(fin, fp, v);
 
     if (fp->ac)
         fp->av = (char *)          calloc(fp->ac, sizeof (*fp->av));
@@ -422,17 +425,17 @@ static int sol_load_file(fs_file fin, struct s_base *fp)
         fs_read(fp->av, 1, fp->ac, fin);
 
     for (i = 0; i < fp->dc; i++) sol_load_dict(fin, fp->dv + i);
-    for (i = 0; i < fp->mc; i++) sol_load_mtrl(fin, fp->mv + i);
+    for (i = 0; i < fp->mc; i++) sol_load_mtrl(fin, fp->mv + i, v);
     for (i = 0; i < fp->vc; i++) sol_load_vert(fin, fp->vv + i);
     for (i = 0; i < fp->ec; i++) sol_load_edge(fin, fp->ev + i);
     for (i = 0; i < fp->sc; i++) sol_load_side(fin, fp->sv + i);
     for (i = 0; i < fp->tc; i++) sol_load_texc(fin, fp->tv + i);
     for (i = 0; i < fp->oc; i++) sol_load_offs(fin, fp->ov + i);
-    for (i = 0; i < fp->gc; i++) sol_load_geom(fin, fp->gv + i, fp);
+    for (i = 0; i < fp->gc; i++) sol_load_geom(fin, fp->gv + i, fp, v);
     for (i = 0; i < fp->lc; i++) sol_load_lump(fin, fp->lv + i);
     for (i = 0; i < fp->nc; i++) sol_load_node(fin, fp->nv + i);
-    for (i = 0; i < fp->pc; i++) sol_load_path(fin, fp->pv + i);
-    for (i = 0; i < fp->bc; i++) sol_load_body(fin, fp->bv + i);
+    for (i = 0; i < fp->pc; i++) sol_load_path(fin, fp->pv + i, v);
+    for (i = 0; i < fp->bc; i++) sol_load_body(fin, fp->bv + i, v);
     for (i = 0; i < fp->hc; i++) sol_load_item(fin, fp->hv + i);
     for (i = 0; i < fp->zc; i++) sol_load_goal(fin, fp->zv + i);
     for (i = 0; i < fp->jc; i++) sol_load_jump(fin, fp->jv + i);
@@ -455,10 +458,12 @@ static int sol_load_file(fs_file fin, struct s_base *fp)
 
 static int sol_load_head(fs_file fin, struct s_base *fp)
 {
-    if (!sol_file(fin))
+    int v;
+
+    if (!(v = sol_file(fin)))
         return 0;
 
-    sol_load_indx(fin, fp);
+    sol_load_indx(fin, fp, v);
 
     if (fp->ac)
     {
@@ -824,7 +829,7 @@ int mtrl_read(struct b_mtrl *mp, const char *name)
     static char line[MAXSTR];
     static char word[MAXSTR];
 
-    fs_file fp;
+    fs_lines lr;
     int i;
 
     if (mp && name && *name)
@@ -843,23 +848,27 @@ int mtrl_read(struct b_mtrl *mp, const char *name)
         mp->alpha_func = 0;
         mp->alpha_ref  = 0.0f;
 
-        fp = NULL;
+        lr = NULL;
 
         for (i = 0; i < ARRAYSIZE(mtrl_paths); i++)
         {
             CONCAT_PATH(line, &mtrl_paths[i], name);
 
-            if ((fp = fs_open(line, "r")))
+            if ((lr = fs_lines_open(line)))
                 break;
         }
 
-        if (fp)
+        if (lr)
         {
             char str[16] = "";
+            char *p;
 
-            while (fs_gets(line, sizeof (line), fp))
+            while ((p = fs_lines_get(lr)))
             {
-                char *p = strip_newline(line);
+                /* Keep the line within the bounds the scanners expect. */
+
+                SAFECPY(line, p);
+                p = line;
 
                 if (sscanf(p, "diffuse %f %f %f %f",
                            &mp->d[0], &mp->d[1],
@@ -923,7 +932,7 @@ int mtrl_read(struct b_mtrl *mp, const char *name)
                 else /* Unknown directive */;
             }
 
-            fs_close(fp);
+            fs_lines_close(lr);
             return 1;
         }
         else /* Unknown material */;
@@ -29,6 +29,8 @@
 #include "config.h"
 #include "base_config.h"
 #include "lang.h"
+#include "common.h"
+#include "profile.h"
 
 #include "solid_draw.h"
 #include "solid_all.h"
@@ -54,18 +56,13 @@ static const struct
 /*---------------------------------------------------------------------------*/
 
 static void sol_transform(const struct s_vary *vary,
-                          const struct v_body *bp, int ui)
+                          const float p[3], const float e[4], int ui)
 {
     float a;
-    float e[4];
-    float p[3];
     float v[3];
 
     /* Apply the body position and rotation to the model-view matrix. */
 
-    sol_body_p(p, vary, bp, 0.0f);
-    sol_body_e(e, vary, bp, 0.0f);
-
     q_as_axisangle(e, v, &a);
 
     if (!(p[0] == 0 && p[1] == 0 && p[2] == 0))
@@ -130,6 +127,200 @@ static void sol_transform(const struct s_vary *vary,
 
 /*---------------------------------------------------------------------------*/
 
+static struct d_stats stats;
+
+void sol_draw_stats(struct d_stats *sp)
+{
+    if (sp)
+        *sp = stats;
+
+    memset(&stats, 0, sizeof (stats));
+}
+
+/*
+ * Culling state for the body being drawn: the planes of the view frustum
+ * in the current model-view coordinate system, and the body's pose.
+ */
+
+struct d_cull
+{
+    float P[6][4];
+    float p[3];
+    float e[4];
+};
+
+static void sol_cull_init(struct d_cull *cp)
+{
+    float M[16], N[16], V[16];
+    int i, j;
+
+    /* Find the combined model-view-projection matrix. */
+
+    glGetFloatv(GL_PROJECTION_MATRIX, M);
+    glGetFloatv(GL_MODELVIEW_MATRIX,  N);
+
+    m_mult(V, M, N);
+
+    /* Extract and normalize the left, right, bottom, top, near, far planes. */
+
+    for (i = 0; i < 3; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            cp->P[i * 2 + 0][j] = V[j * 4 + 3] + V[j * 4 + i];
+            cp->P[i * 2 + 1][j] = V[j * 4 + 3] - V[j * 4 + i];
+        }
+    }
+
+    for (i = 0; i < 6; i++)
+    {
+        float k = v_len(cp->P[i]);
+
+        if (k > 0.0f)
+        {
+            cp->P[i][0] /= k;
+            cp->P[i][1] /= k;
+            cp->P[i][2] /= k;
+            cp->P[i][3] /= k;
+        }
+    }
+}
+
+/*
+ * Test a bounding sphere given in model-view coordinates against the
+ * frustum.  Return 0 if the sphere is outside, 1 if it straddles a
+ * plane, 2 if it is inside.
+ */
+
+static int sol_cull_sphere(const struct d_cull *cp, const float w[3], float r)
+{
+    int i, n = 2;
+
+    for (i = 0; i < 6; i++)
+    {
+        float d = v_dot(cp->P[i], w) + cp->P[i][3];
+
+        if (d < -r)
+            return 0;
+        if (d <  r)
+            n = 1;
+    }
+    return n;
+}
+
+/*
+ * Test a body-local bounding sphere against the frustum.
+ */
+
+static int sol_cull_test(const struct d_cull *cp, const float c[3], float r)
+{
+    float w[3];
+
+    q_rot(w, cp->e, c);
+    v_add(w, w, cp->p);
+
+    return sol_cull_sphere(cp, w, r);
+}
+
+static void sol_bound_mesh(struct d_mesh *mp, const struct d_vert *vv, int vn)
+{
+    float a[3], b[3];
+    int i;
+
+    mp->c[0] = mp->c[1] = mp->c[2] = 0.0f;
+    mp->r    = 0.0f;
+
+    if (vn == 0)
+        return;
+
+    v_cpy(a, vv[0].p);
+    v_cpy(b, vv[0].p);
+
+    /* Center the sphere on the bounding box of all vertices. */
+
+    for (i = 1; i < vn; i++)
+    {
+        a[0] = MIN(a[0], vv[i].p[0]);
+        a[1] = MIN(a[1], vv[i].p[1]);
+        a[2] = MIN(a[2], vv[i].p[2]);
+        b[0] = MAX(b[0], vv[i].p[0]);
+        b[1] = MAX(b[1], vv[i].p[1]);
+        b[2] = MAX(b[2], vv[i].p[2]);
+    }
+
+    v_mid(mp->c, a, b);
+
+    /* Extend the radius to reach the farthest vertex. */
+
+    for (i = 0; i < vn; i++)
+    {
+        float d[3], k;
+
+        v_sub(d, vv[i].p, mp->c);
+
+        if ((k = v_len(d)) > mp->r)
+            mp->r = k;
+    }
+}
+
+static void sol_bound_body(struct d_body *bp)
+{
+    float a[3], b[3];
+    int i;
+
+    bp->c[0] = bp->c[1] = bp->c[2] = 0.0f;
+    bp->r    = 0.0f;
+
+    bp->particles = 0;
+
+    if (bp->mc == 0)
+        return;
+
+    /* Point sprites overhang any bound, so note bodies that have them. */
+
+    for (i = 0; i < bp->mc; i++)
+        if (mtrl_get(bp->mv[i].mtrl)->base.fl & M_PARTICLE)
+            bp->particles = 1;
+
+    /* Center the sphere on the bounding box of all mesh spheres. */
+
+    for (i = 0; i < bp->mc; i++)
+    {
+        const struct d_mesh *mp = bp->mv + i;
+
+        if (i == 0)
+        {
+            v_cpy(a, mp->c);
+            v_cpy(b, mp->c);
+        }
+
+        a[0] = MIN(a[0], mp->c[0] - mp->r);
+        a[1] = MIN(a[1], mp->c[1] - mp->r);
+        a[2] = MIN(a[2], mp->c[2] - mp->r);
+        b[0] = MAX(b[0], mp->c[0] + mp->r);
+        b[1] = MAX(b[1], mp->c[1] + mp->r);
+        b[2] = MAX(b[2], mp->c[2] + mp->r);
+    }
+
+    v_mid(bp->c, a, b);
+
+    /* Extend the radius to enclose every mesh sphere. */
+
+    for (i = 0; i < bp->mc; i++)
+    {
+        const struct d_mesh *mp = bp->mv + i;
+
+        float d[3], k;
+
+        v_sub(d, mp->c, bp->c);
+
+        if ((k = v_len(d) + mp->r) > bp->r)
+            bp->r = k;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+
 static void sol_load_bill(struct s_draw *draw)
 {
     static const GLfloat data[] = {
@@ -159,6 +350,8 @@ static void sol_free_bill(struct s_draw *draw)
 
 static void sol_draw_bill(GLboolean edge)
 {
+    stats.draw_calls++;
+
     if (edge)
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
     else
@@ -275,6 +468,38 @@ static void sol_mesh_vert(struct d_vert *vp,
     vp->t[1] = tq->u[1];
 }
 
+static void sol_mesh_tri(struct d_vert *vv,   int *vn,
+                         struct d_geom *gv,   int *gn,
+                         const struct s_base *base, int *iv,
+                         const struct b_geom *gq)
+{
+    /* Insert a d_vert into the VBO data for each referenced b_off. */
+
+    if (iv[gq->oi] == -1)
+    {
+        iv[gq->oi] = *vn;
+        sol_mesh_vert(vv + (*vn)++, base, gq->oi);
+    }
+    if (iv[gq->oj] == -1)
+    {
+        iv[gq->oj] = *vn;
+        sol_mesh_vert(vv + (*vn)++, base, gq->oj);
+    }
+    if (iv[gq->ok] == -1)
+    {
+        iv[gq->ok] = *vn;
+        sol_mesh_vert(vv + (*vn)++, base, gq->ok);
+    }
+
+    /* Populate the EBO data using remapped b_off indices. */
+
+    gv[*gn].i = iv[gq->oi];
+    gv[*gn].j = iv[gq->oj];
+    gv[*gn].k = iv[gq->ok];
+
+    (*gn)++;
+}
+
 static void sol_mesh_geom(struct d_vert *vv,   int *vn,
                           struct d_geom *gv,   int *gn,
                           const struct s_base *base, int *iv, int g0, int gc, int mi)
@@ -288,39 +513,48 @@ static void sol_mesh_geom(struct d_vert *vv,   int *vn,
         const struct b_geom *gq = base->gv + base->iv[g0 + gi];
 
         if (gq->mi == mi)
-        {
-            /* Insert a d_vert into the VBO data for each referenced b_off. */
+            sol_mesh_tri(vv, vn, gv, gn, base, iv, gq);
+    }
+}
 
-            if (iv[gq->oi] == -1)
-            {
-                iv[gq->oi] = *vn;
-                sol_mesh_vert(vv + (*vn)++, base, gq->oi);
-            }
-            if (iv[gq->oj] == -1)
-            {
-                iv[gq->oj] = *vn;
-                sol_mesh_vert(vv + (*vn)++, base, gq->oj);
-            }
-            if (iv[gq->ok] == -1)
-            {
-                iv[gq->ok] = *vn;
-                sol_mesh_vert(vv + (*vn)++, base, gq->ok);
-            }
+static void sol_make_mesh(struct d_mesh *mp,
+                          const struct d_vert *vv, int vn,
+                          const struct d_geom *gv, int gn, int mtrl)
+{
+    const size_t vs = sizeof (struct d_vert);
+    const size_t gs = sizeof (struct d_geom);
 
-            /* Populate the EBO data using remapped b_off indices. */
+    /* Initialize buffer objects for all data. */
 
-            gv[*gn].i = iv[gq->oi];
-            gv[*gn].j = iv[gq->oj];
-            gv[*gn].k = iv[gq->ok];
+    glGenBuffers_(1, &mp->vbo);
+    glBindBuffer_(GL_ARRAY_BUFFER,         mp->vbo);
+    glBufferData_(GL_ARRAY_BUFFER,         vn * vs, vv, GL_STATIC_DRAW);
+    glBindBuffer_(GL_ARRAY_BUFFER,         0);
 
-            (*gn)++;
-        }
-    }
+    glGenBuffers_(1, &mp->ebo);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, mp->ebo);
+    glBufferData_(GL_ELEMENT_ARRAY_BUFFER, gn * gs, gv, GL_STATIC_DRAW);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    /* Note cached material index and bounds. */
+
+    mp->mtrl = mtrl;
+
+    sol_bound_mesh(mp, vv, vn);
+
+    mp->ebc = gn * 3;
+    mp->vbc = vn;
 }
 
-static void sol_load_mesh(struct d_mesh *mp,
-                          const struct b_body *bp,
-                          const struct s_draw *draw, int mi)
+/*
+ * Gather the vertex and element data of all geoms of a body with the
+ * given material.  The caller frees both arrays.
+ */
+
+static int sol_mesh_data(struct d_vert **vvp, int *vn,
+                         struct d_geom **gvp, int *gn,
+                         const struct b_body *bp,
+                         const struct s_draw *draw, int mi)
 {
     const size_t vs = sizeof (struct d_vert);
     const size_t gs = sizeof (struct d_geom);
@@ -330,11 +564,12 @@ static void sol_load_mesh(struct d_mesh *mp,
     int           *iv = 0;
 
     int oc = draw->base->oc;
-    int vn = 0;
-    int gn = 0;
 
     const int gc = sol_count_body(bp, draw->base, mi);
 
+    *vn = 0;
+    *gn = 0;
+
     /* Get temporary storage for vertex and element array creation. */
 
     if ((vv = (struct d_vert *) calloc(oc, vs)) &&
@@ -350,37 +585,48 @@ static void sol_load_mesh(struct d_mesh *mp,
         /* Include all matching lump geoms in the arrays. */
 
         for (li = 0; li < bp->lc; li++)
-            sol_mesh_geom(vv, &vn, gv, &gn, draw->base, iv,
+            sol_mesh_geom(vv, vn, gv, gn, draw->base, iv,
                           draw->base->lv[bp->l0 + li].g0,
                           draw->base->lv[bp->l0 + li].gc, mi);
 
         /* Include all matching body geoms in the arrays. */
 
-        sol_mesh_geom(vv, &vn, gv, &gn, draw->base, iv, bp->g0, bp->gc, mi);
-
-        /* Initialize buffer objects for all data. */
-
-        glGenBuffers_(1, &mp->vbo);
-        glBindBuffer_(GL_ARRAY_BUFFER,         mp->vbo);
-        glBufferData_(GL_ARRAY_BUFFER,         vn * vs, vv, GL_STATIC_DRAW);
-        glBindBuffer_(GL_ARRAY_BUFFER,         0);
-
-        glGenBuffers_(1, &mp->ebo);
-        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, mp->ebo);
-        glBufferData_(GL_ELEMENT_ARRAY_BUFFER, gn * gs, gv, GL_STATIC_DRAW);
-        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+        sol_mesh_geom(vv, vn, gv, gn, draw->base, iv, bp->g0, bp->gc, mi);
 
-        /* Note cached material index. */
+        free(iv);
 
-        mp->mtrl = draw->base->mtrls[mi];
+        *vvp = vv;
+        *gvp = gv;
 
-        mp->ebc = gn * 3;
-        mp->vbc = vn;
+        return 1;
     }
 
     free(iv);
     free(gv);
     free(vv);
+
+    return 0;
+}
+
+static void sol_load_mesh(struct d_mesh *mp,
+                          const struct b_body *bp,
+                          const struct s_draw *draw, int mi)
+{
+    struct d_vert *vv;
+    struct d_geom *gv;
+
+    int vn;
+    int gn;
+
+    /* Initialize buffer objects for all data. */
+
+    if (sol_mesh_data(&vv, &vn, &gv, &gn, bp, draw, mi))
+    {
+        sol_make_mesh(mp, vv, vn, gv, gn, draw->base->mtrls[mi]);
+
+        free(gv);
+        free(vv);
+    }
 }
 
 static void sol_free_mesh(struct d_mesh *mp)
@@ -389,49 +635,98 @@ static void sol_free_mesh(struct d_mesh *mp)
     glDeleteBuffers_(1, &mp->vbo);
 }
 
-void sol_draw_mesh(const struct d_mesh *mp, struct s_rend *rend, int p)
+/*
+ * Point the vertex arrays at the bound vertex buffer, o bytes in.
+ */
+
+static void sol_vert_pointers(size_t o)
 {
-    /* If this mesh has material matching the given flags... */
+    const size_t s = sizeof (struct d_vert);
+    const GLenum T = GL_FLOAT;
 
-    if (sol_test_mtrl(mp->mtrl, p))
+    const GLvoid *p = (GLvoid *) (o + offsetof (struct d_vert, p));
+    const GLvoid *n = (GLvoid *) (o + offsetof (struct d_vert, n));
+    const GLvoid *t = (GLvoid *) (o + offsetof (struct d_vert, t));
+
+    glVertexPointer  (3, T, s, p);
+    glNormalPointer  (   T, s, n);
+
+    if (tex_env_stage(TEX_STAGE_SHADOW))
     {
-        const size_t s = sizeof (struct d_vert);
-        const GLenum T = GL_FLOAT;
+        glTexCoordPointer(3, T, s, p);
 
-        /* Apply the material state. */
+        if (tex_env_stage(TEX_STAGE_CLIP))
+            glTexCoordPointer(3, T, s, p);
 
-        r_apply_mtrl(rend, mp->mtrl);
+        tex_env_stage(TEX_STAGE_TEXTURE);
+    }
+    glTexCoordPointer(2, T, s, t);
+}
 
-        /* Bind the mesh data. */
+static void sol_bind_mesh(const struct d_mesh *mp, struct s_rend *rend)
+{
+    /* Apply the material state. */
 
-        glBindBuffer_(GL_ARRAY_BUFFER,         mp->vbo);
-        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, mp->ebo);
+    r_apply_mtrl(rend, mp->mtrl);
 
-        glVertexPointer  (3, T, s, (GLvoid *) offsetof (struct d_vert, p));
-        glNormalPointer  (   T, s, (GLvoid *) offsetof (struct d_vert, n));
+    /* Bind the mesh data. */
 
-        if (tex_env_stage(TEX_STAGE_SHADOW))
-        {
-            glTexCoordPointer(3, T, s, (GLvoid *) offsetof (struct d_vert, p));
+    glBindBuffer_(GL_ARRAY_BUFFER,         mp->vbo);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, mp->ebo);
 
-            if (tex_env_stage(TEX_STAGE_CLIP))
-                glTexCoordPointer(3, T, s, (GLvoid *) offsetof (struct d_vert, p));
+    sol_vert_pointers(0);
+}
 
-            tex_env_stage(TEX_STAGE_TEXTURE);
-        }
-        glTexCoordPointer(2, T, s, (GLvoid *) offsetof (struct d_vert, t));
+static void sol_emit_mesh(const struct d_mesh *mp, struct s_rend *rend)
+{
+    /* Draw the bound mesh. */
 
-        /* Draw the mesh. */
+    stats.draw_calls++;
 
-        if (rend->curr_mtrl.base.fl & M_PARTICLE)
-            glDrawArrays(GL_POINTS, 0, mp->vbc);
-        else
-            glDrawElements(GL_TRIANGLES, mp->ebc, GL_UNSIGNED_SHORT, 0);
+    if (rend->curr_mtrl.base.fl & M_PARTICLE)
+        glDrawArrays(GL_POINTS, 0, mp->vbc);
+    else
+        glDrawElements(GL_TRIANGLES, mp->ebc, GL_UNSIGNED_SHORT, 0);
+}
+
+void sol_draw_mesh(const struct d_mesh *mp, struct s_rend *rend, int p)
+{
+    /* If this mesh has material matching the given flags... */
+
+    if (sol_test_mtrl(mp->mtrl, p))
+    {
+        sol_bind_mesh(mp, rend);
+        sol_emit_mesh(mp, rend);
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
+static int sol_is_static(const struct b_body *bq)
+{
+    return (bq->pi < 0 && bq->pj < 0);
+}
+
+static int sol_is_blended(const struct s_base *base, int mi)
+{
+    return (base->mv[mi].fl & M_TRANSPARENT);
+}
+
+/*
+ * Determine whether a body gets its own mesh for the given material.
+ * Static bodies keep only their blended materials, so that these are
+ * still drawn in body order.  The rest goes into the world body.
+ */
+
+static int sol_body_mtrl(const struct b_body *bq,
+                         const struct s_base *base, int mi)
+{
+    if (sol_is_static(bq) && !sol_is_blended(base, mi))
+        return 0;
+
+    return sol_count_body(bq, base, mi);
+}
+
 static void sol_load_body(struct d_body *bp,
                           const struct b_body *bq,
                           const struct s_draw *draw)
@@ -444,19 +739,25 @@ static void sol_load_body(struct d_body *bp,
     /* Determine how many materials this body uses. */
 
     for (mi = 0; mi < draw->base->mc; ++mi)
-        if (sol_count_body(bq, draw->base, mi))
+        if (sol_body_mtrl(bq, draw->base, mi))
             bp->mc++;
 
     /* Allocate and initialize a mesh for each material. */
 
-    if ((bp->mv = (struct d_mesh *) calloc(bp->mc, sizeof (struct d_mesh))))
+    if (bp->mc && (bp->mv = (struct d_mesh *) calloc(bp->mc,
+                                                     sizeof (struct d_mesh))))
     {
         int mj = 0;
 
         for (mi = 0; mi < draw->base->mc; ++mi)
-            if (sol_count_body(bq, draw->base, mi))
+            if (sol_body_mtrl(bq, draw->base, mi))
                 sol_load_mesh(bp->mv + mj++, bq, draw, mi);
     }
+    else bp->mc = 0;
+
+    /* Bound all meshes of this body. */
+
+    sol_bound_body(bp);
 
     /* Cache a mesh count for each pass. */
 
@@ -477,115 +778,422 @@ static void sol_free_body(struct d_body *bp)
     free(bp->mv);
 }
 
-static void sol_draw_body(const struct d_body *bp, struct s_rend *rend, int p)
-{
-    int i;
+/*---------------------------------------------------------------------------*/
 
-    for (i = 0; i < bp->mc; ++i)
-        sol_draw_mesh(bp->mv + i, rend, p);
-}
+/*
+ * The unblended geometry of bodies that never move is merged into a
+ * single world body at load time, with one mesh per material.  A mesh
+ * is split whenever it would outgrow the 16-bit element indices.
+ */
 
-/*---------------------------------------------------------------------------*/
+#define WORLD_VERT_MAX 65536
 
-int sol_load_draw(struct s_draw *draw, struct s_vary *vary, int s)
+static struct d_mesh *sol_world_mesh(struct d_body *wp)
 {
-    int i;
+    struct d_mesh *mv;
 
-    memset(draw, 0, sizeof (struct s_draw));
+    if ((mv = realloc(wp->mv, (wp->mc + 1) * sizeof (*mv))))
+    {
+        wp->mv = mv;
 
-    draw->vary = vary;
-    draw->base = vary->base;
+        memset(wp->mv + wp->mc, 0, sizeof (*mv));
 
-    /* Determine whether this file has reflective materials. */
+        return wp->mv + wp->mc++;
+    }
+    return NULL;
+}
 
-    for (i = 0; i < draw->base->mc; i++)
-        if (draw->base->mv[i].fl & M_REFLECTIVE)
-        {
-            draw->reflective = 1;
-            break;
-        }
+/*
+ * Make a world mesh of the collected geoms and reset the index mapping.
+ */
 
-    /* Cache all materials for this file. */
+static void sol_world_flush(struct d_body *wp, const struct s_base *base,
+                            const struct d_vert *vv, int *vn,
+                            const struct d_geom *gv, int *gn, int *iv, int mi)
+{
+    struct d_mesh *mp;
+    int oi;
 
-    mtrl_cache_sol(draw->base);
+    if (*gn && (mp = sol_world_mesh(wp)))
+        sol_make_mesh(mp, vv, *vn, gv, *gn, base->mtrls[mi]);
 
-    /* Initialize shadow state. */
+    for (oi = 0; oi < base->oc; ++oi)
+        iv[oi] = -1;
 
-    draw->shadow_ui = -1;
-    draw->shadowed = s;
+    *vn = 0;
+    *gn = 0;
+}
 
-    /* Initialize all bodies for this file. */
+static void sol_world_geom(struct d_body *wp, const struct s_base *base,
+                           struct d_vert *vv, int *vn,
+                           struct d_geom *gv, int *gn,
+                           int *iv, int g0, int gc, int mi)
+{
+    int gi;
 
-    if (draw->base->bc)
+    for (gi = 0; gi < gc; gi++)
     {
-        if ((draw->bv = calloc(draw->base->bc, sizeof (*draw->bv))))
+        const struct b_geom *gq = base->gv + base->iv[g0 + gi];
+
+        if (gq->mi == mi)
         {
-            draw->bc = draw->base->bc;
+            if (*vn + 3 > WORLD_VERT_MAX)
+                sol_world_flush(wp, base, vv, vn, gv, gn, iv, mi);
 
-            for (i = 0; i < draw->bc; i++)
-                sol_load_body(draw->bv + i, draw->base->bv + i, draw);
+            sol_mesh_tri(vv, vn, gv, gn, base, iv, gq);
         }
     }
-
-    sol_load_bill(draw);
-
-    return 1;
 }
 
-void sol_free_draw(struct s_draw *draw)
+static void sol_load_world(struct d_body *wp, const struct s_draw *draw)
 {
-    int i;
+    const struct s_base *base = draw->base;
 
-    mtrl_free_sol(draw->base);
+    struct d_vert *vv = 0;
+    struct d_geom *gv = 0;
+    int           *iv = 0;
 
-    sol_free_bill(draw);
+    int bi, li, mi, oi, gc;
 
-    for (i = 0; i < draw->bc; i++)
-        sol_free_body(draw->bv + i);
+    memset(wp, 0, sizeof (*wp));
 
+    for (mi = 0; mi < base->mc; ++mi)
+    {
+        /* Blended materials stay with their bodies. */
+
+        if (sol_is_blended(base, mi))
+            continue;
+
+        /* Count all static geoms with this material. */
+
+        for (gc = 0, bi = 0; bi < base->bc; ++bi)
+            if (sol_is_static(base->bv + bi))
+                gc += sol_count_body(base->bv + bi, base, mi);
+
+        if (gc == 0)
+            continue;
+
+        /* Get temporary storage for vertex and element array creation. */
+
+        if ((vv = (struct d_vert *) calloc(MIN(base->oc, WORLD_VERT_MAX),
+                                           sizeof (*vv))) &&
+            (gv = (struct d_geom *) calloc(gc, sizeof (*gv))) &&
+            (iv = (int           *) calloc(base->oc, sizeof (*iv))))
+        {
+            int vn = 0;
+            int gn = 0;
+
+            for (oi = 0; oi < base->oc; ++oi)
+                iv[oi] = -1;
+
+            /* Collect the lump and body geoms of all static bodies. */
+
+            for (bi = 0; bi < base->bc; ++bi)
+            {
+                const struct b_body *bq = base->bv + bi;
+
+                if (!sol_is_static(bq))
+                    continue;
+
+                for (li = 0; li < bq->lc; li++)
+                    sol_world_geom(wp, base, vv, &vn, gv, &gn, iv,
+                                   base->lv[bq->l0 + li].g0,
+                                   base->lv[bq->l0 + li].gc, mi);
+
+                sol_world_geom(wp, base, vv, &vn, gv, &gn, iv,
+                               bq->g0, bq->gc, mi);
+            }
+
+            sol_world_flush(wp, base, vv, &vn, gv, &gn, iv, mi);
+        }
+
+        free(iv);
+        free(gv);
+        free(vv);
+
+        iv = 0;
+        gv = 0;
+        vv = 0;
+    }
+
+    sol_bound_body(wp);
+
+    wp->pass[0] = sol_count_mesh(wp, 0);
+    wp->pass[1] = sol_count_mesh(wp, 1);
+    wp->pass[2] = sol_count_mesh(wp, 2);
+    wp->pass[3] = sol_count_mesh(wp, 3);
+    wp->pass[4] = sol_count_mesh(wp, 4);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int sol_load_draw(struct s_draw *draw, struct s_vary *vary, int s)
+{
+    int i;
+
+    profile_begin("draw", NULL);
+
+    memset(draw, 0, sizeof (struct s_draw));
+
+    draw->vary = vary;
+    draw->base = vary->base;
+
+    /* Determine whether this file has reflective materials. */
+
+    for (i = 0; i < draw->base->mc; i++)
+        if (draw->base->mv[i].fl & M_REFLECTIVE)
+        {
+            draw->reflective = 1;
+            break;
+        }
+
+    /* Cache all materials for this file. */
+
+    profile_begin("materials", NULL);
+    mtrl_cache_sol(draw->base);
+    profile_end();
+
+    /* Initialize shadow state. */
+
+    draw->shadow_ui = -1;
+    draw->shadowed = s;
+
+    /* Initialize all bodies for this file. */
+
+    if (draw->base->bc)
+    {
+        if ((draw->bv = calloc(draw->base->bc, sizeof (*draw->bv))))
+        {
+            draw->bc = draw->base->bc;
+
+            for (i = 0; i < draw->bc; i++)
+                sol_load_body(draw->bv + i, draw->base->bv + i, draw);
+        }
+    }
+
+    /* Merge all static bodies into the world body. */
+
+    sol_load_world(&draw->wb, draw);
+
+    /* Allocate a draw queue large enough to hold every mesh. */
+
+    draw->qc = draw->wb.mc;
+
+    for (i = 0; i < draw->bc; i++)
+        draw->qc += draw->bv[i].mc;
+
+    if (draw->qc)
+        draw->qv = calloc(draw->qc, sizeof (*draw->qv));
+
+    sol_load_bill(draw);
+
+    profile_end();
+
+    return 1;
+}
+
+void sol_free_draw(struct s_draw *draw)
+{
+    int i;
+
+    mtrl_free_sol(draw->base);
+
+    sol_free_bill(draw);
+
+    for (i = 0; i < draw->bc; i++)
+        sol_free_body(draw->bv + i);
+
+    sol_free_body(&draw->wb);
+
+    free(draw->qv);
     free(draw->bv);
 }
 
 /*---------------------------------------------------------------------------*/
 
-static void sol_draw_all(const struct s_draw *draw, struct s_rend *rend, int p)
+static int sol_cmp_pair(const void *a, const void *b)
 {
-    int bi;
+    const struct d_pair *pa = (const struct d_pair *) a;
+    const struct d_pair *pb = (const struct d_pair *) b;
+
+    /* Group by transform, then by texture, then by material. */
+
+    if (pa->ti != pb->ti) return pa->ti < pb->ti ? -1 : +1;
+    if (pa->o  != pb->o)  return pa->o  < pb->o  ? -1 : +1;
 
-    /* Draw all meshes of all bodies matching the given material flags. */
+    if (pa->mp->mtrl != pb->mp->mtrl)
+        return pa->mp->mtrl < pb->mp->mtrl ? -1 : +1;
+
+    /* Keep the original order otherwise. */
+
+    if (pa->bi != pb->bi) return pa->bi < pb->bi ? -1 : +1;
+    if (pa->mp != pb->mp) return pa->mp < pb->mp ? -1 : +1;
+
+    return 0;
+}
+
+static int sol_fill_body(const struct s_draw *draw, const struct d_body *bp,
+                         struct d_cull *cp, int bi, int ti, int qn, int p)
+{
+    int mi, c;
+
+    /* Skip bodies outside of the view; test meshes of the rest. A body */
+    /* with point sprites is never skipped whole, as its sprites may     */
+    /* reach into view. Its other meshes are still tested one by one.    */
+
+    if ((c = sol_cull_test(cp, bp->c, bp->r)) == 0)
+    {
+        if (!bp->particles)
+        {
+            stats.body_culled++;
+            return qn;
+        }
+        c = 1;
+    }
+
+    stats.body_drawn++;
+
+    for (mi = 0; mi < bp->mc; ++mi)
+    {
+        const struct d_mesh *mp = bp->mv + mi;
+        const struct mtrl   *mq = mtrl_get(mp->mtrl);
+
+        if (!sol_test_mtrl(mp->mtrl, p))
+            continue;
+
+        /* Point sprites overhang their vertices, so never cull them. */
+
+        if (c == 1 && !(mq->base.fl & M_PARTICLE) &&
+            !sol_cull_test(cp, mp->c, mp->r))
+        {
+            stats.mesh_culled++;
+            continue;
+        }
+
+        stats.mesh_drawn++;
+
+        draw->qv[qn].mp = mp;
+        draw->qv[qn].bi = bi;
+        draw->qv[qn].ti = ti;
+        draw->qv[qn].o  = mq->o;
+
+        qn++;
+    }
+    return qn;
+}
+
+static void sol_pose(float p[3], float e[4],
+                     const struct s_draw *draw, int bi)
+{
+    if (bi >= 0)
+    {
+        sol_body_p(p, draw->vary, draw->vary->bv + bi, 0.0f);
+        sol_body_e(e, draw->vary, draw->vary->bv + bi, 0.0f);
+    }
+    else
+    {
+        p[0] = p[1] = p[2] = 0.0f;
+
+        e[0] = 1.0f;
+        e[1] = e[2] = e[3] = 0.0f;
+    }
+}
+
+static int sol_fill_queue(const struct s_draw *draw,
+                          struct d_cull *cp, int p)
+{
+    int bi, qn = 0;
+
+    /* Queue the visible meshes of the world body. */
+
+    if (draw->wb.pass[p])
+    {
+        sol_pose(cp->p, cp->e, draw, -1);
+
+        qn = sol_fill_body(draw, &draw->wb, cp, -1, -1, qn, p);
+    }
+
+    /* Queue the visible meshes of all other bodies matching the pass.  */
+    /* Blended static geometry stays with its body, in body order.      */
 
     for (bi = 0; bi < draw->bc; ++bi)
         if (draw->bv[bi].pass[p])
         {
+            sol_pose(cp->p, cp->e, draw, bi);
+
+            qn = sol_fill_body(draw, draw->bv + bi, cp, bi, bi, qn, p);
+        }
+
+    return qn;
+}
+
+static void sol_draw_all(const struct s_draw *draw, struct s_rend *rend,
+                         struct d_cull *cp, int p)
+{
+    int qi, qn, ti = -2;
+
+    if (!draw->qv)
+        return;
+
+    qn = sol_fill_queue(draw, cp, p);
+
+    /* Sort opaque meshes to minimize state changes. Blended passes keep */
+    /* their drawing order.                                              */
+
+    if (p == PASS_OPAQUE || p == PASS_OPAQUE_DECAL)
+        qsort(draw->qv, qn, sizeof (*draw->qv), sol_cmp_pair);
+
+    /* Draw the queue, changing the transform only between groups. The   */
+    /* world body uses the identity transform.                           */
+
+    for (qi = 0; qi < qn; ++qi)
+    {
+        const struct d_pair *qp = draw->qv + qi;
+
+        if (qp->ti != ti)
+        {
+            if (ti != -2)
+                glPopMatrix();
+
+            ti = qp->ti;
+
+            sol_pose(cp->p, cp->e, draw, ti);
+
             glPushMatrix();
-            {
-                sol_transform(draw->vary, draw->vary->bv + bi, draw->shadow_ui);
-                sol_draw_body(draw->bv + bi, rend, p);
-            }
-            glPopMatrix();
+            sol_transform(draw->vary, cp->p, cp->e, draw->shadow_ui);
         }
+
+        sol_draw_mesh(qp->mp, rend, p);
+    }
+
+    if (ti != -2)
+        glPopMatrix();
 }
 
 /*---------------------------------------------------------------------------*/
 
 void sol_draw(const struct s_draw *draw, struct s_rend *rend, int mask, int test)
 {
+    struct d_cull cull;
+
+    sol_cull_init(&cull);
+
     /* Disable shadowed material setup if not requested. */
 
     rend->skip_flags |= (draw->shadowed ? 0 : M_SHADOWED);
 
     /* Render all opaque geometry, decals last. */
 
-    sol_draw_all(draw, rend, PASS_OPAQUE);
-    sol_draw_all(draw, rend, PASS_OPAQUE_DECAL);
+    sol_draw_all(draw, rend, &cull, PASS_OPAQUE);
+    sol_draw_all(draw, rend, &cull, PASS_OPAQUE_DECAL);
 
     /* Render all transparent geometry, decals first. */
 
     if (!test) glDisable(GL_DEPTH_TEST);
     if (!mask) glDepthMask(GL_FALSE);
     {
-        sol_draw_all(draw, rend, PASS_TRANSPARENT_DECAL);
-        sol_draw_all(draw, rend, PASS_TRANSPARENT);
+        sol_draw_all(draw, rend, &cull, PASS_TRANSPARENT_DECAL);
+        sol_draw_all(draw, rend, &cull, PASS_TRANSPARENT);
     }
     if (!mask) glDepthMask(GL_TRUE);
     if (!test) glEnable(GL_DEPTH_TEST);
@@ -600,13 +1208,17 @@ void sol_draw(const struct s_draw *draw, struct s_rend *rend, int mask, int test
 
 void sol_refl(const struct s_draw *draw, struct s_rend *rend)
 {
+    struct d_cull cull;
+
+    sol_cull_init(&cull);
+
     /* Disable shadowed material setup if not requested. */
 
     rend->skip_flags |= (draw->shadowed ? 0 : M_SHADOWED);
 
     /* Render all reflective geometry. */
 
-    sol_draw_all(draw, rend, PASS_REFLECTIVE);
+    sol_draw_all(draw, rend, &cull, PASS_REFLECTIVE);
 
     /* Revert the buffer object state. */
 
@@ -732,6 +1344,407 @@ void sol_bill(const struct s_draw *draw,
     sol_bill_disable();
 }
 
+/*---------------------------------------------------------------------------*/
+
+/*
+ * A batch draws many copies of one solid, each translated to a position
+ * and scaled uniformly.  The copies of each mesh are placed into a
+ * single static vertex buffer, which is rebuilt only when the positions
+ * change.  The body pose, shared by all copies, is applied at draw time.
+ */
+
+#define BATCH_VERT_MAX 65536
+
+int sol_load_batch(struct s_batch *batch, const struct s_draw *draw)
+{
+    const struct s_base *base = draw->base;
+
+    int bi, mi, i, n = 0;
+
+    memset(batch, 0, sizeof (*batch));
+
+    batch->draw = draw;
+
+    if (!base)
+        return 0;
+
+    /* Count the meshes of all bodies. */
+
+    for (bi = 0; bi < base->bc; ++bi)
+        for (mi = 0; mi < base->mc; ++mi)
+            if (sol_count_body(base->bv + bi, base, mi))
+                n++;
+
+    /* Without storage, fall back to drawing copy by copy. */
+
+    if (n && !(batch->iv = (struct d_inst *) calloc(n, sizeof (*batch->iv))))
+    {
+        batch->ordered = 1;
+        return 0;
+    }
+
+    /* Keep the source data of each mesh for transformation. */
+
+    for (bi = 0; bi < base->bc; ++bi)
+        for (mi = 0; mi < base->mc; ++mi)
+            if (sol_count_body(base->bv + bi, base, mi))
+            {
+                struct d_inst *ip = batch->iv + batch->ic;
+
+                const struct mtrl *mp = mtrl_get(base->mtrls[mi]);
+
+                if (!sol_mesh_data(&ip->vv, &ip->vn, &ip->gv, &ip->gn,
+                                   base->bv + bi, draw, mi))
+                    continue;
+
+                ip->bi     = bi;
+                ip->m.mtrl = base->mtrls[mi];
+
+                for (i = 0; i < ip->vn; ++i)
+                    ip->r = MAX(ip->r, v_len(ip->vv[i].p));
+
+                glGenBuffers_(1, &ip->m.vbo);
+                glGenBuffers_(1, &ip->m.ebo);
+
+                /* Blended meshes must be drawn copy by copy. */
+
+                if (mp && (mp->base.fl & M_TRANSPARENT))
+                    batch->ordered = 1;
+
+                batch->ic++;
+            }
+
+    /* So must billboards, which sort against the meshes of their copy. */
+
+    if (base->rc)
+        batch->ordered = 1;
+
+    return 1;
+}
+
+void sol_free_batch(struct s_batch *batch)
+{
+    int i;
+
+    for (i = 0; i < batch->ic; ++i)
+    {
+        sol_free_mesh(&batch->iv[i].m);
+
+        free(batch->iv[i].gv);
+        free(batch->iv[i].vv);
+    }
+
+    free(batch->iv);
+    free(batch->pv);
+    free(batch->ov);
+
+    memset(batch, 0, sizeof (*batch));
+}
+
+/*
+ * Fill the element buffer of a mesh with the indices of as many copies
+ * as fit a single draw call.
+ */
+
+static void sol_batch_elem(struct d_inst *ip, int cn)
+{
+    const size_t gs = sizeof (struct d_geom);
+
+    struct d_geom *gv;
+    int c, i;
+
+    if (cn <= ip->cn)
+        return;
+
+    if ((gv = (struct d_geom *) malloc(cn * ip->gn * gs)))
+    {
+        for (c = 0; c < cn; ++c)
+            for (i = 0; i < ip->gn; ++i)
+            {
+                gv[c * ip->gn + i].i = ip->gv[i].i + c * ip->vn;
+                gv[c * ip->gn + i].j = ip->gv[i].j + c * ip->vn;
+                gv[c * ip->gn + i].k = ip->gv[i].k + c * ip->vn;
+            }
+
+        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, ip->m.ebo);
+        glBufferData_(GL_ELEMENT_ARRAY_BUFFER, cn * ip->gn * gs, gv,
+                      GL_STATIC_DRAW);
+        glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        ip->cn = cn;
+
+        free(gv);
+    }
+}
+
+/*
+ * Place the copies of a mesh into its vertex buffer.
+ */
+
+static void sol_batch_vert(struct s_batch *batch, struct d_inst *ip)
+{
+    const size_t vs = sizeof (struct d_vert);
+
+    const int n = batch->pn * ip->vn;
+    int c, i;
+
+    if (n > batch->om)
+    {
+        struct d_vert *ov;
+
+        if (!(ov = (struct d_vert *) realloc(batch->ov, n * vs)))
+            return;
+
+        batch->ov = ov;
+        batch->om = n;
+    }
+
+    for (c = 0; c < batch->pn; ++c)
+    {
+        const float *q = batch->pv + c * 3;
+
+        for (i = 0; i < ip->vn; ++i)
+        {
+            const struct d_vert *vp = ip->vv + i;
+            struct d_vert       *op = batch->ov + c * ip->vn + i;
+
+            v_mad(op->p, q, vp->p, batch->k);
+            v_cpy(op->n, vp->n);
+
+            op->t[0] = vp->t[0];
+            op->t[1] = vp->t[1];
+        }
+    }
+
+    glBindBuffer_(GL_ARRAY_BUFFER, ip->m.vbo);
+    glBufferData_(GL_ARRAY_BUFFER, n * vs, batch->ov, GL_STATIC_DRAW);
+    glBindBuffer_(GL_ARRAY_BUFFER, 0);
+
+    ip->m.vbc = n;
+}
+
+/*
+ * Bound the copies of a mesh in any pose: a sphere around the positions,
+ * grown by the scaled reach of the mesh from its origin.
+ */
+
+static void sol_batch_bound(struct s_batch *batch, struct d_inst *ip)
+{
+    float a[3], b[3];
+    int c;
+
+    v_cpy(a, batch->pv);
+    v_cpy(b, batch->pv);
+
+    for (c = 1; c < batch->pn; ++c)
+    {
+        const float *q = batch->pv + c * 3;
+
+        a[0] = MIN(a[0], q[0]);
+        a[1] = MIN(a[1], q[1]);
+        a[2] = MIN(a[2], q[2]);
+        b[0] = MAX(b[0], q[0]);
+        b[1] = MAX(b[1], q[1]);
+        b[2] = MAX(b[2], q[2]);
+    }
+
+    v_mid(ip->m.c, a, b);
+
+    ip->m.r = 0.0f;
+
+    for (c = 0; c < batch->pn; ++c)
+    {
+        float d[3];
+
+        v_sub(d, batch->pv + c * 3, ip->m.c);
+
+        ip->m.r = MAX(ip->m.r, v_len(d));
+    }
+
+    ip->m.r += ip->r * batch->k;
+}
+
+/*
+ * Bring the vertex buffers up to date with the given positions.
+ */
+
+static void sol_batch_update(struct s_batch *batch,
+                             const float *pv, int pn, float k)
+{
+    int i;
+
+    if (pn == batch->pn && k == batch->k &&
+        !memcmp(pv, batch->pv, pn * 3 * sizeof (float)))
+        return;
+
+    if (pn > batch->pm)
+    {
+        float *v;
+
+        if (!(v = (float *) realloc(batch->pv, pn * 3 * sizeof (float))))
+            return;
+
+        batch->pv = v;
+        batch->pm = pn;
+    }
+
+    memcpy(batch->pv, pv, pn * 3 * sizeof (float));
+
+    batch->pn = pn;
+    batch->k  = k;
+
+    for (i = 0; i < batch->ic; ++i)
+    {
+        struct d_inst *ip = batch->iv + i;
+
+        if (ip->vn > 0)
+            sol_batch_elem(ip, MIN(pn, BATCH_VERT_MAX / ip->vn));
+
+        sol_batch_vert(batch, ip);
+        sol_batch_bound(batch, ip);
+    }
+}
+
+/*
+ * Draw copies c0 through c1 of the bound mesh, with vertex pointers set
+ * to the first copy of their element buffer chunk.
+ */
+
+static void sol_batch_emit(const struct d_inst *ip, struct s_rend *rend,
+                           int c0, int c1, int cb)
+{
+    const size_t gs = sizeof (struct d_geom);
+
+    stats.draw_calls++;
+
+    if (rend->curr_mtrl.base.fl & M_PARTICLE)
+        glDrawArrays(GL_POINTS, (c0 - cb) * ip->vn, (c1 - c0) * ip->vn);
+    else
+        glDrawElements(GL_TRIANGLES, (c1 - c0) * ip->gn * 3,
+                       GL_UNSIGNED_SHORT, (GLvoid *) ((c0 - cb) * ip->gn * gs));
+}
+
+static void sol_batch_pass(const struct s_batch *batch, struct s_rend *rend,
+                           const struct d_cull *cp, int p)
+{
+    const size_t vs = sizeof (struct d_vert);
+
+    int i, c, d;
+
+    for (i = 0; i < batch->ic; ++i)
+    {
+        const struct d_inst *ip = batch->iv + i;
+
+        const struct mtrl *mq = mtrl_get(ip->m.mtrl);
+
+        float e[4], u[3], a;
+        float o[3], w[3];
+
+        if (!sol_test_mtrl(ip->m.mtrl, p) || ip->m.vbc == 0 || ip->cn == 0)
+            continue;
+
+        /* Find the body pose shared by all copies. */
+
+        sol_pose(o, e, batch->draw, ip->bi);
+        q_as_axisangle(e, u, &a);
+        v_scl(o, o, batch->k);
+
+        /* Point sprites overhang their vertices, so never cull them. */
+
+        v_add(w, ip->m.c, o);
+
+        if (!(mq->base.fl & M_PARTICLE) && !sol_cull_sphere(cp, w, ip->m.r))
+        {
+            stats.mesh_culled++;
+            continue;
+        }
+
+        stats.mesh_drawn++;
+
+        sol_bind_mesh(&ip->m, rend);
+
+        for (c = 0; c < batch->pn; c += ip->cn)
+        {
+            int n = MIN(ip->cn, batch->pn - c);
+
+            if (c)
+                sol_vert_pointers(c * ip->vn * vs);
+
+            if ((u[0] == 0 && u[1] == 0 && u[2] == 0) || a == 0)
+            {
+                /* Without rotation, one translation moves all copies. */
+
+                glPushMatrix();
+                glTranslatef(o[0], o[1], o[2]);
+                sol_batch_emit(ip, rend, c, c + n, c);
+                glPopMatrix();
+            }
+            else
+            {
+                /* Otherwise, turn each copy about its own position. */
+
+                for (d = c; d < c + n; ++d)
+                {
+                    const float *q = batch->pv + d * 3;
+
+                    v_add(w, q, o);
+
+                    if (!(mq->base.fl & M_PARTICLE) &&
+                        !sol_cull_sphere(cp, w, ip->r * batch->k))
+                        continue;
+
+                    glPushMatrix();
+                    glTranslatef(w[0], w[1], w[2]);
+                    glRotatef(V_DEG(a), u[0], u[1], u[2]);
+                    glTranslatef(-q[0], -q[1], -q[2]);
+                    sol_batch_emit(ip, rend, d, d + 1, c);
+                    glPopMatrix();
+                }
+            }
+        }
+    }
+}
+
+void sol_draw_batch(struct s_batch *batch, struct s_rend *rend,
+                    const float *pv, int pn, float k, int mask, int test)
+{
+    struct d_cull cull;
+
+    if (pn <= 0 || batch->ic == 0)
+        return;
+
+    sol_batch_update(batch, pv, pn, k);
+
+    sol_cull_init(&cull);
+
+    /* Disable shadowed material setup if not requested. */
+
+    rend->skip_flags |= (batch->draw->shadowed ? 0 : M_SHADOWED);
+
+    /* Render all opaque geometry, decals last. */
+
+    sol_batch_pass(batch, rend, &cull, PASS_OPAQUE);
+    sol_batch_pass(batch, rend, &cull, PASS_OPAQUE_DECAL);
+
+    /* Render all transparent geometry, decals first. */
+
+    if (!test) glDisable(GL_DEPTH_TEST);
+    if (!mask) glDepthMask(GL_FALSE);
+    {
+        sol_batch_pass(batch, rend, &cull, PASS_TRANSPARENT_DECAL);
+        sol_batch_pass(batch, rend, &cull, PASS_TRANSPARENT);
+    }
+    if (!mask) glDepthMask(GL_TRUE);
+    if (!test) glEnable(GL_DEPTH_TEST);
+
+    /* Revert the buffer object state. */
+
+    glBindBuffer_(GL_ARRAY_BUFFER,         0);
+    glBindBuffer_(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    rend->skip_flags = 0;
+}
+
 void sol_fade(const struct s_draw *draw, struct s_rend *rend, float k)
 {
     if (k > 0.0f)
@@ -776,13 +1789,18 @@ int sol_load_full(struct s_full *full, const char *filename, int s)
     {
         memset(full, 0, sizeof (*full));
 
+        profile_begin("sol", filename);
+
         if (sol_load_base(&full->base, filename))
         {
             sol_load_vary(&full->vary, &full->base);
             sol_load_draw(&full->draw, &full->vary, s);
 
+            profile_end();
             return 1;
         }
+
+        profile_end();
     }
 
     return 0;
@@ -872,6 +1890,13 @@ void r_apply_mtrl(struct s_rend *rend, int mi)
     assert_mtrl(&rend->curr_mtrl);
 #endif
 
+    /* Count actual changes of material state. */
+
+    if (mp->o != mq->o || mp->d != mq->d || mp->a != mq->a ||
+        mp->s != mq->s || mp->e != mq->e || mp->h != mq->h ||
+        mp_flags != mq_flags)
+        stats.mtrl_switch++;
+
     /* Bind the texture. */
 
     if (mp->o != mq->o)
@@ -64,6 +64,9 @@ struct d_mesh
     GLuint vbc;                                /* Vertex  buffer count       */
     GLuint ebo;                                /* Element buffer object      */
     GLuint ebc;                                /* Element buffer count       */
+
+    float c[3];                                /* Bounding sphere center     */
+    float r;                                   /* Bounding sphere radius     */
 };
 
 struct d_body
@@ -74,6 +77,25 @@ struct d_body
     int mc;
 
     struct d_mesh *mv;
+
+    float c[3];                                /* Bounding sphere center     */
+    float r;                                   /* Bounding sphere radius     */
+
+    int particles;                             /* Has point sprite meshes    */
+};
+
+/*
+ * A mesh queued for drawing in a single pass, keyed for sorting.
+ */
+
+struct d_pair
+{
+    const struct d_mesh *mp;
+
+    int bi;                                    /* Body index, -1 if world    */
+    int ti;                                    /* Transform, -1 if world     */
+
+    GLuint o;                                  /* Texture object             */
 };
 
 struct s_draw
@@ -84,6 +106,11 @@ struct s_draw
     int bc;
 
     struct d_body *bv;
+    struct d_body  wb;                         /* Merged static bodies       */
+
+    int qc;
+
+    struct d_pair *qv;                         /* Draw queue storage         */
 
     GLuint bill;
 
@@ -124,10 +151,75 @@ void sol_back(const struct s_draw *, struct s_rend *, float, float, float);
 void sol_refl(const struct s_draw *, struct s_rend *);
 void sol_draw(const struct s_draw *, struct s_rend *, int, int);
 void sol_bill(const struct s_draw *, struct s_rend *, const float *, float);
+
 void sol_fade(const struct s_draw *, struct s_rend *, float);
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Many copies of one solid, placed into one static buffer per mesh.
+ */
+
+struct d_inst
+{
+    struct d_mesh m;                           /* Buffers, material, bound   */
+
+    int bi;                                    /* Body index                 */
+    int cn;                                    /* Copies in element buffer   */
+
+    struct d_vert *vv;                         /* Source vertices            */
+    struct d_geom *gv;                         /* Source elements            */
+    int vn;
+    int gn;
+
+    float r;                                   /* Source reach from origin   */
+};
+
+struct s_batch
+{
+    const struct s_draw *draw;
+
+    int ic;
+    struct d_inst *iv;
+
+    float *pv;                                 /* Positions at last update   */
+    int    pn;
+    int    pm;
+    float  k;                                  /* Scale at last update       */
+
+    struct d_vert *ov;                         /* Transformed vertex storage */
+    int om;
+
+    unsigned int ordered:1;                    /* Copies must draw in order  */
+};
+
+int  sol_load_batch(struct s_batch *, const struct s_draw *);
+void sol_free_batch(struct s_batch *);
+void sol_draw_batch(struct s_batch *, struct s_rend *,
+                    const float *, int, float, int, int);
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Counts of bodies and meshes drawn and culled, material changes and
+ * draw calls since the last query.
+ */
+
+struct d_stats
+{
+    int body_drawn;
+    int body_culled;
+    int mesh_drawn;
+    int mesh_culled;
+
+    int mtrl_switch;                           /* Material state changes     */
+    int draw_calls;                            /* glDraw* calls              */
+};
+
+void sol_draw_stats(struct d_stats *);
+
+/*---------------------------------------------------------------------------*/
+
 struct s_full
 {
     struct s_base base;
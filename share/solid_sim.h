@@ -26,6 +26,8 @@ void sol_quit_sim(void);
 void  sol_move(struct s_vary *, cmd_fn, float);
 float sol_step(struct s_vary *, cmd_fn, const float *, float, int, int *);
 
+float sol_test_time(const struct s_vary *, float, int);
+
 /*---------------------------------------------------------------------------*/
 
 #endif
@@ -624,6 +624,20 @@ static float sol_test_file(float dt,
     return t;
 }
 
+/*
+ * Find the time until ball UI first makes contact with the world,  or
+ * DT if it remains clear for that long.
+ */
+float sol_test_time(const struct s_vary *vary, float dt, int ui)
+{
+    float P[3], V[3];
+
+    if (ui < vary->uc)
+        return sol_test_file(dt, P, V, vary->uv + ui, vary);
+
+    return dt;
+}
+
 /*---------------------------------------------------------------------------*/
 
 /*
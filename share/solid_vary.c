@@ -17,6 +17,7 @@
 #include "solid_vary.h"
 #include "common.h"
 #include "vec3.h"
+#include "profile.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -24,6 +25,8 @@ int sol_load_vary(struct s_vary *fp, struct s_base *base)
 {
     int i;
 
+    profile_begin("vary", NULL);
+
     memset(fp, 0, sizeof (*fp));
 
     fp->base = base;
@@ -147,6 +150,8 @@ int sol_load_vary(struct s_vary *fp, struct s_base *base)
         }
     }
 
+    profile_end();
+
     return 1;
 }
 
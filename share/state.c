@@ -12,6 +12,9 @@
  * General Public License for more details.
  */
 
+#include <SDL.h>
+#include <stdio.h>
+
 #include "vec3.h"
 #include "glext.h"
 #include "state.h"
@@ -20,6 +23,8 @@
 #include "common.h"
 #include "hmd.h"
 #include "geom.h"
+#include "image.h"
+#include "profile.h"
 
 /*---------------------------------------------------------------------------*/
 
@@ -125,8 +130,14 @@ int goto_state(struct state *st)
 {
     struct state *prev = state;
 
+    profile_begin("state", NULL);
+
     if (state && state->leave)
+    {
+        profile_begin("leave", NULL);
         state->leave(state, st, state->gui_id);
+        profile_end();
+    }
 
     state       = st;
     state_time  = 0;
@@ -136,7 +147,25 @@ int goto_state(struct state *st)
     stick_count = 0;
 
     if (state && state->enter)
+    {
+        Uint64 t = SDL_GetPerformanceCounter();
+
+        profile_begin("enter", NULL);
         state->gui_id = state->enter(state, prev);
+        profile_end();
+
+        /* Report the time taken to build the screen if configured. */
+
+        if (config_get_d(CONFIG_STATS))
+        {
+            t = SDL_GetPerformanceCounter() - t;
+
+            fprintf(stdout, "enter %8.4f\n",
+                    1000.0 * t / SDL_GetPerformanceFrequency());
+        }
+    }
+
+    profile_end();
 
     return 1;
 }
@@ -147,6 +176,10 @@ void st_paint(float t)
 {
     state_drawn = 1;
 
+    /* Finish loading any images decoded since the last frame. */
+
+    image_step();
+
     if (state && state->paint)
     {
         video_clear();
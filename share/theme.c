@@ -89,8 +89,8 @@ static const char *theme_path(const char *name, const char *file)
 
 int theme_load(struct theme *theme, const char *name)
 {
-    char buff[MAXSTR];
-    fs_file fp;
+    fs_lines lr;
+    char *line;
 
     float s[4] = { 0.25f, 0.25f, 0.25f, 0.25f };
 
@@ -102,17 +102,15 @@ int theme_load(struct theme *theme, const char *name)
 
         /* Load description. */
 
-        if ((fp = fs_open(theme_path(name, "theme.txt"), "r")))
+        if ((lr = fs_lines_open(theme_path(name, "theme.txt"))))
         {
-            while ((fs_gets(buff, sizeof (buff), fp)))
+            while ((line = fs_lines_get(lr)))
             {
-                strip_newline(buff);
-
-                if (strncmp(buff, "slice ", 6) == 0)
-                    sscanf(buff + 6, "%f %f %f %f", &s[0], &s[1], &s[2], &s[3]);
+                if (strncmp(line, "slice ", 6) == 0)
+                    sscanf(line + 6, "%f %f %f %f", &s[0], &s[1], &s[2], &s[3]);
             }
 
-            fs_close(fp);
+            fs_lines_close(lr);
         }
         else
         {
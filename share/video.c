@@ -22,6 +22,8 @@
 #include "config.h"
 #include "gui.h"
 #include "hmd.h"
+#include "profile.h"
+#include "audio.h"
 
 extern const char TITLE[];
 extern const char ICON[];
@@ -150,6 +152,8 @@ int video_mode(int f, int w, int h)
 
     if (window)
     {
+        image_snap_flush();
+        profile_free_objects();
         SDL_GL_DeleteContext(context);
         SDL_DestroyWindow(window);
     }
@@ -178,6 +182,8 @@ int video_mode(int f, int w, int h)
     log_printf("Creating a window (%dx%d, %s)\n",
                w, h, (f ? "fullscreen" : "windowed"));
 
+    profile_begin("window", NULL);
+
     window = SDL_CreateWindow("", X, Y, w, h,
                               SDL_WINDOW_OPENGL |
                               (highdpi ? SDL_WINDOW_ALLOW_HIGHDPI : 0) |
@@ -210,6 +216,8 @@ int video_mode(int f, int w, int h)
         }
     }
 
+    profile_end();
+
     if (window && context)
     {
         set_window_title(TITLE);
@@ -261,9 +269,13 @@ int video_mode(int f, int w, int h)
 
         SDL_GL_SetSwapInterval(vsync);
 
+        profile_begin("glext", NULL);
+
         if (!glext_init())
             return 0;
 
+        profile_end();
+
         glViewport(0, 0, video.device_w, video.device_h);
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
@@ -348,6 +360,7 @@ static int   fps    = 0;
 static int   last   = 0;
 static int   ticks  = 0;
 static int   frames = 0;
+static float p99    = 0;
 
 int  video_perf(void)
 {
@@ -365,7 +378,15 @@ void video_swap(void)
 
     snapshot_take();
 
+    /* Draw the frame time graph over everything but screenshots. */
+
+    profile_graph();
+
+    profile_phase_begin(PHASE_SWAP);
     SDL_GL_SwapWindow(window);
+    profile_phase_end();
+
+    profile_frame();
 
     /* Accumulate time passed and frames rendered. */
 
@@ -389,6 +410,7 @@ void video_swap(void)
 
         fps = (int) ((c - k < k - f) ? c : f);
         ms  = (float) ticks / (float) frames;
+        p99 = profile_frame_time(frames, 99.0f);
 
         /* Reset the counters for the next update. */
 
@@ -398,7 +420,8 @@ void video_swap(void)
         /* Output statistics if configured. */
 
         if (config_get_d(CONFIG_STATS))
-            fprintf(stdout, "%4d %8.4f\n", fps, (double) ms);
+            fprintf(stdout, "%4d %8.4f %8.4f %4d\n",
+                    fps, (double) ms, (double) p99, audio_underruns());
     }
 }
 